@@ -2,374 +2,50 @@
 #include "GenRock.h"
 #include "ContentManager.h"
 #include "DdsTextureResource.h"
+#include "RockRandom.h"
+#include <algorithm>
+#include <atomic>
+
+static std::atomic<UINT> s_RockCount(0);
 
 GenRock::GenRock(float width, float height, float depth, int steps) :
-	m_Width(width),
-	m_Height(height),
-	m_Depth(depth),
-	m_Steps(steps),
 	m_pVertexLayout(nullptr),
-	m_pVertexBuffer(nullptr),
-	m_pIndexBuffer(nullptr),
 	m_pEffect(nullptr),
 	m_pTechnique(nullptr),
 	m_pMatWorldViewProjVariable(nullptr),
 	m_pMatWorldVariable(nullptr),
-	m_pMatViewInvVariable(nullptr),
-	m_NumVertices(0),
-	m_NumIndices(0)
+	m_pMatViewInvVariable(nullptr)
 {
+	m_Parameters.Width = width;
+	m_Parameters.Height = height;
+	m_Parameters.Depth = depth;
+	m_Parameters.Steps = steps;
 
+	//Every rock gets its own default seed; SetSeed makes it reproducible
+	m_Parameters.Seed = (UINT)RockRandom::Mix(s_RockCount++);
 }
 
 
 GenRock::~GenRock(void)
 {
-	m_VecVertices.clear();
-	m_VecIndices.clear();
+	//A build still running only touches the builder, which waits for it when it is destroyed
+	ReleaseLods();
+	ReleaseVariant();
+	ReleasePendingVariant();
 
 	m_pVertexLayout->Release();
-	m_pVertexBuffer->Release();
-	m_pIndexBuffer->Release();
-}
-
-
-//BUILD ICOSPHERE
-//*******************************************************************************************************************************
-void  GenRock::BuildIco()
-{
-	int subdivisions = m_Steps;
-	auto lists = MakeIcosphere(subdivisions);
-	auto vertices = lists.first;
-	auto indices = lists.second;
-
-	//SUBDIVIDE TRIANGLES + ADD NEW VERTICES TO BUFFER
-	//-----------------------------------------------------------------------------------------
-	for (int i = 0; i < vertices.size(); i++)
-	{
-		auto vertice = vertices[i];
-		auto vertVector = XMVector3Normalize(XMLoadFloat3(&vertice));
-		XMFLOAT3 vert;
-		DirectX::XMStoreFloat3(&vert, XMVector3Normalize(vertVector));
-
-		float r = sqrt(vertice.x * vertice.x + vertice.y * vertice.y + vertice.z * vertice.z);
-		float theta = acos(vertice.y / r); //lat
-		float phi = atan(vertice.x / vertice.z); //long
-
-		XMFLOAT3 newVert;
-		newVert = vert;
-		newVert.x *= m_Width;
-		newVert.y *= m_Height;
-		newVert.z *= m_Depth;
-
-		XMFLOAT3 normal;
-		auto normalVector = XMVector3Normalize(XMLoadFloat3(&newVert));
-		DirectX::XMStoreFloat3(&normal, XMVector3Normalize(normalVector));
-
-		XMFLOAT2 texcoord;
-		texcoord = UVFromVector3(newVert);
-		if (texcoord.y == 0)
-			m_NorthIdx.insert(i);
-		if (texcoord.y == 1)
-			m_SouthIdx.insert(i);
-
-		VertexBase base;
-		base.Position = newVert;
-		base.Normal = normal;
-		base.Tangent = XMFLOAT3(0,0,0);
-		base.TexCoord = texcoord;
-
-		auto ver = VertexRock(base);
-
-		m_VecVertices.push_back(ver);
-
-	}
-	m_NumVertices = m_VecVertices.size();
-
-	//SET INDICES
-	//-----------------------------------------------------------------------------------------
-	for each (auto indice in indices)
-	{
-		m_VecIndices.push_back(indice.vertex[0]);
-		m_VecIndices.push_back(indice.vertex[1]);
-		m_VecIndices.push_back(indice.vertex[2]);
-	}
-	m_NumIndices = m_VecIndices.size();
 }
 
-//CONVERT ICOSPHERE INTO 'ROCK'
-//*******************************************************************************************************************************
-void GenRock::BuildRock()
-{
-	//FLATTEN BY 'PLANES'
-	//-----------------------------------------------------------------------------------------
-	for (UINT plane = 0; plane < m_MaxPlanes; plane++)
-	{
-		//Determine position of plane by angle on sphere
-		XMFLOAT3 originPlane, radiusPlane;
-		m_PrevAngles.x = m_PrevAngles.x + m_MinRandAngle / 180.0f * XM_PI;
-		m_PrevAngles.y = m_PrevAngles.y + m_MinRandAngle / 180.0f * XM_PI;
-
-		m_PrevAngles.x = rand() % ((int)m_MaxRandAngle - (int)m_MinRandAngle) + (int)m_MinRandAngle;
-		m_PrevAngles.y = rand() % ((int)m_MaxRandAngle - (int)m_MinRandAngle) + (int)m_MinRandAngle;
-
-		//Origin plane
-		originPlane.x = m_Width * cos(m_PrevAngles.x) * cos(m_PrevAngles.y);
-		originPlane.y = m_Height * cos(m_PrevAngles.x) * sin(m_PrevAngles.y);
-		originPlane.z = m_Depth * sin(m_PrevAngles.x);
-
-		radiusPlane.x = m_Width * cos(m_PrevAngles.x + XM_PI) * cos(m_PrevAngles.y + XM_PI);
-		radiusPlane.y = m_Height * cos(m_PrevAngles.x + XM_PI) * sin(m_PrevAngles.y + XM_PI);
-		radiusPlane.z = m_Depth * sin(m_PrevAngles.x + XM_PI);
-
-		//Create plane
-		XMFLOAT3 normalPlane;
-		XMVECTOR origin = DirectX::XMLoadFloat3(&originPlane);
-		float offset = rand() % (int)m_MaxOffsetPercent;
-		origin *= (100.0f - offset) / 100.0f;
-		DirectX::XMStoreFloat3(&originPlane, origin);
-		XMVECTOR normal = XMVector3Normalize(origin);
-		normal = XMVector3Normalize(normal);
-		DirectX::XMStoreFloat3(&normalPlane, normal);
-
-		//Flatten vertices onto plane
-		for (UINT i = 0; i < m_NumVertices; i++)
-		{
-			//Check if vertice is in front of the plane
-			auto vertice = m_VecVertices[i];
-			auto point = XMLoadFloat3(&vertice.Position);
-			auto vecP = point - XMLoadFloat3(&originPlane);
-			auto dotV = XMVector3Dot(vecP, normal);
-			float dot;
-			XMStoreFloat(&dot, dotV);
-			if (dot < 0) // dont proceed this one if dot is negative == more then 90 degree
-				continue;
-
-			//Project on plane
-			XMFLOAT3 vectorFromPoint;
-			DirectX::XMStoreFloat3(&vectorFromPoint, vecP);
-
-			auto dist = vectorFromPoint.x*normalPlane.x + vectorFromPoint.y*normalPlane.y + vectorFromPoint.z*normalPlane.z;
-			auto projected_point = point - dist * normal;
-			XMFLOAT3 projectedPoint;
-			DirectX::XMStoreFloat3(&projectedPoint, projected_point);
-
-			//Create new vertice, make curved
-			auto distToCenter = LengthBetweenPoints(projectedPoint, originPlane);
-			auto diameter = LengthBetweenPoints(XMFLOAT3(0,0,0), radiusPlane) / 2.0f;
-			auto strength = (1.0f / diameter)*distToCenter - 1.0f;
-
-			projected_point = point - (dist / 2.0f) * normal * strength;
-			DirectX::XMStoreFloat3(&projectedPoint, projected_point);
-
-			//Update vertice
-			m_VecVertices[i].Position = projectedPoint;
-			m_VecVertices[i].Normal = normalPlane;
-		}
-	}
-}
-
-//PUSH VERTICES OUTWARDS TO COUNTER OVERLAP
-//*******************************************************************************************************************************
-void GenRock::Expand()
-{
-	float averageRadius = (m_Width + m_Height + m_Depth) / 3.0f;
-	for (UINT i = 0; i < m_NumIndices; i += 3)
-	{
-		auto idx0 = m_VecIndices[i % m_NumIndices];
-		auto idx1 = m_VecIndices[(i + 1) % m_NumIndices];
-		auto idx2 = m_VecIndices[(i + 2) % m_NumIndices];
-
-		auto v0 = &m_VecVertices[idx0];
-		auto v1 = &m_VecVertices[idx1];
-		auto v2 = &m_VecVertices[idx2];
-
-		//Push all vertices out by every plane
-		XMFLOAT3 triangle[3] = { v0->Position , v1->Position , v2->Position };
-		XMFLOAT3 normal = ComputeNormal(v0->Position, v1->Position, v2->Position);
-
-		(*v0).Position = AddXMFLOAT3(v0->Position, MultiplyXMFLOAT3(normal, averageRadius / 100.f));
-		(*v1).Position = AddXMFLOAT3(v1->Position, MultiplyXMFLOAT3(normal, averageRadius / 100.f));
-		(*v2).Position = AddXMFLOAT3(v2->Position, MultiplyXMFLOAT3(normal, averageRadius / 100.f));
-	}
-}
-
-//BUILD NORMALS
-//*******************************************************************************************************************************
-void GenRock::BuildNormals()
-{
-	XMFLOAT3 normal;
-	for (UINT idx = 0; idx + 2 < m_VecIndices.size(); idx += 3)
-	{
-		int idx0 = m_VecIndices[idx];
-		int idx1 = m_VecIndices[idx + 1];
-		int idx2 = m_VecIndices[idx + 2];
-
-		normal = ComputeNormal(
-			m_VecVertices[idx0].Position, m_VecVertices[idx1].Position, m_VecVertices[idx2].Position
-		);
-
-		m_VecVertices[idx0].Normal = AddXMFLOAT3(m_VecVertices[idx0].Normal, normal);
-		m_VecVertices[idx1].Normal = AddXMFLOAT3(m_VecVertices[idx1].Normal, normal);
-		m_VecVertices[idx2].Normal = AddXMFLOAT3(m_VecVertices[idx2].Normal, normal);
-	}
-	for (UINT i = 0; i < m_VecVertices.size(); i++)
-	{
-		m_VecVertices[i].Normal = NormalizeXMFLOAT3(m_VecVertices[i].Normal);
-	}
-}
-
-//CORRECT UV SEAMS
-//*******************************************************************************************************************************
-void GenRock::CorrectUV()
-{
-	//Find seam vertices
-	UINT countExtraVerts = 0;
-	std::set<UINT> duplicatesIdx;
-	for (int i = 0; i < m_NumIndices; i += 3)
-	{
-		//DATA --------------------------------------------
-		#pragma region data
-		auto idx0 = &m_VecIndices[i % m_NumIndices];
-		auto idx1 = &m_VecIndices[(i + 1) % m_NumIndices];
-		auto idx2 = &m_VecIndices[(i + 2) % m_NumIndices];
-
-		auto v0 = &m_VecVertices[*idx0];
-		auto v1 = &m_VecVertices[*idx1];
-		auto v2 = &m_VecVertices[*idx2];
-
-		XMFLOAT3 tex0 = XMFLOAT3(v0->TexCoord.x, v0->TexCoord.y, 0);
-		XMFLOAT3 tex1 = XMFLOAT3(v1->TexCoord.x, v1->TexCoord.y, 0);
-		XMFLOAT3 tex2 = XMFLOAT3(v2->TexCoord.x, v2->TexCoord.y, 0);
-
-		XMFLOAT3 texNormal;
-		XMVECTOR texN = XMVector3Cross(XMLoadFloat3(&tex1) - XMLoadFloat3(&tex0), XMLoadFloat3(&tex2) - XMLoadFloat3(&tex0));
-		//Check uv to determine if new triangles are needed
-		DirectX::XMStoreFloat3(&texNormal, texN);
-		#pragma endregion
-
-		//SIDES --------------------------------------------
-		if (texNormal.z > 0)
-		{
-			if (tex0.x < 0.1f)
-			{
-				if (duplicatesIdx.find(*idx0) != duplicatesIdx.end())
-				{
-					m_VecIndices[i % m_NumIndices] = *duplicatesIdx.find(*idx0);
-				}
-				else
-				{
-					auto newV0 = *v0;
-					newV0.TexCoord.x += 1.0f;
-					m_VecVertices.push_back(newV0);
-					m_VecIndices[i % m_NumIndices] = countExtraVerts + m_NumVertices;
-
-					duplicatesIdx.insert(countExtraVerts + m_NumVertices);
-					countExtraVerts++;
-				}
-			}
-
-			if (tex1.x < 0.1f)
-			{
-				if (duplicatesIdx.find(*idx1) != duplicatesIdx.end())
-				{
-					m_VecIndices[(i + 1) % m_NumIndices] = *duplicatesIdx.find(*idx1);
-				}
-				else
-				{
-					auto newV1 = *v1;
-					newV1.TexCoord.x += 1.0f;
-					m_VecVertices.push_back(newV1);
-					m_VecIndices[(i + 1) % m_NumIndices] = countExtraVerts + m_NumVertices;
-
-					duplicatesIdx.insert(countExtraVerts + m_NumVertices);
-					countExtraVerts++;
-				}
-			}
-
-			if (tex2.x < 0.1f)
-			{
-				if (duplicatesIdx.find(*idx2) != duplicatesIdx.end())
-				{
-					m_VecIndices[(i + 2) % m_NumIndices] = *duplicatesIdx.find(*idx2);
-				}
-				else
-				{
-					auto newV2 = *v2;
-					newV2.TexCoord.x += 1.0f;
-					m_VecVertices.push_back(newV2);
-					m_VecIndices[(i + 2) % m_NumIndices] = countExtraVerts + m_NumVertices;
-
-					duplicatesIdx.insert(countExtraVerts + m_NumVertices);
-					countExtraVerts++;
-				}
-			}
-		}
-
-
-		//POLES --------------------------------------------
-		if (m_NorthIdx.find(*idx0) != m_NorthIdx.end() || m_SouthIdx.find(*idx0) != m_SouthIdx.end())
-		{
-			auto newV0 = *v0;
-			newV0.TexCoord.x = (v1->TexCoord.x + v2->TexCoord.x) / 2.0f;
-			m_VecVertices.push_back(newV0);
-			m_VecIndices[(i) % m_NumIndices] = countExtraVerts + m_NumVertices;
-			countExtraVerts++;
-		}
-		else if (m_NorthIdx.find(*idx1) != m_NorthIdx.end() || m_SouthIdx.find(*idx1) != m_SouthIdx.end())
-		{
-			auto newV1 = *v0;
-			newV1.TexCoord.x = (v0->TexCoord.x + v2->TexCoord.x) / 2.0f;
-			m_VecVertices.push_back(newV1);
-			m_VecIndices[(i + 1) % m_NumIndices] = countExtraVerts + m_NumVertices;
-			countExtraVerts++;
-		}
-		else if (m_NorthIdx.find(*idx2) != m_NorthIdx.end() || m_SouthIdx.find(*idx2) != m_SouthIdx.end())
-		{
-			auto newV2 = *v0;
-			newV2.TexCoord.x = (v0->TexCoord.x + v1->TexCoord.x) / 2.0f;
-			m_VecVertices.push_back(newV2);
-			m_VecIndices[(i + 2) % m_NumIndices] = countExtraVerts + m_NumVertices;
-			countExtraVerts++;
-		}
-	}
-
-	m_NumVertices = m_VecVertices.size();
-	m_NumIndices = m_VecIndices.size();
-}
-
-//BUILD TANGENTS
-//*******************************************************************************************************************************
-void GenRock::BuildTangents()
-{
-	XMFLOAT3 tangent;
-	for (UINT idx = 0; idx + 2 < m_VecIndices.size(); idx += 3)
-	{
-		int idx0 = m_VecIndices[idx];
-		int idx1 = m_VecIndices[idx + 1];
-		int idx2 = m_VecIndices[idx + 2];
-
-		tangent = ComputeTangent(
-			m_VecVertices[idx0].Position, m_VecVertices[idx1].Position, m_VecVertices[idx2].Position,
-			m_VecVertices[idx0].TexCoord, m_VecVertices[idx1].TexCoord, m_VecVertices[idx2].TexCoord
-		);
-
-		m_VecVertices[idx0].Tangent = AddXMFLOAT3(m_VecVertices[idx0].Tangent, tangent);
-		m_VecVertices[idx1].Tangent = AddXMFLOAT3(m_VecVertices[idx1].Tangent, tangent);
-		m_VecVertices[idx2].Tangent = AddXMFLOAT3(m_VecVertices[idx2].Tangent, tangent);
-	}
-	for(UINT i = 0; i < m_VecVertices.size(); i++)
-	{
-		m_VecVertices[i].Tangent = NormalizeXMFLOAT3(m_VecVertices[i].Tangent);
-	}
-}
 
 //ENGINE
 //***************************************************************************************************
 void GenRock::Initialize(GameContext* pContext)
 {
 	//Effect
-	m_pEffect = ContentManager::Load<ID3DX11Effect>(L"Shaders/Rock.fx");
+	if (m_UsePackedVertices)
+		m_pEffect = ContentManager::Load<ID3DX11Effect>(L"Shaders/RockPacked.fx");
+	else
+		m_pEffect = ContentManager::Load<ID3DX11Effect>(L"Shaders/Rock.fx");
 	//m_pEffect = ContentManager::Load<ID3DX11Effect>(L"Shaders/PosNormTex3D.fx");
 	m_pTechnique = m_pEffect->GetTechniqueByIndex(0);
 	m_pMatWorldViewProjVariable = m_pEffect->GetVariableByName("gMatrixWVP")->AsMatrix();
@@ -407,37 +83,169 @@ void GenRock::Initialize(GameContext* pContext)
 	m_pAmbientIntensityVariable = m_pEffect->GetVariableByName("gAmbientIntensity")->AsScalar();
 	m_pColorAmbientVariable = m_pEffect->GetVariableByName("gColorAmbient")->AsVector();
 
+	//Packed vertices
+	if (m_UsePackedVertices)
+	{
+		m_pPositionMinVariable = m_pEffect->GetVariableByName("gPositionMin")->AsVector();
+		m_pPositionExtentVariable = m_pEffect->GetVariableByName("gPositionExtent")->AsVector();
+		m_pTexCoordMinVariable = m_pEffect->GetVariableByName("gTexCoordMin")->AsVector();
+		m_pTexCoordExtentVariable = m_pEffect->GetVariableByName("gTexCoordExtent")->AsVector();
+	}
+
 	BuildInputLayout(pContext);
 }
 
 void GenRock::Update(GameContext* pContext)
 {
+	//Any number of Resets since the last frame, or while a build is running, end up as one rebuild
 	if (m_PostInitialize == true)
 	{
-		if (m_pVertexBuffer != nullptr)
-			m_pVertexBuffer->Release();
-		if (m_pIndexBuffer != nullptr)
-			m_pIndexBuffer->Release();
-		m_VecVertices.clear();
-		m_VecIndices.clear();
-		m_NumVertices = 0;
-		m_NumIndices = 0;
-
-		BuildIco();
-		BuildRock();
-		Expand();
-		BuildNormals();
-		CorrectUV();
-		BuildTangents();
-
-		BuildVertexBuffer(pContext);
-		BuildIndexBuffer(pContext);
+		RockBuildRequest request;
+		request.Parameters = m_Parameters;
+		request.LodCount = m_LodCount;
+		request.PackedVertices = m_UsePackedVertices;
+		request.pCache = m_pMeshCache;
+		if (m_pVariantPool != nullptr)
+			RequestVariant(request);
+		else
+			m_Builder.Request(request);
 		m_PostInitialize = false;
+	}
 
+	//Frame boundary: the finished mesh replaces the one drawn so far in one go
+	if (m_PendingVariant != RockVariantPool::NO_VARIANT)
+		SwapInVariant(pContext);
+	std::unique_ptr<RockBuildResult> result = m_Builder.TakeResult();
+	if (result)
+	{
+		SwapInLods(pContext, *result);
 		Debug::LogWarning(L"Rock intialized");
 	}
 }
 
+void GenRock::SwapInLods(GameContext* pContext, RockBuildResult& result)
+{
+	std::vector<Lod> lods;
+	m_Profiler = result.Profiler;
+	if (result.CacheStoreFailed)
+		Debug::LogWarning(L"Failed to store rock in the mesh cache");
+	UploadLods(pContext, result, lods);
+
+	//Only the uploaded vertex format is filled and stays resident; a cache hit keeps nothing but the buffers
+	for (UINT i = 0; i < result.Lods.size(); i++)
+	{
+		RockBuiltLod& builtLod = result.Lods[i];
+		lods[i].VecVertices = std::move(builtLod.Vertices);
+		lods[i].VecPackedVertices = std::move(builtLod.PackedVertices);
+		lods[i].VecIndices = std::move(builtLod.Indices);
+	}
+
+	ReleaseLods();
+	ReleaseVariant();
+	m_Lods.swap(lods);
+	m_CurrentLod = 0;
+}
+
+void GenRock::UploadLods(GameContext* pContext, const RockBuildResult& result, std::vector<Lod>& lods)
+{
+	if (result.pCached)
+	{
+		//Cache hit: the buffers are filled straight from the mapped file, nothing is copied
+		lods.resize(result.pCached->GetLodCount());
+		for (UINT i = 0; i < lods.size(); i++)
+		{
+			const RockCachedLod& cachedLod = result.pCached->GetLod(i);
+			Lod& lod = lods[i];
+			lod.GeometricError = cachedLod.GeometricError;
+			lod.Bounds = cachedLod.Bounds;
+			lod.NumVertices = cachedLod.VertexCount;
+			lod.NumIndices = cachedLod.IndexCount;
+			lod.Is16BitIndices = cachedLod.IndexStride == sizeof(WORD);
+			UploadLod(pContext, lod, i, cachedLod.pVertices, cachedLod.pIndices);
+		}
+		return;
+	}
+
+	lods.resize(result.Lods.size());
+	for (UINT i = 0; i < lods.size(); i++)
+	{
+		const RockBuiltLod& builtLod = result.Lods[i];
+		Lod& lod = lods[i];
+		lod.GeometricError = builtLod.GeometricError;
+		lod.Bounds = builtLod.Bounds;
+		lod.NumVertices = (UINT)(m_UsePackedVertices ? builtLod.PackedVertices.size() : builtLod.Vertices.size());
+		lod.NumIndices = builtLod.Indices.GetCount();
+		lod.Is16BitIndices = builtLod.Indices.Is16Bit;
+
+		const void* pVertices = m_UsePackedVertices ? (const void*)builtLod.PackedVertices.data() : (const void*)builtLod.Vertices.data();
+		UploadLod(pContext, lod, i, pVertices, builtLod.Indices.GetData());
+	}
+}
+
+//VARIANT POOL
+//***************************************************************************************************
+void GenRock::RequestVariant(const RockBuildRequest& request)
+{
+	//Acquired before the old ones are released, so staying on the same variant never frees and rebuilds it
+	UINT variant = m_pVariantPool->Acquire(request);
+	ReleasePendingVariant();
+	m_PendingVariant = variant;
+}
+
+void GenRock::SwapInVariant(GameContext* pContext)
+{
+	UINT variant = m_PendingVariant;
+	std::shared_ptr<void>& pDeviceData = m_pVariantPool->GetDeviceData(variant);
+	if (!pDeviceData)
+	{
+		//Still building: the current mesh stays until a later frame
+		if (!m_pVariantPool->Poll(variant))
+			return;
+
+		//The first rock on a variant uploads it and drops the pool's CPU copy; the buffers go when the pool frees
+		//the variant and no rock draws them
+		std::shared_ptr<std::vector<Lod>> pLods(new std::vector<Lod>(), [](std::vector<Lod>* pLods)
+		{
+			for (auto& lod : *pLods)
+			{
+				if (lod.pVertexBuffer != nullptr)
+					lod.pVertexBuffer->Release();
+				if (lod.pIndexBuffer != nullptr)
+					lod.pIndexBuffer->Release();
+			}
+			delete pLods;
+		});
+		m_Profiler = m_pVariantPool->GetResult(variant).Profiler;
+		UploadLods(pContext, m_pVariantPool->GetResult(variant), *pLods);
+		m_pVariantPool->DropResult(variant);
+		pDeviceData = pLods;
+	}
+
+	ReleaseVariant();
+	ReleaseLods();
+	m_PendingVariant = RockVariantPool::NO_VARIANT;
+	m_Variant = variant;
+	m_pVariantLods = std::static_pointer_cast<std::vector<Lod>>(pDeviceData);
+	m_CurrentLod = 0;
+}
+
+void GenRock::ReleaseVariant()
+{
+	if (m_Variant == RockVariantPool::NO_VARIANT)
+		return;
+	m_pVariantLods.reset();
+	m_pVariantPool->Release(m_Variant);
+	m_Variant = RockVariantPool::NO_VARIANT;
+}
+
+void GenRock::ReleasePendingVariant()
+{
+	if (m_PendingVariant == RockVariantPool::NO_VARIANT)
+		return;
+	m_pVariantPool->Release(m_PendingVariant);
+	m_PendingVariant = RockVariantPool::NO_VARIANT;
+}
+
 void GenRock::Draw(GameContext* pContext)
 {
 	XMMATRIX world = XMLoadFloat4x4(&m_WorldMatrix);
@@ -445,6 +253,12 @@ void GenRock::Draw(GameContext* pContext)
 	XMMATRIX wvp = XMMatrixMultiply(world, viewProj);
 	XMMATRIX viewInv = XMLoadFloat4x4(&pContext->GetCamera()->GetViewInverse());
 
+	const std::vector<Lod>& lods = GetDrawnLods();
+	if (lods.empty())
+		return;
+	m_CurrentLod = SelectLod(pContext);
+	const Lod& lod = lods[m_CurrentLod];
+
 	m_pMatWorldVariable->SetMatrix(reinterpret_cast<float*>(&world));
 	m_pMatWorldViewProjVariable->SetMatrix(reinterpret_cast<float*>(&wvp));
 	m_pMatViewInvVariable->SetMatrix(reinterpret_cast<float*>(&viewInv));
@@ -629,14 +443,34 @@ void GenRock::Draw(GameContext* pContext)
 	}
 
 
+	//PACKED VERTICES
+	//-----------------------------------------------------------------------------------------
+	if (m_UsePackedVertices)
+	{
+		XMFLOAT4 positionMin(lod.Bounds.PositionMin.x, lod.Bounds.PositionMin.y, lod.Bounds.PositionMin.z, 0);
+		XMFLOAT4 positionExtent(lod.Bounds.PositionExtent.x, lod.Bounds.PositionExtent.y, lod.Bounds.PositionExtent.z, 0);
+		XMFLOAT4 texCoordMin(lod.Bounds.TexCoordMin.x, lod.Bounds.TexCoordMin.y, 0, 0);
+		XMFLOAT4 texCoordExtent(lod.Bounds.TexCoordExtent.x, lod.Bounds.TexCoordExtent.y, 0, 0);
+
+		m_pPositionMinVariable->SetFloatVector(reinterpret_cast<float*>(&positionMin));
+		m_pPositionExtentVariable->SetFloatVector(reinterpret_cast<float*>(&positionExtent));
+		m_pTexCoordMinVariable->SetFloatVector(reinterpret_cast<float*>(&texCoordMin));
+		m_pTexCoordExtentVariable->SetFloatVector(reinterpret_cast<float*>(&texCoordExtent));
+		if (m_pPositionMinVariable->IsValid() == false || m_pTexCoordMinVariable->IsValid() == false)
+		{
+			Debug::LogError(L"Packed vertex decode variables invalid");
+		}
+	}
+
+
 	// Set vertex buffer
-	UINT stride = sizeof(VertexRock);
+	UINT stride = m_UsePackedVertices ? sizeof(VertexRockPacked) : sizeof(VertexRock);
 	UINT offset = 0;
 	auto deviceContext = pContext->GetDeviceContext();
-	deviceContext->IASetVertexBuffers(0, 1, &m_pVertexBuffer, &stride, &offset);
+	deviceContext->IASetVertexBuffers(0, 1, &lod.pVertexBuffer, &stride, &offset);
 
 	// Set index buffer
-	deviceContext->IASetIndexBuffer(m_pIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	deviceContext->IASetIndexBuffer(lod.pIndexBuffer, lod.Is16BitIndices ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT, 0);
 
 	// Set the input layout
 	deviceContext->IASetInputLayout(m_pVertexLayout);
@@ -650,8 +484,32 @@ void GenRock::Draw(GameContext* pContext)
 	for (UINT p = 0; p< techDesc.Passes; ++p)
 	{
 		m_pTechnique->GetPassByIndex(p)->Apply(0, deviceContext);
-		deviceContext->DrawIndexed(m_NumIndices, 0, 0);
+		deviceContext->DrawIndexed(lod.NumIndices, 0, 0);
+	}
+}
+
+//Coarsest LOD whose error, seen from the camera, stays below m_LodScreenError of the viewport height
+UINT GenRock::SelectLod(GameContext* pContext) const
+{
+	XMFLOAT4X4 viewInv = pContext->GetCamera()->GetViewInverse();
+	XMFLOAT4X4 projection = pContext->GetCamera()->GetProjection();
+	XMVECTOR cameraPos = XMVectorSet(viewInv._41, viewInv._42, viewInv._43, 1.0f);
+	XMVECTOR rockPos = XMVectorSet(m_WorldMatrix._41, m_WorldMatrix._42, m_WorldMatrix._43, 1.0f);
+	float distance = XMVectorGetX(XMVector3Length(cameraPos - rockPos));
+
+	//Errors are in object space, scale them like the largest world axis
+	XMMATRIX world = XMLoadFloat4x4(&m_WorldMatrix);
+	float scale = (std::max)(XMVectorGetX(XMVector3Length(world.r[0])),
+		(std::max)(XMVectorGetX(XMVector3Length(world.r[1])), XMVectorGetX(XMVector3Length(world.r[2]))));
+
+	const std::vector<Lod>& lods = GetDrawnLods();
+	for (UINT i = (UINT)lods.size(); i > 1; i--)
+	{
+		float error = RockGenerator::ProjectScreenError(lods[i - 1].GeometricError * scale, distance, projection._22);
+		if (error <= m_LodScreenError)
+			return i - 1;
 	}
+	return 0;
 }
 
 void GenRock::BuildInputLayout(GameContext* pContext)
@@ -666,46 +524,78 @@ void GenRock::BuildInputLayout(GameContext* pContext)
 	};
 	UINT numElements = sizeof(vertexDesc) / sizeof(vertexDesc[0]);
 
+	//Packed: see VertexRockPacked, the shader decodes normal, tangent and the bounds relative values
+	D3D11_INPUT_ELEMENT_DESC packedDesc[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_UNORM, 0, 16, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+	};
+	UINT numPackedElements = sizeof(packedDesc) / sizeof(packedDesc[0]);
+
 	// Create the input layout
 	D3DX11_PASS_DESC passDesc;
 	m_pTechnique->GetPassByIndex(0)->GetDesc(&passDesc);
 	auto hr = pContext->GetDevice()->CreateInputLayout(
-		vertexDesc,
-		numElements,
+		m_UsePackedVertices ? packedDesc : vertexDesc,
+		m_UsePackedVertices ? numPackedElements : numElements,
 		passDesc.pIAInputSignature,
 		passDesc.IAInputSignatureSize,
 		&m_pVertexLayout);
 	Debug::LogHResult(hr, L"Failed to Create InputLayout");
 }
 
-void GenRock::BuildVertexBuffer(GameContext* pContext)
+void GenRock::UploadLod(GameContext* pContext, Lod& lod, UINT lodIndex, const void* pVertices, const void* pIndices)
+{
+	m_Profiler.SetLod(lodIndex);
+	m_Profiler.Begin(lod.NumVertices, 0);
+	BuildVertexBuffer(pContext, lod, pVertices);
+	m_Profiler.End(RockStage::VertexBuffer, lod.NumVertices, 0);
+	m_Profiler.Begin(0, lod.NumIndices);
+	BuildIndexBuffer(pContext, lod, pIndices);
+	m_Profiler.End(RockStage::IndexBuffer, 0, lod.NumIndices);
+}
+
+void GenRock::BuildVertexBuffer(GameContext* pContext, Lod& lod, const void* pVertices)
 {
 	//Vertexbuffer
 	D3D11_BUFFER_DESC bd = {};
 	D3D11_SUBRESOURCE_DATA initData = { 0 };
 	bd.Usage = D3D11_USAGE_IMMUTABLE;
-	bd.ByteWidth = sizeof(VertexRock) * m_NumVertices;
+	bd.ByteWidth = (m_UsePackedVertices ? sizeof(VertexRockPacked) : sizeof(VertexRock)) * lod.NumVertices;
 	bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	bd.CPUAccessFlags = 0;
 	bd.MiscFlags = 0;
-	initData.pSysMem = m_VecVertices.data();
-	HRESULT hr = pContext->GetDevice()->CreateBuffer(&bd, &initData, &m_pVertexBuffer);
+	initData.pSysMem = pVertices;
+	HRESULT hr = pContext->GetDevice()->CreateBuffer(&bd, &initData, &lod.pVertexBuffer);
 	Debug::LogHResult(hr, L"Failed to Create Vertexbuffer");
 }
 
-void GenRock::BuildIndexBuffer(GameContext* pContext)
+void GenRock::BuildIndexBuffer(GameContext* pContext, Lod& lod, const void* pIndices)
 {
 	D3D11_BUFFER_DESC bd = {};
 	D3D11_SUBRESOURCE_DATA initData = { 0 };
 	bd.Usage = D3D11_USAGE_IMMUTABLE;
-	bd.ByteWidth = sizeof(DWORD) * m_NumIndices;
+	bd.ByteWidth = (lod.Is16BitIndices ? sizeof(WORD) : sizeof(DWORD)) * lod.NumIndices;
 	bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	bd.CPUAccessFlags = 0;
 	bd.MiscFlags = 0;
-	initData.pSysMem = m_VecIndices.data();
-	HRESULT hr = pContext->GetDevice()->CreateBuffer(&bd, &initData, &m_pIndexBuffer);
+	initData.pSysMem = pIndices;
+	HRESULT hr = pContext->GetDevice()->CreateBuffer(&bd, &initData, &lod.pIndexBuffer);
 	Debug::LogHResult(hr, L"Failed to Create Indexbuffer");
-	m_NumIndices = m_VecIndices.size();
+}
+
+void GenRock::ReleaseLods()
+{
+	for (auto& lod : m_Lods)
+	{
+		if (lod.pVertexBuffer != nullptr)
+			lod.pVertexBuffer->Release();
+		if (lod.pIndexBuffer != nullptr)
+			lod.pIndexBuffer->Release();
+	}
+	m_Lods.clear();
 }
 
 void GenRock::SetDiffuse(wstring diffuseFile, bool use, XMFLOAT4 color)
@@ -2,6 +2,11 @@
 #include "GameObject.h"
 #include "VertexStructs.h"
 #include "RockHeader.h"
+#include "RockGenerator.h"
+#include "RockPacking.h"
+#include "RockMeshCache.h"
+#include "RockAsyncBuilder.h"
+#include "RockVariantPool.h"
 
 class DdsTextureResource;
 class GenRock : public GameObject
@@ -18,22 +23,63 @@ public:
 	};
 
 	//Rockgen
+	//Rebuilds the rock on the shared worker pool; the current mesh is drawn until the new one is swapped in by Update.
+	//Only the stages reading a parameter changed since the last Reset rerun, shader setters need no Reset at all.
 	void Reset() { m_PostInitialize = true; }
-
-	void SetRadiusWidth(float width) { m_Width = width; }
-	void SetRadiusDepth(float depth) { m_Depth = depth; }
-	void SetRadiusHeight(float height) { m_Height = height; }
-
-	void SetRandAngleMax(float angle) { m_MaxRandAngle = angle; }
-	void SetRandAngleMin(float angle) { m_MinRandAngle = angle; }
-	void SetRandOffsetPercent(float percent) { m_MaxOffsetPercent = percent; }
-	void SetRandShift(float shift) { m_MaxRandShift = shift; }
-
-	void SetMaxPlaneVerts(UINT verts) { m_MaxPlaneVerts = verts; }
-	void SetMinPlaneVerts(UINT verts) { m_MinPlaneVerts = verts; }
-	void SetMaxPlanes(UINT planes) { m_MaxPlanes = planes; }
-
-	void SetSteps(UINT steps) { m_Steps = steps; }
+	bool IsBuilding() const { return m_Builder.IsBusy() || m_PendingVariant != RockVariantPool::NO_VARIANT; }
+
+	void SetRadiusWidth(float width) { m_Parameters.Width = width; }
+	void SetRadiusDepth(float depth) { m_Parameters.Depth = depth; }
+	void SetRadiusHeight(float height) { m_Parameters.Height = height; }
+
+	void SetRandAngleMax(float angle) { m_Parameters.MaxRandAngle = angle; }
+	void SetRandAngleMin(float angle) { m_Parameters.MinRandAngle = angle; }
+	void SetRandOffsetPercent(float percent) { m_Parameters.MaxOffsetPercent = percent; }
+	void SetRandShift(float shift) { m_Parameters.MaxRandShift = shift; }
+
+	void SetMaxPlaneVerts(UINT verts) { m_Parameters.MaxPlaneVerts = verts; }
+	void SetMinPlaneVerts(UINT verts) { m_Parameters.MinPlaneVerts = verts; }
+	void SetMaxPlanes(UINT planes) { m_Parameters.MaxPlanes = planes; }
+
+	void SetSteps(UINT steps) { m_Parameters.Steps = steps; }
+	void SetSeed(UINT seed) { m_Parameters.Seed = seed; }
+	UINT GetSeed() const { return m_Parameters.Seed; }
+
+	//Surface detail: fBm noise pushing the surface along the radial direction, see RockParameters. 0 octaves is off.
+	void SetNoiseOctaves(UINT octaves) { m_Parameters.NoiseOctaves = octaves; }
+	void SetNoiseFrequency(float frequency) { m_Parameters.NoiseFrequency = frequency; }
+	void SetNoiseAmplitude(float amplitude) { m_Parameters.NoiseAmplitude = amplitude; }
+	void SetNoiseLacunarity(float lacunarity) { m_Parameters.NoiseLacunarity = lacunarity; }
+	void SetNoiseGain(float gain) { m_Parameters.NoiseGain = gain; }
+	void SetNoiseSeed(UINT seed) { m_Parameters.NoiseSeed = seed; }
+
+	//Upload VertexRockPacked (20 bytes) instead of VertexRock (44 bytes), drawn with Shaders/RockPacked.fx.
+	//Picks the effect and input layout, so it has to be set before Initialize.
+	void SetPackedVertices(bool packed) { m_UsePackedVertices = packed; }
+	bool GetPackedVertices() const { return m_UsePackedVertices; }
+
+	//Number of LODs built on Reset (Steps, Steps - 1, ...); Draw picks the coarsest one whose
+	//error stays below screenError, a fraction of the viewport height
+	void SetLodCount(UINT count) { m_LodCount = count > 0 ? count : 1; }
+	void SetLodScreenError(float screenError) { m_LodScreenError = screenError; }
+	UINT GetLodCount() const { return (UINT)GetDrawnLods().size(); }
+	UINT GetCurrentLod() const { return m_CurrentLod; }
+
+	//Shared on-disk cache: Reset maps the rock's meshes from it when its parameters were built before and
+	//stores them after generating otherwise. The cache is not owned by the rock.
+	void SetMeshCache(RockMeshCache* pCache) { m_pMeshCache = pCache; }
+
+	//Shared variant pool: Reset takes a variant of the rock's parameter class, picked by its seed, from the pool
+	//instead of building a mesh of its own, and draws the GPU buffers every rock on that variant shares. The rock then
+	//only differs by its transform and SetDiffuse color. A variant still building is swapped in by the Update that
+	//finds it done, the current mesh is drawn until then. Set it before Initialize; the pool is not owned and has to
+	//outlive the rock.
+	void SetVariantPool(RockVariantPool* pPool) { m_pVariantPool = pPool; }
+
+	//Stage events of the last rebuild, taken over in Update: the generator's stages plus the buffer uploads of every LOD.
+	//GetProfiler().ToChromeTrace() gives them as Chrome trace JSON. Allocation counts are only filled when the game
+	//executable compiles Headless/RockAllocationHook.cpp in; otherwise every event has HasAllocations false.
+	const RockProfiler& GetProfiler() const { return m_Profiler; }
 
 	//Shader
 	void SetDiffuse(wstring diffuseFile, bool use, XMFLOAT4 color);
@@ -51,40 +97,68 @@ protected:
 
 private:
 	void BuildInputLayout(GameContext* pContext);
-	void BuildVertexBuffer(GameContext* pContext);
-	void BuildIndexBuffer(GameContext* pContext);
-	void BuildIco();
 
-	void CorrectUV();
+	//Everything one level of detail keeps resident
+	struct Lod
+	{
+		std::vector<VertexRock> VecVertices;
+		std::vector<VertexRockPacked> VecPackedVertices;
+		PackedBounds Bounds;
+		PackedIndices VecIndices; //16 bit whenever the vertex count allows it
+		UINT NumVertices = 0;
+		UINT NumIndices = 0;
+		bool Is16BitIndices = false;
+		float GeometricError = 0.0f;
+
+		ID3D11Buffer* pVertexBuffer = nullptr;
+		ID3D11Buffer* pIndexBuffer = nullptr;
+	};
 
-	void BuildRock();
-	void Expand();
-	void BuildNormals();
-	void BuildTangents();
+	//Uploads a finished build into new LODs and only then releases the old ones
+	void SwapInLods(GameContext* pContext, RockBuildResult& result);
+	//Buffers of every LOD of a build, filled from the built or the cached data without copying it
+	void UploadLods(GameContext* pContext, const RockBuildResult& result, std::vector<Lod>& lods);
+	//Acquires the pool's variant for request; SwapInVariant draws it once it is built, uploading it when no rock did so before
+	void RequestVariant(const RockBuildRequest& request);
+	void SwapInVariant(GameContext* pContext);
+	void ReleaseVariant();
+	void ReleasePendingVariant();
+	const std::vector<Lod>& GetDrawnLods() const { return m_pVariantLods ? *m_pVariantLods : m_Lods; }
+	//Vertex and index data come from the LOD's own vectors or straight from a mapped cache file
+	void UploadLod(GameContext* pContext, Lod& lod, UINT lodIndex, const void* pVertices, const void* pIndices);
+	void BuildVertexBuffer(GameContext* pContext, Lod& lod, const void* pVertices);
+	void BuildIndexBuffer(GameContext* pContext, Lod& lod, const void* pIndices);
+	void ReleaseLods();
+	UINT SelectLod(GameContext* pContext) const;
 
 
 	//bool SameSide(XMVECTOR p1, XMVECTOR p2, XMVECTOR a, XMVECTOR b);
 
 	bool m_PostInitialize = true;
-	float m_Width, m_Height, m_Depth;
-	float m_MinRandAngle, m_MaxRandAngle, m_MaxOffsetPercent, m_MaxRandShift;
-	XMFLOAT2 m_PrevAngles = XMFLOAT2(0,0);
-	UINT m_MaxPlaneVerts, m_MinPlaneVerts, m_MaxPlanes;
-	UINT m_Steps;
+	RockParameters m_Parameters;
 
-	std::set<UINT> m_NorthIdx, m_SouthIdx;
 	float m_MaxLineLength = 0;
 	float m_MinLineLength = 9999999;
 
-	std::vector<VertexRock> m_VecVertices;
-	std::vector<DWORD> m_VecIndices;
-	UINT m_NumVertices, m_NumIndices;
+	std::vector<Lod> m_Lods;
+	UINT m_LodCount = 1;
+	UINT m_CurrentLod = 0;
+	float m_LodScreenError = 0.001f;
+
+	RockProfiler m_Profiler;
+	RockMeshCache* m_pMeshCache = nullptr;
+	RockAsyncBuilder m_Builder;
+
+	RockVariantPool* m_pVariantPool = nullptr;
+	UINT m_Variant = RockVariantPool::NO_VARIANT;
+	UINT m_PendingVariant = RockVariantPool::NO_VARIANT;
+	std::shared_ptr<std::vector<Lod>> m_pVariantLods;
+
+	bool m_UsePackedVertices = false;
 
 	//SHADER
 	/******/
 	ID3D11InputLayout*      m_pVertexLayout;
-	ID3D11Buffer*           m_pVertexBuffer;
-	ID3D11Buffer*           m_pIndexBuffer;
 	ID3DX11Effect			*m_pEffect;
 	ID3DX11EffectTechnique	*m_pTechnique;
 	ID3DX11EffectMatrixVariable *m_pMatWorldViewProjVariable;
@@ -158,6 +232,13 @@ private:
 	ID3DX11EffectScalarVariable* m_pAmbientIntensityVariable;//INTENSITY
 	float m_pAmbientIntensity = 1.0f;
 
+	//PACKED VERTICES
+	/***************/
+	ID3DX11EffectVectorVariable* m_pPositionMinVariable = nullptr;//DECODE POSITION
+	ID3DX11EffectVectorVariable* m_pPositionExtentVariable = nullptr;
+	ID3DX11EffectVectorVariable* m_pTexCoordMinVariable = nullptr;//DECODE TEXCOORD
+	ID3DX11EffectVectorVariable* m_pTexCoordExtentVariable = nullptr;
+
 private:
 
 	// -------------------------
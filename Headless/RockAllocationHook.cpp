@@ -0,0 +1,42 @@
+#include "stdafx.h"
+#include "RockProfiler.h"
+#include <cstdlib>
+#include <new>
+
+//Replaces the global operator new and delete of the executable it is linked into, so RockProfiler can count heap
+//allocations per stage. It is opt in per executable, never part of RockGen: a library must not replace the allocator
+//of every program that uses it. CMake targets link the RockAllocationHook object library (RockBench does with
+//ROCK_TRACK_ALLOCATIONS); the engine adds this file to the sources of its executable.
+
+static const bool s_CountingAllocations = RockProfiler::EnableAllocationCounting();
+
+void* operator new(size_t size)
+{
+	RockProfiler::CountAllocation(size);
+	if (void* p = malloc(size > 0 ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	RockProfiler::CountAllocation(size);
+	return malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+	return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { free(p); }
@@ -0,0 +1,226 @@
+#include "stdafx.h"
+#include "RockGenerator.h"
+#include "RockField.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+//Sweeps subdivision steps and plane counts through RockGenerator and prints, per configuration, the
+//average time of every pipeline stage, rocks and triangles per second and the peak memory of the process.
+//
+//	RockBench [--steps min-max] [--planes n,n,...] [--noise octaves] [--seconds s] [--csv] [--trace file.json]
+//	RockBench --field instances [--steps min-max]
+//
+//--noise turns on the fBm displacement with that many octaves.
+//--trace writes the stages of the first rock of every configuration as Chrome trace events.
+//--field scatters a rock field of that many instances instead, 16 variants detailed from min to max steps,
+//and prints the time of scattering, placing and building the meshes.
+//One generator and mesh are reused for every rock of a configuration, as an editor or streamer would: "1st allocs"
+//is what the first rock allocates, "allocs" the average of the warm ones after it ("n/a" unless built with
+//ROCK_TRACK_ALLOCATIONS).
+
+struct BenchOptions
+{
+	UINT MinSteps = 0;
+	UINT MaxSteps = 8;
+	std::vector<UINT> Planes = { 0, 25, 100, 200 };
+	double Seconds = 0.5;
+	bool Csv = false;
+	std::string TracePath;
+	UINT FieldInstances = 0;
+	UINT NoiseOctaves = 0;
+};
+
+static size_t GetPeakMemory()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters = {};
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.PeakWorkingSetSize;
+#else
+	rusage usage = {};
+	getrusage(RUSAGE_SELF, &usage);
+	return (size_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+static bool ParseOptions(int argc, char** argv, BenchOptions& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--steps" && hasValue)
+		{
+			std::string value = argv[++i];
+			size_t dash = value.find('-');
+			options.MinSteps = (UINT)atoi(value.substr(0, dash).c_str());
+			options.MaxSteps = dash == std::string::npos ? options.MinSteps : (UINT)atoi(value.substr(dash + 1).c_str());
+		}
+		else if (arg == "--planes" && hasValue)
+		{
+			options.Planes.clear();
+			std::string value = argv[++i];
+			for (size_t first = 0; first <= value.size();)
+			{
+				size_t comma = value.find(',', first);
+				if (comma == std::string::npos)
+					comma = value.size();
+				options.Planes.push_back((UINT)atoi(value.substr(first, comma - first).c_str()));
+				first = comma + 1;
+			}
+		}
+		else if (arg == "--seconds" && hasValue)
+		{
+			options.Seconds = atof(argv[++i]);
+		}
+		else if (arg == "--csv")
+		{
+			options.Csv = true;
+		}
+		else if (arg == "--trace" && hasValue)
+		{
+			options.TracePath = argv[++i];
+		}
+		else if (arg == "--noise" && hasValue)
+		{
+			options.NoiseOctaves = (UINT)atoi(argv[++i]);
+		}
+		else if (arg == "--field" && hasValue)
+		{
+			options.FieldInstances = (UINT)atoi(argv[++i]);
+		}
+		else
+		{
+			printf("usage: %s [--steps min-max] [--planes n,n,...] [--noise octaves] [--seconds s] [--csv] [--trace file.json] [--field instances]\n", argv[0]);
+			return false;
+		}
+	}
+	return options.MinSteps <= options.MaxSteps && !options.Planes.empty();
+}
+
+static int RunField(const BenchOptions& options)
+{
+	//Square area that holds the instances at the default density, MaxInstances cuts off the rest
+	RockFieldDesc desc;
+	float side = sqrtf(options.FieldInstances / desc.Density) * 1.05f;
+	desc.Max = XMFLOAT2(side, side);
+	desc.MaxInstances = options.FieldInstances;
+	desc.MinSteps = options.MinSteps;
+	desc.Parameters.Width = 1.0f;
+	desc.Parameters.Height = 0.8f;
+	desc.Parameters.Depth = 1.2f;
+	desc.Parameters.Steps = options.MaxSteps;
+	desc.Parameters.MinRandAngle = 10.0f;
+	desc.Parameters.MaxRandAngle = 350.0f;
+	desc.Parameters.MaxOffsetPercent = 25.0f;
+	desc.Parameters.MaxPlanes = 25;
+
+	RockField field = RockFieldGenerator::Generate(desc);
+	const RockFieldStats& stats = field.Stats;
+	double total = stats.ScatterMilliseconds + stats.PlaceMilliseconds + stats.MeshMilliseconds;
+	size_t triangles = 0;
+	for (const RockMesh& mesh : field.Meshes)
+		triangles += mesh.Indices.size() / 3;
+
+	printf("%9s %6s %10s %8s %8s %9s %12s %9s\n", "instances", "meshes", "mesh tris", "scatter", "place", "meshes ms", "instances/s", "peak MB");
+	printf("%9u %6u %10zu %8.2f %8.2f %9.2f %12.0f %9.1f\n", stats.Instances, stats.UniqueMeshes, triangles, stats.ScatterMilliseconds,
+		stats.PlaceMilliseconds, stats.MeshMilliseconds, stats.Instances * 1000.0 / total, GetPeakMemory() / (1024.0 * 1024.0));
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+	if (!ParseOptions(argc, argv, options))
+		return 1;
+	if (options.FieldInstances > 0)
+		return RunField(options);
+
+	//The buffer stages only run in GenRock
+	const UINT stageCount = UINT(RockStage::VertexBuffer);
+
+	//HEADER
+	//-----------------------------------------------------------------------------------------
+	printf(options.Csv ? "%s,%s,%s,%s,%s,%s,%s" : "%5s %6s %6s %9s %10s %9s %11s", "steps", "planes", "rocks", "ms/rock", "rocks/s", "tris", "Mtris/s");
+	for (UINT stage = 0; stage < stageCount; stage++)
+		printf(options.Csv ? ",%s" : " %10s", RockProfiler::GetStageName(RockStage(stage)));
+	printf(options.Csv ? ",%s,%s,%s,%s\n" : " %10s %9s %8s %9s\n", "1st allocs", "allocs", "ico ms", "peak MB");
+
+	RockProfiler trace;
+
+	//SWEEP
+	//-----------------------------------------------------------------------------------------
+	for (UINT steps = options.MinSteps; steps <= options.MaxSteps; steps++)
+	{
+		//The unit sphere of a step count is built once and shared, keep it out of the per rock numbers
+		auto icoStart = std::chrono::steady_clock::now();
+		IcosphereCache::Get(steps);
+		double icoMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - icoStart).count();
+
+		for (UINT planes : options.Planes)
+		{
+			RockParameters parameters;
+			parameters.Width = 1.0f;
+			parameters.Height = 0.8f;
+			parameters.Depth = 1.2f;
+			parameters.Steps = steps;
+			parameters.MinRandAngle = 10.0f;
+			parameters.MaxRandAngle = 350.0f;
+			parameters.MaxOffsetPercent = 25.0f;
+			parameters.MaxPlanes = planes;
+			parameters.NoiseOctaves = options.NoiseOctaves;
+
+			double stageMilliseconds[UINT(RockStage::Count)] = {};
+			UINT64 firstAllocations = 0, warmAllocations = 0;
+			UINT rocks = 0;
+			size_t triangles = 0;
+			double elapsed = 0.0;
+			RockGenerator generator(parameters);
+			RockMesh mesh;
+			auto start = std::chrono::steady_clock::now();
+			while (rocks == 0 || elapsed < options.Seconds * 1000.0)
+			{
+				parameters.Seed = rocks;
+				generator.SetParameters(parameters);
+				RockAllocationCounters before = RockProfiler::GetThreadAllocations();
+				generator.Generate(mesh);
+				UINT64 allocations = RockProfiler::GetThreadAllocations().Count - before.Count;
+				(rocks == 0 ? firstAllocations : warmAllocations) += allocations;
+				triangles += mesh.Indices.size() / 3;
+
+				for (const auto& event : generator.GetProfiler().GetEvents())
+					stageMilliseconds[UINT(event.Stage)] += event.Milliseconds;
+				if (rocks == 0 && !options.TracePath.empty())
+					trace.Append(generator.GetProfiler());
+				rocks++;
+				elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			}
+
+			double msPerRock = elapsed / rocks;
+			printf(options.Csv ? "%u,%u,%u,%.4f,%.2f,%zu,%.3f" : "%5u %6u %6u %9.3f %10.2f %9zu %11.3f",
+				steps, planes, rocks, msPerRock, rocks * 1000.0 / elapsed, triangles / rocks, triangles / (elapsed * 1000.0));
+			for (UINT stage = 0; stage < stageCount; stage++)
+				printf(options.Csv ? ",%.4f" : " %10.3f", stageMilliseconds[stage] / rocks);
+			if (RockProfiler::IsCountingAllocations())
+				printf(options.Csv ? ",%llu,%.1f" : " %10llu %9.1f", (unsigned long long)firstAllocations, rocks > 1 ? (double)warmAllocations / (rocks - 1) : 0.0);
+			else
+				printf(options.Csv ? ",%s,%s" : " %10s %9s", "n/a", "n/a");
+			printf(options.Csv ? ",%.3f,%.1f\n" : " %8.2f %9.1f\n", icoMilliseconds, GetPeakMemory() / (1024.0 * 1024.0));
+			fflush(stdout);
+		}
+	}
+
+	if (!options.TracePath.empty() && !trace.WriteChromeTrace(options.TracePath))
+	{
+		printf("could not write %s\n", options.TracePath.c_str());
+		return 1;
+	}
+	return 0;
+}
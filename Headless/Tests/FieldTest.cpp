@@ -0,0 +1,120 @@
+#include "stdafx.h"
+#include "RockField.h"
+#include "RockTest.h"
+#include <cfloat>
+
+//Scatters the 100k rock field of `RockBench --field 100000 --steps 2-5` and checks that it is complete, that no two
+//rocks stand closer than the Poisson-disk spacing, and that it stays within TIME_BUDGET_MS. Release builds take about
+//125 ms on one hardware thread; the budget leaves room for unoptimised builds and slow machines, but catches a
+//scatter or mesh dedup that turned quadratic. Small fields with a zero, negative or inverted scale range must come out
+//with finite, clamped scales.
+const UINT INSTANCES = 100000;
+const double TIME_BUDGET_MS = 3000.0;
+
+int main()
+{
+	//Same description as RockBench: a square that holds the instances at the default density, cut off at INSTANCES
+	RockFieldDesc desc;
+	float side = sqrtf(INSTANCES / desc.Density) * 1.05f;
+	desc.Max = XMFLOAT2(side, side);
+	desc.MaxInstances = INSTANCES;
+	desc.MinSteps = 2;
+	desc.Parameters.Width = 1.0f;
+	desc.Parameters.Height = 0.8f;
+	desc.Parameters.Depth = 1.2f;
+	desc.Parameters.Steps = 5;
+	desc.Parameters.MinRandAngle = 10.0f;
+	desc.Parameters.MaxRandAngle = 350.0f;
+	desc.Parameters.MaxOffsetPercent = 25.0f;
+	desc.Parameters.MaxPlanes = 25;
+
+	RockField field = RockFieldGenerator::Generate(desc);
+	const RockFieldStats& stats = field.Stats;
+	double total = stats.ScatterMilliseconds + stats.PlaceMilliseconds + stats.MeshMilliseconds;
+	printf("%u instances, %u meshes: scatter %.2f ms, place %.2f ms, meshes %.2f ms (budget %.0f ms)\n", stats.Instances, stats.UniqueMeshes,
+		stats.ScatterMilliseconds, stats.PlaceMilliseconds, stats.MeshMilliseconds, TIME_BUDGET_MS);
+
+	//COUNT
+	//-----------------------------------------------------------------------------------------
+	UINT maxMeshes = desc.VariantCount * (desc.Parameters.Steps - desc.MinSteps + 1);
+	RockTest::Check(field.Instances.size() == INSTANCES && stats.Instances == INSTANCES, "%zu instances (%u in the stats) instead of %u",
+		field.Instances.size(), stats.Instances, INSTANCES);
+	RockTest::Check(field.Meshes.size() == stats.UniqueMeshes && stats.UniqueMeshes <= maxMeshes, "%zu meshes (%u in the stats), at most %u expected",
+		field.Meshes.size(), stats.UniqueMeshes, maxMeshes);
+
+	UINT badMeshes = 0;
+	for (const RockFieldInstance& instance : field.Instances)
+		badMeshes += instance.Mesh < field.Meshes.size() ? 0 : 1;
+	RockTest::Check(badMeshes == 0, "%u instances point past the meshes", badMeshes);
+
+	//SPACING
+	//-----------------------------------------------------------------------------------------
+	//Grid of spacing sized cells, so every pair closer than the spacing lies in the same or a neighbouring cell
+	float spacing = RockFieldGenerator::GetSpacing(desc.Density);
+	UINT columns = (UINT)(side / spacing) + 1;
+	std::vector<std::vector<UINT>> cells(columns * columns);
+	for (UINT i = 0; i < field.Instances.size(); i++)
+	{
+		UINT x = (std::min)((UINT)(field.Instances[i].World._41 / spacing), columns - 1);
+		UINT z = (std::min)((UINT)(field.Instances[i].World._43 / spacing), columns - 1);
+		cells[z * columns + x].push_back(i);
+	}
+
+	float closest = FLT_MAX;
+	for (UINT z = 0; z < columns; z++)
+	{
+		for (UINT x = 0; x < columns; x++)
+		{
+			for (UINT i : cells[z * columns + x])
+			{
+				const XMFLOAT4X4& a = field.Instances[i].World;
+				for (UINT nz = (z > 0 ? z - 1 : 0); nz <= (std::min)(z + 1, columns - 1); nz++)
+				{
+					for (UINT nx = (x > 0 ? x - 1 : 0); nx <= (std::min)(x + 1, columns - 1); nx++)
+					{
+						for (UINT j : cells[nz * columns + nx])
+						{
+							if (j == i)
+								continue;
+							const XMFLOAT4X4& b = field.Instances[j].World;
+							float dx = a._41 - b._41, dz = a._43 - b._43;
+							closest = (std::min)(closest, sqrtf(dx * dx + dz * dz));
+						}
+					}
+				}
+			}
+		}
+	}
+	RockTest::Check(closest >= spacing * (1.0f - 1e-5f), "rocks %g apart, the spacing is %g", closest, spacing);
+
+	//SCALE
+	//-----------------------------------------------------------------------------------------
+	//Scale ranges the log-uniform draw cannot take as they are get clamped: the y axis of a world matrix is the
+	//scale times the y stretch, so it stays finite and within the clamped range
+	const float SCALE_RANGES[][2] = { { 0.0f, 2.0f }, { -1.0f, 0.5f }, { 1.5f, 0.5f } };
+	RockFieldDesc small = desc;
+	small.MaxInstances = 200;
+	small.MinSteps = 1;
+	small.Parameters.Steps = 1;
+	for (const auto& range : SCALE_RANGES)
+	{
+		small.MinScale = range[0];
+		small.MaxScale = range[1];
+		float lowest = (std::max)(0.001f, range[0]);
+		float highest = (std::max)(lowest, range[1]);
+		RockField scaled = RockFieldGenerator::Generate(small);
+		UINT badScales = 0;
+		for (const RockFieldInstance& instance : scaled.Instances)
+		{
+			float y = instance.World._22;
+			badScales += std::isfinite(y) && y >= lowest * (1.0f - small.MaxStretch) * 0.999f && y <= highest * (1.0f + small.MaxStretch) * 1.001f ? 0 : 1;
+		}
+		RockTest::Check(!scaled.Instances.empty() && badScales == 0, "scale range [%g, %g]: %u of %zu rocks scaled outside [%g, %g]",
+			range[0], range[1], badScales, scaled.Instances.size(), lowest, highest);
+	}
+
+	//TIME
+	//-----------------------------------------------------------------------------------------
+	RockTest::Check(total <= TIME_BUDGET_MS, "the field took %.2f ms, the budget is %.0f ms", total, TIME_BUDGET_MS);
+	return RockTest::Result();
+}
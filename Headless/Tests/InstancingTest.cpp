@@ -0,0 +1,151 @@
+#include "stdafx.h"
+#include "RecordingRockDevice.h"
+#include "RockTest.h"
+#include <cfloat>
+
+//Drives RockInstanceRenderer against RecordingRockDevice: a frame of 1005 submissions over 3 meshes and 2 materials,
+//97 of them outside the frustum, has to come out as 908 instances in one upload, 2 material binds, 6 mesh binds and
+//6 instanced draws, each drawing its own contiguous range of the stream in submission order. A scattered RockField
+//goes through SubmitField the same way.
+
+typedef RecordingRockDevice::CommandType CommandType;
+
+//Perspective projection with a 90 degree field of view, camera at the origin looking down +z (row vectors)
+const auto MakeViewProjection = [](float nearZ, float farZ)
+{
+	XMFLOAT4X4 m;
+	memset(&m, 0, sizeof(m));
+	m._11 = 1.0f;
+	m._22 = 1.0f;
+	m._33 = farZ / (farZ - nearZ);
+	m._34 = 1.0f;
+	m._43 = -nearZ * farZ / (farZ - nearZ);
+	return m;
+};
+
+const auto MakeWorld = [](float x, float y, float z)
+{
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, XMMatrixTranslation(x, y, z));
+	return m;
+};
+
+//FRAME
+//*******************************************************************************************************************************
+const auto CheckFrame = []()
+{
+	RecordingRockDevice device;
+	RockInstanceRenderer renderer(&device);
+
+	RockDrawMesh meshes[3];
+	for (UINT i = 0; i < 3; i++)
+	{
+		meshes[i].Mesh = 10 + i;
+		meshes[i].IndexCount = 60 * (i + 1);
+		meshes[i].BoundsRadius = 1.0f;
+	}
+
+	//Mesh and material cycle with the submission index, so every (material, mesh) group gets instances.
+	//y is lifted by a thousandth per submission, which keeps the order inside a group checkable afterwards.
+	renderer.Begin(MakeViewProjection(0.1f, 1000.0f));
+	UINT index = 0;
+	const auto Submit = [&](float x, float y, float z)
+	{
+		renderer.Submit(meshes[index % 3], (index / 3) % 2, MakeWorld(x, y + 0.001f * index, z));
+		index++;
+	};
+	for (UINT i = 0; i < 900; i++)
+		Submit(-9.0f + 0.02f * i, 0.0f, 20.0f);
+	for (UINT i = 0; i < 8; i++)
+		Submit(-20.5f, 0.0f, 20.0f);	//center outside the left plane, sphere still crossing it
+	for (UINT i = 0; i < 33; i++)
+		Submit(0.0f, 0.0f, -20.0f);		//behind the camera
+	for (UINT i = 0; i < 32; i++)
+		Submit(0.0f, 0.0f, 2000.0f);	//past the far plane
+	for (UINT i = 0; i < 32; i++)
+		Submit(0.0f, 500.0f, 20.0f);	//above the top plane
+	renderer.Flush();
+
+	const RockDrawStats& stats = renderer.GetStats();
+	RockTest::Check(stats.Submitted == 1005, "%u submitted instead of 1005", stats.Submitted);
+	RockTest::Check(stats.Visible == 908, "%u visible instead of 908", stats.Visible);
+	RockTest::Check(stats.Draws == 6 && stats.MaterialBinds == 2 && stats.MeshBinds == 6, "%u draws, %u material binds, %u mesh binds instead of 6, 2, 6",
+		stats.Draws, stats.MaterialBinds, stats.MeshBinds);
+
+	RockTest::Check(device.GetCount(CommandType::UploadInstances) == 1, "%u uploads instead of 1", device.GetCount(CommandType::UploadInstances));
+	RockTest::Check(device.GetCount(CommandType::BindMaterial) == 2, "%u material binds recorded", device.GetCount(CommandType::BindMaterial));
+	RockTest::Check(device.GetCount(CommandType::BindMesh) == 6, "%u mesh binds recorded", device.GetCount(CommandType::BindMesh));
+	RockTest::Check(device.GetCount(CommandType::DrawIndexedInstanced) == 6, "%u draws recorded", device.GetCount(CommandType::DrawIndexedInstanced));
+	RockTest::Check(device.GetInstances().size() == 908, "%zu instances uploaded", device.GetInstances().size());
+
+	//Draws cover the stream in order, each with the index count of the mesh bound before it
+	UINT nextInstance = 0, mesh = 0, material = 0;
+	for (const auto& command : device.GetCommands())
+	{
+		if (command.Type == CommandType::BindMaterial)
+			material = command.Handle;
+		if (command.Type == CommandType::BindMesh)
+			mesh = command.Handle;
+		if (command.Type != CommandType::DrawIndexedInstanced)
+			continue;
+
+		RockTest::Check(command.FirstInstance == nextInstance, "draw starts at instance %u instead of %u", command.FirstInstance, nextInstance);
+		RockTest::Check(command.IndexCount == meshes[mesh - 10].IndexCount, "mesh %u drawn with %u indices", mesh, command.IndexCount);
+
+		float previousY = -FLT_MAX;
+		for (UINT i = command.FirstInstance; i < command.FirstInstance + command.InstanceCount && i < device.GetInstances().size(); i++)
+		{
+			float y = device.GetInstances()[i]._42;
+			RockTest::Check(y > previousY, "material %u, mesh %u: instance %u is out of submission order", material, mesh, i);
+			previousY = y;
+		}
+		nextInstance += command.InstanceCount;
+	}
+	RockTest::Check(nextInstance == 908, "draws cover %u instances", nextInstance);
+
+	//A frame with everything culled touches nothing
+	device.Clear();
+	renderer.Begin(MakeViewProjection(0.1f, 1000.0f));
+	renderer.Submit(meshes[0], 0, MakeWorld(0.0f, 0.0f, -20.0f));
+	renderer.Flush();
+	RockTest::Check(device.GetCommands().empty(), "a fully culled frame recorded %zu commands", device.GetCommands().size());
+};
+
+//FIELD
+//*******************************************************************************************************************************
+const auto CheckField = []()
+{
+	RockFieldDesc desc;
+	desc.Min = XMFLOAT2(-50, 0);
+	desc.Max = XMFLOAT2(50, 100);
+	desc.Height = -5.0f;
+	desc.MaxInstances = 2000;
+	desc.VariantCount = 4;
+	desc.Parameters.Steps = 1;
+	RockField field = RockFieldGenerator::Generate(desc, 1);
+
+	std::vector<RockDrawMesh> meshes;
+	for (UINT i = 0; i < field.Meshes.size(); i++)
+		meshes.push_back(RockInstanceRenderer::DescribeMesh(i, field.Meshes[i].Vertices, (UINT)field.Meshes[i].Indices.size()));
+
+	//Looking down +z from the middle of the near edge, about half of the field is in view
+	RecordingRockDevice device;
+	RockInstanceRenderer renderer(&device);
+	renderer.Begin(MakeViewProjection(0.1f, 1000.0f));
+	renderer.SubmitField(field, meshes, 0);
+	renderer.Flush();
+
+	const RockDrawStats& stats = renderer.GetStats();
+	RockTest::Check(stats.Submitted == field.Instances.size(), "field: %u of %zu instances submitted", stats.Submitted, field.Instances.size());
+	RockTest::Check(stats.Visible > 0 && stats.Visible < stats.Submitted, "field: %u of %u instances visible", stats.Visible, stats.Submitted);
+	RockTest::Check(stats.Draws <= field.Meshes.size() && stats.MaterialBinds == 1, "field: %u draws and %u material binds for %zu meshes",
+		stats.Draws, stats.MaterialBinds, field.Meshes.size());
+	RockTest::Check(device.GetCount(CommandType::UploadInstances) == 1, "field: %u uploads", device.GetCount(CommandType::UploadInstances));
+};
+
+int main()
+{
+	CheckFrame();
+	CheckField();
+	return RockTest::Result();
+}
@@ -0,0 +1,127 @@
+#include "stdafx.h"
+#include "RockGenerator.h"
+#include "RockNoise.h"
+#include "RockTest.h"
+
+//Checks the four lane fBm against the scalar reference, and what Displace adds to a rock against the scalar fBm.
+//Both versions hash the lattice exactly, so they may only differ by float rounding in the interpolation:
+//TOLERANCE is per unit of the octaves' summed amplitude, and per unit of the rock's radius for the displacement.
+const float TOLERANCE = 1e-5f;
+
+//FBM4 AGAINST FBM
+//*******************************************************************************************************************************
+const auto CheckFbm4 = []()
+{
+	const UINT seeds[] = { 0, 1, 77, 123456 };
+	const float frequencies[] = { 0.37f, 2.0f, 13.0f };
+
+	//A 24^3 grid over [-1.5, 1.5]^3, off the lattice so the grid does not only hit integer coordinates
+	const UINT GRID = 24;
+	std::vector<float> coordinates(GRID);
+	for (UINT i = 0; i < GRID; i++)
+		coordinates[i] = -1.5f + 3.0f * (i + 0.31f) / GRID;
+
+	float maxError = 0.0f;
+	for (UINT seed : seeds)
+	{
+		for (float frequency : frequencies)
+		{
+			for (UINT count = 1; count <= RockNoiseOctaves::MAX_OCTAVES; count++)
+			{
+				RockNoiseOctaves octaves = RockNoise::MakeOctaves(seed, count, frequency, 1.0f, 2.0f, 0.5f);
+				float amplitudeSum = 0.0f;
+				for (UINT o = 0; o < octaves.Count; o++)
+					amplitudeSum += octaves.Amplitude[o];
+
+				float error = 0.0f;
+				for (UINT z = 0; z < GRID; z++)
+				{
+					for (UINT y = 0; y < GRID; y++)
+					{
+						for (UINT x = 0; x < GRID; x += 4)
+						{
+							XMVECTOR vx = XMVectorSet(coordinates[x], coordinates[x + 1], coordinates[x + 2], coordinates[x + 3]);
+							XMVECTOR vy = XMVectorReplicate(coordinates[y]);
+							XMVECTOR vz = XMVectorReplicate(coordinates[z]);
+							XMFLOAT4 lanes;
+							XMStoreFloat4(&lanes, RockNoise::Fbm4(vx, vy, vz, octaves));
+
+							for (UINT lane = 0; lane < 4; lane++)
+							{
+								float scalar = RockNoise::Fbm(coordinates[x + lane], coordinates[y], coordinates[z], octaves);
+								error = (std::max)(error, fabsf((&lanes.x)[lane] - scalar) / amplitudeSum);
+							}
+						}
+					}
+				}
+				RockTest::Check(error <= TOLERANCE, "seed %u, frequency %g, %u octaves: Fbm4 differs by %g", seed, frequency, count, error);
+				maxError = (std::max)(maxError, error);
+			}
+		}
+	}
+	printf("Largest difference of Fbm4 to Fbm: %g of the amplitude sum (tolerance %g)\n", maxError, TOLERANCE);
+
+	//Octaves past MAX_OCTAVES are cut off
+	RockNoiseOctaves capped = RockNoise::MakeOctaves(1, RockNoiseOctaves::MAX_OCTAVES + 4, 2.0f, 1.0f, 2.0f, 0.5f);
+	RockTest::Check(capped.Count == RockNoiseOctaves::MAX_OCTAVES, "%u octaves made, the cap is %u", capped.Count, UINT(RockNoiseOctaves::MAX_OCTAVES));
+};
+
+//DISPLACEMENT
+//*******************************************************************************************************************************
+//Builds each rock with and without noise; the draw order only depends on the step count, so vertex i is the same
+//vertex in both and their difference is what Displace added. It has to be the fBm at the vertex's icosphere direction
+//along its radial direction, also on the facets BuildRock flattened, whose normals point elsewhere.
+const auto CheckDisplacement = []()
+{
+	const UINT seeds[] = { 3, 11 };
+	for (UINT seed : seeds)
+	{
+		RockParameters parameters;
+		parameters.Width = 1.0f;
+		parameters.Height = 0.8f;
+		parameters.Depth = 1.2f;
+		parameters.Steps = 5;
+		parameters.MinRandAngle = 10.0f;
+		parameters.MaxRandAngle = 350.0f;
+		parameters.MaxOffsetPercent = 25.0f;
+		parameters.MaxPlanes = 8;
+		parameters.Seed = seed;
+		RockMesh flat = RockGenerator(parameters).Generate();
+
+		parameters.NoiseOctaves = 4;
+		parameters.NoiseAmplitude = 0.1f;
+		RockMesh displaced = RockGenerator(parameters).Generate();
+
+		RockNoiseOctaves octaves = RockNoise::MakeOctaves(parameters.NoiseSeed, parameters.NoiseOctaves, parameters.NoiseFrequency,
+			parameters.NoiseAmplitude, parameters.NoiseLacunarity, parameters.NoiseGain);
+		float averageRadius = (parameters.Width + parameters.Height + parameters.Depth) / 3.0f;
+
+		//Output vertex v is split vertex DrawVertices[v], seam copies displace like their source
+		auto level = IcosphereCache::Get(parameters.Steps);
+		UINT numBaseVertices = (UINT)level->Mesh.first.size();
+		float maxError = 0.0f;
+		for (UINT v = 0; v < displaced.Vertices.size(); v++)
+		{
+			UINT vertex = level->DrawVertices[v];
+			if (vertex >= numBaseVertices)
+				vertex = level->SeamSplits[vertex - numBaseVertices].Source;
+
+			const XMFLOAT3& direction = level->Mesh.first[vertex];
+			XMVECTOR radial = XMVector3Normalize(XMVectorMultiply(XMLoadFloat3(&direction),
+				XMVectorSet(parameters.Width, parameters.Height, parameters.Depth, 0.0f)));
+			float offset = RockNoise::Fbm(direction.x, direction.y, direction.z, octaves) * averageRadius;
+
+			XMVECTOR expected = XMVectorScale(radial, offset);
+			XMVECTOR actual = XMLoadFloat3(&displaced.Vertices[v].Position) - XMLoadFloat3(&flat.Vertices[v].Position);
+			maxError = (std::max)(maxError, XMVectorGetX(XMVector3Length(actual - expected)) / averageRadius);
+		}
+		RockTest::Check(maxError <= TOLERANCE, "seed %u: displacement differs from the radial fBm by %g of the radius", seed, maxError);
+	}
+};
+
+int main()
+{
+	CheckFbm4();
+	CheckDisplacement();
+	return RockTest::Result();
+}
@@ -0,0 +1,192 @@
+#include "stdafx.h"
+#include "RockGenerator.h"
+#include "RockPacking.h"
+#include "RockTest.h"
+
+//Round trips of the RockPacking storage forms. Vertices: a packed rock decodes to within half a UNORM16 step of its
+//positions and uvs, and its normals and tangents to within the octahedral SNORM16 angle. Indices: the narrow GPU form
+//and the varint delta form, on rocks whose indices fit 16 and 32 bits, on extreme deltas, the empty buffer, and streams
+//that are cut short or run long.
+
+static_assert(sizeof(VertexRockPacked) == 20, "VertexRockPacked no longer matches the packed input layout");
+
+//VERTICES
+//*******************************************************************************************************************************
+//Half a UNORM16 step of the extent, plus float rounding of min + unorm * extent
+const float UNORM_HALF_STEP = 0.5f / 65535.0f;
+const float UNORM_SLACK = 1e-6f;
+//One SNORM16 step on each octahedral coordinate moves a direction by at most about 2 / 32767 rad
+const float OCTAHEDRAL_MAX_ANGLE = 1e-4f;
+const float UNIT_LENGTH_SLACK = 1e-6f;
+
+//atan2 of cross and dot stays exact for the tiny angles measured here, where acos of the dot rounds to 0
+const auto Angle = [](const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	XMVECTOR va = XMLoadFloat3(&a);
+	XMVECTOR vb = XMLoadFloat3(&b);
+	return atan2f(XMVectorGetX(XMVector3Length(XMVector3Cross(va, vb))), XMVectorGetX(XMVector3Dot(va, vb)));
+};
+
+const auto CheckDirections = []()
+{
+	//Axes, the octahedron edges, and a spiral over the sphere that crosses the folded lower half
+	std::vector<XMFLOAT3> directions = {
+		XMFLOAT3(1, 0, 0), XMFLOAT3(-1, 0, 0), XMFLOAT3(0, 1, 0), XMFLOAT3(0, -1, 0), XMFLOAT3(0, 0, 1), XMFLOAT3(0, 0, -1),
+		XMFLOAT3(1, 1, 0), XMFLOAT3(-1, 0, -1), XMFLOAT3(0, -1, -1), XMFLOAT3(1, -1, -1) };
+	const UINT SPIRAL_POINTS = 4096;
+	for (UINT i = 0; i < SPIRAL_POINTS; i++)
+	{
+		float z = 1.0f - 2.0f * (i + 0.5f) / SPIRAL_POINTS;
+		float r = sqrtf(1.0f - z * z);
+		float phi = i * 2.39996323f;
+		directions.push_back(XMFLOAT3(r * cosf(phi), r * sinf(phi), z));
+	}
+
+	float maxAngle = 0.0f;
+	float maxLengthError = 0.0f;
+	for (const XMFLOAT3& direction : directions)
+	{
+		SHORT encoded[2];
+		RockPacking::EncodeOctahedral(direction, encoded);
+		XMFLOAT3 decoded = RockPacking::DecodeOctahedral(encoded);
+		maxAngle = (std::max)(maxAngle, Angle(direction, decoded));
+		maxLengthError = (std::max)(maxLengthError, fabsf(XMVectorGetX(XMVector3Length(XMLoadFloat3(&decoded))) - 1.0f));
+	}
+	printf("octahedral: %zu directions, max angle %g rad, max length error %g\n", directions.size(), maxAngle, maxLengthError);
+	RockTest::Check(maxAngle <= OCTAHEDRAL_MAX_ANGLE, "octahedral round trip is off by %g rad", maxAngle);
+	RockTest::Check(maxLengthError <= UNIT_LENGTH_SLACK, "DecodeOctahedral returns vectors %g off unit length", maxLengthError);
+};
+
+const auto CheckVertices = []()
+{
+	RockParameters parameters;
+	parameters.Width = 1.3f;
+	parameters.Height = 0.7f;
+	parameters.Depth = 1.0f;
+	parameters.Steps = 5;
+	parameters.MaxPlanes = 20;
+	parameters.NoiseOctaves = 4;
+	RockMesh mesh = RockGenerator(parameters).Generate();
+
+	std::vector<VertexRockPacked> packed;
+	PackedBounds bounds = RockPacking::Pack(mesh.Vertices, packed);
+	std::vector<VertexRock> unpacked;
+	RockPacking::Unpack(packed, bounds, unpacked);
+	RockTest::Check(unpacked.size() == mesh.Vertices.size(), "unpacked %zu of %zu vertices", unpacked.size(), mesh.Vertices.size());
+	if (unpacked.size() != mesh.Vertices.size())
+		return;
+
+	const float positionBound[3] = {
+		bounds.PositionExtent.x * UNORM_HALF_STEP + UNORM_SLACK,
+		bounds.PositionExtent.y * UNORM_HALF_STEP + UNORM_SLACK,
+		bounds.PositionExtent.z * UNORM_HALF_STEP + UNORM_SLACK };
+	const float texCoordBound[2] = {
+		bounds.TexCoordExtent.x * UNORM_HALF_STEP + UNORM_SLACK,
+		bounds.TexCoordExtent.y * UNORM_HALF_STEP + UNORM_SLACK };
+
+	UINT positionErrors = 0, texCoordErrors = 0, mismatchedSingles = 0;
+	float maxNormalAngle = 0.0f, maxTangentAngle = 0.0f;
+	for (size_t i = 0; i < unpacked.size(); i++)
+	{
+		const VertexRock& source = mesh.Vertices[i];
+		const VertexRock& decoded = unpacked[i];
+		bool positionOff = fabsf(decoded.Position.x - source.Position.x) > positionBound[0] ||
+			fabsf(decoded.Position.y - source.Position.y) > positionBound[1] ||
+			fabsf(decoded.Position.z - source.Position.z) > positionBound[2];
+		bool texCoordOff = fabsf(decoded.TexCoord.x - source.TexCoord.x) > texCoordBound[0] ||
+			fabsf(decoded.TexCoord.y - source.TexCoord.y) > texCoordBound[1];
+		positionErrors += positionOff ? 1 : 0;
+		texCoordErrors += texCoordOff ? 1 : 0;
+		maxNormalAngle = (std::max)(maxNormalAngle, Angle(source.Normal, decoded.Normal));
+		maxTangentAngle = (std::max)(maxTangentAngle, Angle(source.Tangent, decoded.Tangent));
+
+		VertexRock single = RockPacking::Unpack(packed[i], bounds);
+		mismatchedSingles += memcmp(&single, &decoded, sizeof(VertexRock)) != 0 ? 1 : 0;
+	}
+
+	printf("vertices: %zu packed to %zu bytes, max normal angle %g rad, max tangent angle %g rad\n",
+		unpacked.size(), packed.size() * sizeof(VertexRockPacked), maxNormalAngle, maxTangentAngle);
+	RockTest::Check(positionErrors == 0, "%u positions are off by more than half a step", positionErrors);
+	RockTest::Check(texCoordErrors == 0, "%u uvs are off by more than half a step", texCoordErrors);
+	RockTest::Check(maxNormalAngle <= OCTAHEDRAL_MAX_ANGLE, "normals are off by %g rad", maxNormalAngle);
+	RockTest::Check(maxTangentAngle <= OCTAHEDRAL_MAX_ANGLE, "tangents are off by %g rad", maxTangentAngle);
+	RockTest::Check(mismatchedSingles == 0, "%u vertices decode differently one at a time", mismatchedSingles);
+};
+
+//INDICES
+//*******************************************************************************************************************************
+const auto CheckIndexRoundTrip = [](const char* name, const std::vector<DWORD>& indices, UINT numVertices, bool expect16Bit)
+{
+	PackedIndices packed = RockPacking::PackIndices(indices, numVertices);
+	std::vector<DWORD> unpacked;
+	RockPacking::UnpackIndices(packed, unpacked);
+	RockTest::Check(packed.Is16Bit == expect16Bit, "%s: packed to %s indices", name, packed.Is16Bit ? "16 bit" : "32 bit");
+	RockTest::Check(unpacked == indices, "%s: PackIndices does not round trip", name);
+
+	std::vector<BYTE> compressed;
+	RockPacking::CompressIndices(indices, compressed);
+	std::vector<DWORD> decompressed(3, 7);
+	bool decoded = RockPacking::DecompressIndices(compressed, decompressed);
+	RockTest::Check(decoded && decompressed == indices, "%s: CompressIndices does not round trip", name);
+
+	//Every shorter stream ends inside the count or a delta, or holds fewer deltas than its count says. Long streams check
+	//their head and tail byte by byte and a stride through the middle, decoding each prefix would be quadratic
+	const size_t EDGE_PREFIXES = 64;
+	const size_t MIDDLE_PREFIXES = 256;
+	size_t stride = (std::max)(size_t(1), compressed.size() / MIDDLE_PREFIXES);
+	UINT acceptedPrefixes = 0;
+	for (size_t length = 0; length < compressed.size();
+		length += length < EDGE_PREFIXES || length + EDGE_PREFIXES >= compressed.size() ? 1 : (std::min)(stride, compressed.size() - EDGE_PREFIXES - length))
+	{
+		std::vector<BYTE> truncated(compressed.begin(), compressed.begin() + length);
+		decompressed.assign(3, 7);
+		bool accepted = RockPacking::DecompressIndices(truncated, decompressed);
+		acceptedPrefixes += accepted || !decompressed.empty() ? 1 : 0;
+	}
+	RockTest::Check(acceptedPrefixes == 0, "%s: %u truncated streams decoded or left indices behind", name, acceptedPrefixes);
+
+	std::vector<BYTE> padded = compressed;
+	padded.push_back(0);
+	RockTest::Check(!RockPacking::DecompressIndices(padded, decompressed) && decompressed.empty(), "%s: a trailing byte was accepted", name);
+	printf("%s: %zu indices, %zu bytes compressed (%.2f per index)\n", name, indices.size(), compressed.size(),
+		indices.empty() ? 0.0 : (double)compressed.size() / indices.size());
+};
+
+const auto CheckIndices = []()
+{
+	RockParameters parameters;
+	parameters.Width = 1.0f;
+	parameters.Height = 0.8f;
+	parameters.Depth = 1.2f;
+	parameters.MaxPlanes = 12;
+
+	parameters.Steps = 4;
+	RockMesh small = RockGenerator(parameters).Generate();
+	CheckIndexRoundTrip("steps 4 rock", small.Indices, (UINT)small.Vertices.size(), true);
+
+	parameters.Steps = 7;
+	RockMesh large = RockGenerator(parameters).Generate();
+	CheckIndexRoundTrip("steps 7 rock", large.Indices, (UINT)large.Vertices.size(), false);
+
+	//Largest jumps both ways, and the values right at the 16 bit limit
+	std::vector<DWORD> extremes = { 0, 0xFFFFFFFFu, 0, 0x80000000u, 0x7FFFFFFFu, 0xFFFEu, 0xFFFFu, 0x10000u, 1, 1, 0 };
+	CheckIndexRoundTrip("extreme deltas", extremes, 0xFFFFFFFFu, false);
+	std::vector<DWORD> limit16 = { 0, 0xFFFEu, 1, 0xFFFEu };
+	CheckIndexRoundTrip("16 bit limit", limit16, 0xFFFFu, true);
+	CheckIndexRoundTrip("empty", std::vector<DWORD>(), 0, true);
+
+	//A count larger than the bytes that follow, and a count that does not fit 32 bits
+	std::vector<DWORD> decompressed;
+	std::vector<BYTE> overcounted = { 0x05, 0x02, 0x02 };
+	RockTest::Check(!RockPacking::DecompressIndices(overcounted, decompressed) && decompressed.empty(), "a count past the data was accepted");
+	std::vector<BYTE> overlong = { 0xFF, 0xFF, 0xFF, 0xFF, 0x7F };
+	RockTest::Check(!RockPacking::DecompressIndices(overlong, decompressed) && decompressed.empty(), "a 35 bit count was accepted");
+};
+
+int main()
+{
+	CheckDirections();
+	CheckVertices();
+	CheckIndices();
+	return RockTest::Result();
+}
@@ -0,0 +1,174 @@
+#include "stdafx.h"
+#include "RockGenerator.h"
+#include "RockTest.h"
+#include <algorithm>
+#include <climits>
+#include <string>
+
+//Checks a progressive rock at every split count: each prefix draws only vertices it has and no triangle with a repeated
+//corner, SetSplitCount lands on the same index buffer whether it refines from the base mesh, coarsens from the full
+//mesh or jumps, GetSplitCountForTriangles picks the largest prefix within a budget, and the fully refined mesh holds
+//exactly the generator's vertices and triangles.
+
+//TRIANGLES
+//*******************************************************************************************************************************
+//A triangle as the bytes of its three vertices, starting at the smallest so the winding survives but the rotation does not
+const auto TriangleKey = [](const std::vector<VertexRock>& vertices, const DWORD* corners)
+{
+	std::string keys[3];
+	for (UINT i = 0; i < 3; i++)
+		keys[i].assign((const char*)&vertices[corners[i]], sizeof(VertexRock));
+	UINT first = (UINT)(std::min_element(keys, keys + 3) - keys);
+	return keys[first] + keys[(first + 1) % 3] + keys[(first + 2) % 3];
+};
+
+const auto TriangleKeys = [](const std::vector<VertexRock>& vertices, const std::vector<DWORD>& indices, UINT triangleCount)
+{
+	std::vector<std::string> keys;
+	keys.reserve(triangleCount);
+	for (UINT t = 0; t < triangleCount; t++)
+		keys.push_back(TriangleKey(vertices, &indices[t * 3]));
+	std::sort(keys.begin(), keys.end());
+	return keys;
+};
+
+const auto VertexKeys = [](const std::vector<VertexRock>& vertices)
+{
+	std::vector<std::string> keys;
+	keys.reserve(vertices.size());
+	for (const VertexRock& vertex : vertices)
+		keys.push_back(std::string((const char*)&vertex, sizeof(VertexRock)));
+	std::sort(keys.begin(), keys.end());
+	return keys;
+};
+
+//CHECKS
+//*******************************************************************************************************************************
+const auto CheckPrefixes = [](const ProgressiveMesh& mesh, std::vector<std::vector<DWORD>>& refined)
+{
+	ProgressiveMeshState state;
+	mesh.Begin(state);
+	UINT badPrefixes = 0, badCounts = 0;
+	refined.clear();
+	for (UINT splitCount = 0; splitCount <= mesh.GetMaxSplitCount(); splitCount++)
+	{
+		mesh.SetSplitCount(state, splitCount);
+		UINT numVertices = mesh.GetVertexCount(splitCount);
+		UINT numTriangles = mesh.GetTriangleCount(splitCount);
+		bool countsMatch = state.SplitCount == splitCount && state.TriangleCount == numTriangles && numTriangles * 3 <= state.Indices.size();
+		bool grows = splitCount == 0 || numTriangles > mesh.GetTriangleCount(splitCount - 1);
+		badCounts += countsMatch && grows ? 0 : 1;
+		if (!countsMatch)
+			continue;
+
+		bool valid = true;
+		for (UINT t = 0; t < numTriangles && valid; t++)
+		{
+			DWORD a = state.Indices[t * 3], b = state.Indices[t * 3 + 1], c = state.Indices[t * 3 + 2];
+			valid = a < numVertices && b < numVertices && c < numVertices && a != b && b != c && c != a;
+		}
+		badPrefixes += valid ? 0 : 1;
+		refined.push_back(state.Indices);
+	}
+	RockTest::Check(badCounts == 0, "%u split counts report the wrong or a shrinking triangle count", badCounts);
+	RockTest::Check(badPrefixes == 0, "%u prefixes draw a missing vertex or a degenerate triangle", badPrefixes);
+};
+
+const auto CheckRoundTrip = [](const ProgressiveMesh& mesh, const std::vector<std::vector<DWORD>>& refined)
+{
+	if (refined.size() != mesh.GetMaxSplitCount() + 1)
+		return;
+
+	//Coarsening from the full mesh undoes every split exactly
+	ProgressiveMeshState state;
+	mesh.Begin(state);
+	mesh.SetSplitCount(state, mesh.GetMaxSplitCount());
+	UINT mismatches = 0;
+	for (UINT splitCount = mesh.GetMaxSplitCount() + 1; splitCount-- > 0;)
+	{
+		mesh.SetSplitCount(state, splitCount);
+		mismatches += state.Indices == refined[splitCount] && state.TriangleCount == mesh.GetTriangleCount(splitCount) ? 0 : 1;
+	}
+	RockTest::Check(mismatches == 0, "%u split counts differ between coarsening and refining", mismatches);
+	RockTest::Check(state.Indices == mesh.Indices, "coarsening to the base mesh does not restore the stored index buffer");
+
+	//Jumps both ways, in a fixed order spread over the whole range
+	const UINT JUMPS = 200;
+	UINT maxSplits = mesh.GetMaxSplitCount();
+	UINT jumpMismatches = 0;
+	for (UINT i = 0; i < JUMPS; i++)
+	{
+		UINT splitCount = (UINT)(((UINT64)i * 7919u) % (maxSplits + 1));
+		mesh.SetSplitCount(state, splitCount);
+		jumpMismatches += state.Indices == refined[splitCount] ? 0 : 1;
+	}
+	RockTest::Check(jumpMismatches == 0, "%u of %u jumps land on a different index buffer", jumpMismatches, JUMPS);
+
+	mesh.SetSplitCount(state, maxSplits + 10);
+	RockTest::Check(state.SplitCount == maxSplits, "SetSplitCount past the end stops at %u of %u splits", state.SplitCount, maxSplits);
+};
+
+const auto CheckBudgets = [](const ProgressiveMesh& mesh)
+{
+	UINT maxSplits = mesh.GetMaxSplitCount();
+	UINT maxTriangles = mesh.GetTriangleCount(maxSplits);
+	UINT wrong = 0;
+	for (UINT budget = 0; budget <= maxTriangles + 1; budget++)
+	{
+		UINT splitCount = mesh.GetSplitCountForTriangles(budget);
+		bool fits = splitCount == 0 || mesh.GetTriangleCount(splitCount) <= budget;
+		bool largest = splitCount == maxSplits || mesh.GetTriangleCount(splitCount + 1) > budget;
+		wrong += splitCount <= maxSplits && fits && largest ? 0 : 1;
+	}
+	RockTest::Check(wrong == 0, "%u triangle budgets pick the wrong split count", wrong);
+	RockTest::Check(mesh.GetSplitCountForTriangles(0) == 0, "a zero budget goes past the base mesh");
+	RockTest::Check(mesh.GetSplitCountForTriangles(UINT_MAX) == maxSplits, "an unlimited budget stops short of the full mesh");
+};
+
+const auto CheckSource = [](const ProgressiveMesh& mesh, const RockMesh& source)
+{
+	UINT maxSplits = mesh.GetMaxSplitCount();
+	UINT sourceTriangles = (UINT)source.Indices.size() / 3;
+	RockTest::Check(mesh.Vertices.size() == mesh.GetVertexCount(maxSplits), "%zu vertices for %u base vertices and %u splits",
+		mesh.Vertices.size(), mesh.BaseVertexCount, maxSplits);
+	RockTest::Check(mesh.GetTriangleCount(maxSplits) == sourceTriangles, "fully refined to %u of %u triangles",
+		mesh.GetTriangleCount(maxSplits), sourceTriangles);
+	RockTest::Check(mesh.BaseTriangleCount < sourceTriangles, "the base mesh has all %u triangles", sourceTriangles);
+
+	ProgressiveMeshState state;
+	mesh.Begin(state);
+	mesh.SetSplitCount(state, maxSplits);
+	RockTest::Check(VertexKeys(mesh.Vertices) == VertexKeys(source.Vertices), "the progressive vertices are not the generated ones");
+	if (mesh.GetTriangleCount(maxSplits) == sourceTriangles)
+	{
+		bool same = TriangleKeys(mesh.Vertices, state.Indices, sourceTriangles) == TriangleKeys(source.Vertices, source.Indices, sourceTriangles);
+		RockTest::Check(same, "the fully refined triangles are not the generated ones");
+	}
+	printf("%u base triangles, %u splits, %u triangles refined\n", mesh.BaseTriangleCount, maxSplits, mesh.GetTriangleCount(maxSplits));
+};
+
+int main()
+{
+	RockParameters parameters;
+	parameters.Width = 1.2f;
+	parameters.Height = 0.8f;
+	parameters.Depth = 1.0f;
+	parameters.Steps = 4;
+	parameters.MaxPlanes = 16;
+	parameters.NoiseOctaves = 3;
+
+	for (UINT seed : { 3u, 11u })
+	{
+		parameters.Seed = seed;
+		RockGenerator generator(parameters);
+		RockMesh source = generator.Generate();
+		ProgressiveMesh mesh = generator.GenerateProgressive();
+
+		std::vector<std::vector<DWORD>> refined;
+		CheckPrefixes(mesh, refined);
+		CheckRoundTrip(mesh, refined);
+		CheckBudgets(mesh);
+		CheckSource(mesh, source);
+	}
+	return RockTest::Result();
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdarg>
+#include <cstdio>
+
+//Minimal checks for the CTest targets in this folder. A failed check prints its message and is counted;
+//main returns RockTest::Result(), so CTest reports the test as failed without stopping at the first mismatch.
+namespace RockTest
+{
+	inline UINT& GetFailures()
+	{
+		static UINT failures = 0;
+		return failures;
+	}
+
+	inline bool Check(bool condition, const char* format, ...)
+	{
+		if (condition)
+			return true;
+
+		va_list args;
+		va_start(args, format);
+		printf("FAILED: ");
+		vprintf(format, args);
+		printf("\n");
+		va_end(args);
+		GetFailures()++;
+		return false;
+	}
+
+	inline int Result()
+	{
+		if (GetFailures() > 0)
+			printf("%u check(s) failed\n", GetFailures());
+		return GetFailures() > 0 ? 1 : 0;
+	}
+}
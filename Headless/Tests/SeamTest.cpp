@@ -0,0 +1,59 @@
+#include "stdafx.h"
+#include "RockGenerator.h"
+#include "RockTest.h"
+
+//Checks the seam and pole splits IcosphereCache plans for CorrectUV: every split copies the corner whose slot it takes,
+//so the split index buffer draws exactly the welded triangles, pole copies keep the pole's v and take the average u of
+//the two other corners, and no generated rock has a triangle collapsed onto one of its corners.
+
+int main()
+{
+	for (UINT steps = 0; steps <= 6; steps++)
+	{
+		auto level = IcosphereCache::Get(steps);
+		const auto& vertices = level->Mesh.first;
+		const auto& triangles = level->Mesh.second;
+
+		//PLAN --------------------------------------------
+		UINT wrongSources = 0, wrongPoles = 0;
+		for (const SeamSplit& split : level->SeamSplits)
+		{
+			if (split.Corner == SeamSplit::NO_INDEX)
+				continue;
+
+			const UINT* corners = triangles[split.Corner / 3].vertex;
+			UINT slot = split.Corner % 3;
+			wrongSources += split.Source != corners[slot] ? 1 : 0;
+
+			if (split.MidpointA != SeamSplit::NO_INDEX)
+			{
+				float v = UVFromVector3(vertices[split.Source]).y;
+				bool isPole = v == 0 || v == 1;
+				bool isOpposite = split.MidpointA == corners[(slot + 1) % 3] && split.MidpointB == corners[(slot + 2) % 3];
+				wrongPoles += isPole && isOpposite ? 0 : 1;
+			}
+		}
+		RockTest::Check(wrongSources == 0, "steps %u: %u splits copy another corner than the one they replace", steps, wrongSources);
+		RockTest::Check(wrongPoles == 0, "steps %u: %u pole splits are not a pole averaging its two other corners", steps, wrongPoles);
+
+		//GENERATED MESH -----------------------------------
+		RockParameters parameters;
+		parameters.Width = 1.0f;
+		parameters.Height = 0.8f;
+		parameters.Depth = 1.2f;
+		parameters.Steps = steps;
+		RockMesh mesh = RockGenerator(parameters).Generate();
+
+		UINT collapsed = 0;
+		for (size_t i = 0; i + 2 < mesh.Indices.size(); i += 3)
+		{
+			XMVECTOR P0 = XMLoadFloat3(&mesh.Vertices[mesh.Indices[i]].Position);
+			XMVECTOR P1 = XMLoadFloat3(&mesh.Vertices[mesh.Indices[i + 1]].Position);
+			XMVECTOR P2 = XMLoadFloat3(&mesh.Vertices[mesh.Indices[i + 2]].Position);
+			collapsed += XMVectorGetX(XMVector3LengthSq(XMVector3Cross(P1 - P0, P2 - P0))) > 0.0f ? 0 : 1;
+		}
+		RockTest::Check(collapsed == 0, "steps %u: %u triangles have no area", steps, collapsed);
+	}
+
+	return RockTest::Result();
+}
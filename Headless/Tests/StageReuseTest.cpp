@@ -0,0 +1,134 @@
+#include "stdafx.h"
+#include "RockAsyncBuilder.h"
+#include "RockTest.h"
+
+//Changes one parameter group after the other on generators with stage reuse on, and on a RockAsyncBuilder, which
+//keeps such a generator. After every change the reused output has to be byte for byte what a fresh generator builds
+//from the same parameters, and only the stages the change feeds may have run.
+
+struct ParameterChange
+{
+	const char* Name;
+	void(*Apply)(RockParameters& parameters);
+	//Whether BuildIco has to rerun; with false no stage at all may run when NothingRuns is set
+	bool RebuildsIco;
+	bool NothingRuns;
+};
+
+const ParameterChange CHANGES[] =
+{
+	{ "width", [](RockParameters& p) { p.Width = 1.3f; }, true, false },
+	{ "depth", [](RockParameters& p) { p.Depth = 0.9f; }, true, false },
+	{ "max planes", [](RockParameters& p) { p.MaxPlanes = 20; }, false, false },
+	{ "seed", [](RockParameters& p) { p.Seed = 6; }, false, false },
+	{ "plane angles", [](RockParameters& p) { p.MinRandAngle = 30.0f; p.MaxRandAngle = 300.0f; }, false, false },
+	{ "plane offset", [](RockParameters& p) { p.MaxOffsetPercent = 15.0f; }, false, false },
+	{ "steps up", [](RockParameters& p) { p.Steps = 5; }, true, false },
+	{ "steps back", [](RockParameters& p) { p.Steps = 4; }, true, false },
+	{ "noise octaves", [](RockParameters& p) { p.NoiseOctaves = 5; }, false, false },
+	{ "noise shape", [](RockParameters& p) { p.NoiseFrequency = 3.0f; p.NoiseAmplitude = 0.08f; p.NoiseLacunarity = 1.8f; p.NoiseGain = 0.6f; }, false, false },
+	{ "noise seed", [](RockParameters& p) { p.NoiseSeed = 9; }, false, false },
+	{ "noise off", [](RockParameters& p) { p.NoiseOctaves = 0; }, false, false },
+	{ "unread", [](RockParameters& p) { p.MaxRandShift = 1.0f; p.MinPlaneVerts = 3; p.MaxPlaneVerts = 9; }, false, true },
+	{ "nothing", [](RockParameters&) {}, false, true },
+};
+
+const UINT LOD_COUNT = 3;
+
+//COMPARISON
+//*******************************************************************************************************************************
+const auto IsSameMesh = [](const std::vector<VertexRock>& vertices, const std::vector<DWORD>& indices, const RockMesh& reference)
+{
+	return vertices.size() == reference.Vertices.size() && indices == reference.Indices &&
+		memcmp(vertices.data(), reference.Vertices.data(), vertices.size() * sizeof(VertexRock)) == 0;
+};
+
+const auto HasStage = [](const RockProfiler& profiler, RockStage stage)
+{
+	for (const auto& event : profiler.GetEvents())
+	{
+		if (event.Stage == stage)
+			return true;
+	}
+	return false;
+};
+
+int main()
+{
+	RockParameters parameters;
+	parameters.Width = 1.0f;
+	parameters.Height = 0.8f;
+	parameters.Depth = 1.2f;
+	parameters.Steps = 4;
+	parameters.MinRandAngle = 10.0f;
+	parameters.MaxRandAngle = 350.0f;
+	parameters.MaxOffsetPercent = 25.0f;
+	parameters.MaxPlanes = 12;
+	parameters.Seed = 5;
+	parameters.NoiseOctaves = 3;
+
+	RockGenerator single(parameters), chain(parameters);
+	single.SetStageReuse(true);
+	chain.SetStageReuse(true);
+	RockMesh mesh;
+	std::vector<RockLod> lods;
+	single.Generate(mesh);
+	chain.GenerateLods(LOD_COUNT, lods);
+
+	RockAsyncBuilder builder;
+	RockBuildRequest request;
+	request.LodCount = LOD_COUNT;
+
+	for (const ParameterChange& change : CHANGES)
+	{
+		change.Apply(parameters);
+		RockGenerator fresh(parameters);
+		RockMesh reference = fresh.Generate();
+		std::vector<RockLod> referenceLods = fresh.GenerateLods(LOD_COUNT);
+
+		//ONE LOD ----------------------------------------
+		single.SetParameters(parameters);
+		single.Generate(mesh);
+		RockTest::Check(IsSameMesh(mesh.Vertices, mesh.Indices, reference), "%s: reused Generate differs from a fresh one", change.Name);
+		RockTest::Check(HasStage(single.GetProfiler(), RockStage::Ico) == change.RebuildsIco, "%s: Generate %s BuildIco", change.Name,
+			change.RebuildsIco ? "skipped" : "reran");
+		if (change.NothingRuns)
+			RockTest::Check(single.GetProfiler().GetEvents().empty(), "%s: Generate ran %zu stages", change.Name, single.GetProfiler().GetEvents().size());
+
+		//LOD CHAIN ----------------------------------------
+		chain.SetParameters(parameters);
+		chain.GenerateLods(LOD_COUNT, lods);
+		bool sameLods = lods.size() == referenceLods.size();
+		for (size_t i = 0; sameLods && i < lods.size(); i++)
+		{
+			sameLods = IsSameMesh(lods[i].Mesh.Vertices, lods[i].Mesh.Indices, referenceLods[i].Mesh) &&
+				lods[i].Steps == referenceLods[i].Steps && lods[i].GeometricError == referenceLods[i].GeometricError;
+		}
+		RockTest::Check(sameLods, "%s: reused GenerateLods differs from a fresh one", change.Name);
+		if (change.NothingRuns)
+			RockTest::Check(chain.GetProfiler().GetEvents().empty(), "%s: GenerateLods ran %zu stages", change.Name, chain.GetProfiler().GetEvents().size());
+
+		//ASYNC BUILDER ------------------------------------
+		//An equal request is dropped without a build, so only changes of a read or unread parameter produce a result
+		request.Parameters = parameters;
+		builder.Request(request);
+		builder.Wait();
+		std::unique_ptr<RockBuildResult> result = builder.TakeResult();
+		if (!result)
+		{
+			RockTest::Check(strcmp(change.Name, "nothing") == 0, "%s: the builder built nothing", change.Name);
+			continue;
+		}
+
+		bool sameBuild = result->Lods.size() == referenceLods.size();
+		for (size_t i = 0; sameBuild && i < result->Lods.size(); i++)
+		{
+			std::vector<DWORD> indices;
+			RockPacking::UnpackIndices(result->Lods[i].Indices, indices);
+			sameBuild = IsSameMesh(result->Lods[i].Vertices, indices, referenceLods[i].Mesh);
+		}
+		RockTest::Check(sameBuild, "%s: the builder's rebuild differs from a fresh one", change.Name);
+	}
+
+	return RockTest::Result();
+}
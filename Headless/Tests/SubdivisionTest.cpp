@@ -0,0 +1,78 @@
+#include "stdafx.h"
+#include "IcosphereTables.h"
+#include "RockTest.h"
+#include <map>
+
+//Checks that the open-addressed edge table and the compile time tables subdivide the icosphere bit for bit like
+//the original std::map implementation, kept below as the reference: same vertex numbering, same positions, same
+//triangles, for every level up to 7.
+
+//REFERENCE
+//*******************************************************************************************************************************
+using ReferenceLookup = std::map<std::pair<UINT, UINT>, UINT>;
+
+const auto ReferenceVertexForEdge = [](ReferenceLookup& lookup, VertexList& vertices, UINT first, UINT second)
+{
+	ReferenceLookup::key_type key(first, second);
+	if (key.first > key.second)
+		std::swap(key.first, key.second);
+
+	auto inserted = lookup.insert({ key, (UINT)vertices.size() });
+	if (inserted.second)
+	{
+		auto edge0 = XMLoadFloat3(&vertices[first]);
+		auto edge1 = XMLoadFloat3(&vertices[second]);
+		auto point = edge0 + edge1;
+		XMFLOAT3 newVert;
+		XMStoreFloat3(&newVert, XMVector3Normalize(point));
+		vertices.push_back(newVert);
+	}
+
+	return inserted.first->second;
+};
+
+const auto ReferenceSubdivide = [](VertexList& vertices, const TriangleList& triangles)
+{
+	ReferenceLookup lookup;
+	TriangleList result;
+
+	for (auto&& each : triangles)
+	{
+		UINT mid[3];
+		for (int edge = 0; edge < 3; ++edge)
+			mid[edge] = ReferenceVertexForEdge(lookup, vertices, each.vertex[edge], each.vertex[(edge + 1) % 3]);
+		result.push_back({ each.vertex[0], mid[0], mid[2] });
+		result.push_back({ each.vertex[1], mid[1], mid[0] });
+		result.push_back({ each.vertex[2], mid[2], mid[1] });
+		result.push_back({ mid[0], mid[1], mid[2] });
+	}
+
+	return result;
+};
+
+//COMPARISON
+//*******************************************************************************************************************************
+const auto IsSameMesh = [](const IndexedMesh& mesh, const IndexedMesh& reference)
+{
+	return mesh.first.size() == reference.first.size() && mesh.second.size() == reference.second.size() &&
+		memcmp(mesh.first.data(), reference.first.data(), mesh.first.size() * sizeof(XMFLOAT3)) == 0 &&
+		memcmp(mesh.second.data(), reference.second.data(), mesh.second.size() * sizeof(Triangle)) == 0;
+};
+
+int main()
+{
+	const UINT MAX_STEPS = 7;
+
+	IndexedMesh reference{ icosahedron::vertices, icosahedron::triangles };
+	for (UINT steps = 0; steps <= MAX_STEPS; steps++)
+	{
+		if (steps > 0)
+			reference.second = ReferenceSubdivide(reference.first, reference.second);
+
+		RockTest::Check(reference.first.size() == IcosphereTables::GetVertexCount(steps), "reference level %u has %zu vertices", steps, reference.first.size());
+		RockTest::Check(IsSameMesh(MakeIcosphere((int)steps), reference), "MakeIcosphere(%u) differs from the std::map reference", steps);
+		RockTest::Check(IsSameMesh(IcosphereTables::MakeIcosphere(steps), reference), "IcosphereTables::MakeIcosphere(%u) differs from the std::map reference", steps);
+	}
+
+	return RockTest::Result();
+}
@@ -0,0 +1,191 @@
+#include "stdafx.h"
+#include "RockGenerator.h"
+#include "RockTest.h"
+
+//Checks BuildSurface, which gathers normals and tangents per vertex in one sweep, against the two passes it replaced:
+//BuildNormals accumulating face normals on the welded mesh before CorrectUV, and BuildTangents accumulating face tangents
+//on the seam split index buffer after it. The reference reruns both passes on the rock's own shape, recovered from the
+//generated mesh and its icosphere level, and every normal and tangent must match within TOLERANCE per component.
+//Rocks with noise check that the normals follow the displaced surface as well.
+const float TOLERANCE = 1e-5f;
+
+//REFERENCE
+//*******************************************************************************************************************************
+//Normals before BuildSurface: BuildIco's direction of the scaled sphere, replaced by the plane normal wherever
+//BuildRock flattened the vertex (the same per vertex test as BuildRock, without its patch culling)
+const auto ReferenceStartNormals = [](const RockParameters& parameters, const std::vector<RockGenerator::Plane>& planes, const VertexList& sphere,
+	std::vector<XMFLOAT3>& normals, std::vector<XMFLOAT3>& radial)
+{
+	normals.resize(sphere.size());
+	radial.resize(sphere.size());
+	for (size_t i = 0; i < sphere.size(); i++)
+	{
+		XMFLOAT3 point;
+		XMStoreFloat3(&point, XMVector3Normalize(XMVector3Normalize(XMLoadFloat3(&sphere[i]))));
+		point.x *= parameters.Width;
+		point.y *= parameters.Height;
+		point.z *= parameters.Depth;
+		XMStoreFloat3(&radial[i], XMVector3Normalize(XMVector3Normalize(XMLoadFloat3(&point))));
+		normals[i] = radial[i];
+
+		for (const auto& plane : planes)
+		{
+			float dist = (point.x - plane.origin.x) * plane.normal.x + (point.y - plane.origin.y) * plane.normal.y + (point.z - plane.origin.z) * plane.normal.z;
+			if (dist < 0.0f)
+				continue;
+
+			float projX = point.x - dist * plane.normal.x - plane.origin.x;
+			float projY = point.y - dist * plane.normal.y - plane.origin.y;
+			float projZ = point.z - dist * plane.normal.z - plane.origin.z;
+			float strength = (1.0f / plane.diameter) * sqrtf(projX * projX + projY * projY + projZ * projZ) - 1.0f;
+			float push = dist * 0.5f;
+			point.x = point.x - push * plane.normal.x * strength;
+			point.y = point.y - push * plane.normal.y * strength;
+			point.z = point.z - push * plane.normal.z * strength;
+			normals[i] = plane.normal;
+		}
+	}
+};
+
+//The old BuildNormals and BuildTangents on the split mesh (base vertices, then one per seam split)
+const auto ReferenceSurface = [](const IcosphereLevel& level, const std::vector<XMFLOAT3>& positions, const std::vector<XMFLOAT2>& texCoords,
+	std::vector<XMFLOAT3>& normals, std::vector<XMFLOAT3>& tangents)
+{
+	const auto& triangles = level.Mesh.second;
+	const auto& splits = level.SeamSplits;
+	size_t numBaseVertices = level.Mesh.first.size();
+
+	//BuildNormals, before CorrectUV: welded triangles, then the copies take their source's normal
+	for (const auto& triangle : triangles)
+	{
+		XMFLOAT3 normal = ComputeNormal(positions[triangle.vertex[0]], positions[triangle.vertex[1]], positions[triangle.vertex[2]]);
+		for (UINT corner = 0; corner < 3; corner++)
+			normals[triangle.vertex[corner]] = AddXMFLOAT3(normals[triangle.vertex[corner]], normal);
+	}
+	for (size_t i = 0; i < numBaseVertices; i++)
+		normals[i] = NormalizeXMFLOAT3(normals[i]);
+	for (size_t i = 0; i < splits.size(); i++)
+		normals[numBaseVertices + i] = normals[splits[i].Source];
+
+	//BuildTangents, after CorrectUV: the index buffer with the split corners moved to their copies
+	std::vector<UINT> indices(triangles.size() * 3);
+	for (size_t tri = 0; tri < triangles.size(); tri++)
+		for (UINT corner = 0; corner < 3; corner++)
+			indices[tri * 3 + corner] = triangles[tri].vertex[corner];
+	for (size_t i = 0; i < splits.size(); i++)
+		if (splits[i].Corner != SeamSplit::NO_INDEX)
+			indices[splits[i].Corner] = (UINT)(numBaseVertices + i);
+
+	for (size_t idx = 0; idx + 2 < indices.size(); idx += 3)
+	{
+		UINT idx0 = indices[idx], idx1 = indices[idx + 1], idx2 = indices[idx + 2];
+		XMFLOAT3 tangent = ComputeTangent(positions[idx0], positions[idx1], positions[idx2], texCoords[idx0], texCoords[idx1], texCoords[idx2]);
+		tangents[idx0] = AddXMFLOAT3(tangents[idx0], tangent);
+		tangents[idx1] = AddXMFLOAT3(tangents[idx1], tangent);
+		tangents[idx2] = AddXMFLOAT3(tangents[idx2], tangent);
+	}
+	for (auto& tangent : tangents)
+		tangent = NormalizeXMFLOAT3(tangent);
+};
+
+//COMPARISON
+//*******************************************************************************************************************************
+const auto GetDifference = [](const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	return (std::max)((std::max)(fabsf(a.x - b.x), fabsf(a.y - b.y)), fabsf(a.z - b.z));
+};
+
+int main()
+{
+	const XMFLOAT3 sizes[] = { XMFLOAT3(1.0f, 0.8f, 1.2f), XMFLOAT3(2.0f, 0.5f, 1.0f) };
+	const UINT planeCounts[] = { 0, 8, 40 };
+	const UINT seeds[] = { 1, 7 };
+	const UINT noiseOctaves[] = { 0, 4 };
+
+	float maxNormalError = 0.0f, maxTangentError = 0.0f;
+	for (UINT steps = 0; steps <= 6; steps++)
+	{
+		for (const XMFLOAT3& size : sizes)
+		{
+			for (UINT planes : planeCounts)
+			{
+				for (UINT octaves : noiseOctaves)
+				{
+					for (UINT seed : seeds)
+					{
+						RockParameters parameters;
+						parameters.Width = size.x;
+						parameters.Height = size.y;
+						parameters.Depth = size.z;
+						parameters.Steps = steps;
+						parameters.MinRandAngle = 10.0f;
+						parameters.MaxRandAngle = 350.0f;
+						parameters.MaxOffsetPercent = 25.0f;
+						parameters.MaxPlanes = planes;
+						parameters.Seed = seed;
+						parameters.NoiseOctaves = octaves;
+
+						RockGenerator generator(parameters);
+						RockMesh mesh = generator.Generate();
+						auto level = IcosphereCache::Get(steps);
+
+						//Back from draw order to the split mesh: output vertex v is split vertex DrawVertices[v]. Vertices in no
+						//triangle are left out of the draw order: copies a later split took over, and the poles, whose corners all
+						//moved to copies. A pole takes the position of its copies, a dropped copy that of its source.
+						size_t numBaseVertices = level->Mesh.first.size();
+						size_t numSplitVertices = numBaseVertices + level->SeamSplits.size();
+						std::vector<UINT> output(numSplitVertices, UINT(SeamSplit::NO_INDEX));
+						for (UINT v = 0; v < level->DrawVertices.size(); v++)
+							output[level->DrawVertices[v]] = v;
+
+						std::vector<XMFLOAT3> positions(numSplitVertices), normals, tangents, radial;
+						std::vector<XMFLOAT2> texCoords(numSplitVertices);
+						for (size_t i = 0; i < numSplitVertices; i++)
+						{
+							if (output[i] == SeamSplit::NO_INDEX)
+								continue;
+							positions[i] = mesh.Vertices[output[i]].Position;
+							texCoords[i] = mesh.Vertices[output[i]].TexCoord;
+						}
+						for (size_t i = 0; i < level->SeamSplits.size(); i++)
+						{
+							UINT source = level->SeamSplits[i].Source;
+							if (output[source] == SeamSplit::NO_INDEX && output[numBaseVertices + i] != SeamSplit::NO_INDEX)
+								positions[source] = positions[numBaseVertices + i];
+						}
+						for (size_t i = 0; i < level->SeamSplits.size(); i++)
+						{
+							if (output[numBaseVertices + i] == SeamSplit::NO_INDEX)
+								positions[numBaseVertices + i] = positions[level->SeamSplits[i].Source];
+						}
+
+						//Tangents start out as the radial normal, BuildRock only replaces the normals
+						ReferenceStartNormals(parameters, generator.GetPlanes(), level->Mesh.first, normals, radial);
+						tangents = radial;
+						normals.resize(numSplitVertices);
+						tangents.resize(numSplitVertices);
+						for (size_t i = 0; i < level->SeamSplits.size(); i++)
+							tangents[numBaseVertices + i] = radial[level->SeamSplits[i].Source];
+						ReferenceSurface(*level, positions, texCoords, normals, tangents);
+
+						float normalError = 0.0f, tangentError = 0.0f;
+						for (size_t i = 0; i < numSplitVertices; i++)
+						{
+							if (output[i] == SeamSplit::NO_INDEX)
+								continue;
+							normalError = (std::max)(normalError, GetDifference(mesh.Vertices[output[i]].Normal, normals[i]));
+							tangentError = (std::max)(tangentError, GetDifference(mesh.Vertices[output[i]].Tangent, tangents[i]));
+						}
+						RockTest::Check(normalError <= TOLERANCE, "steps %u, %u planes, seed %u, %u octaves: normals differ by %g", steps, planes, seed, octaves, normalError);
+						RockTest::Check(tangentError <= TOLERANCE, "steps %u, %u planes, seed %u, %u octaves: tangents differ by %g", steps, planes, seed, octaves, tangentError);
+						maxNormalError = (std::max)(maxNormalError, normalError);
+						maxTangentError = (std::max)(maxTangentError, tangentError);
+					}
+				}
+			}
+		}
+	}
+
+	printf("Largest difference to the two pass reference: normals %g, tangents %g (tolerance %g)\n", maxNormalError, maxTangentError, TOLERANCE);
+	return RockTest::Result();
+}
@@ -0,0 +1,94 @@
+#include "stdafx.h"
+#include "RockGenerator.h"
+#include "RockTest.h"
+#include <algorithm>
+#include <array>
+
+//Checks the draw order IcosphereCache plans with VertexCacheOptimizer: a generated rock's GetVertexCacheReport must show
+//fewer transformed vertices per triangle after the reorder than before, the reported numbers must be those of the index
+//buffer Generate returns, vertices must be numbered in first-use order, and mapping the reordered and renumbered
+//indices back through DrawVertices must give exactly the triangles of the seam split mesh, each with its winding.
+
+//TRIANGLES
+//*******************************************************************************************************************************
+//Triangles as sorted corner triples, each rotated to start at its smallest corner so the winding is kept
+const auto TriangleSet = [](const std::vector<DWORD>& indices, const std::vector<UINT>* pVertexMap)
+{
+	std::vector<std::array<DWORD, 3>> triangles(indices.size() / 3);
+	for (size_t t = 0; t < triangles.size(); t++)
+	{
+		std::array<DWORD, 3> corners;
+		for (UINT i = 0; i < 3; i++)
+			corners[i] = pVertexMap ? (*pVertexMap)[indices[t * 3 + i]] : indices[t * 3 + i];
+		UINT first = (UINT)(std::min_element(corners.begin(), corners.end()) - corners.begin());
+		triangles[t] = { corners[first], corners[(first + 1) % 3], corners[(first + 2) % 3] };
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+};
+
+//The index buffer before the reorder, rebuilt the way IcosphereCache does: the level's triangles with the seam splits applied
+const auto SplitIndices = [](const IcosphereLevel& level)
+{
+	std::vector<DWORD> indices;
+	for (const auto& triangle : level.Mesh.second)
+	{
+		indices.push_back(triangle.vertex[0]);
+		indices.push_back(triangle.vertex[1]);
+		indices.push_back(triangle.vertex[2]);
+	}
+	for (UINT i = 0; i < level.SeamSplits.size(); i++)
+	{
+		if (level.SeamSplits[i].Corner != UINT(SeamSplit::NO_INDEX))
+			indices[level.SeamSplits[i].Corner] = (DWORD)(level.Mesh.first.size() + i);
+	}
+	return indices;
+};
+
+int main()
+{
+	RockParameters parameters;
+	parameters.Width = 1.1f;
+	parameters.Height = 0.9f;
+	parameters.Depth = 1.0f;
+	parameters.MaxPlanes = 12;
+
+	for (UINT steps = 1; steps <= 6; steps++)
+	{
+		parameters.Steps = steps;
+		RockGenerator generator(parameters);
+		RockMesh mesh = generator.Generate();
+		const VertexCacheReport& report = generator.GetVertexCacheReport();
+		printf("steps %u: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", steps, report.Before.ACMR, report.After.ACMR, report.Before.ATVR, report.After.ATVR);
+
+		RockTest::Check(report.After.ACMR < report.Before.ACMR, "steps %u: ACMR went from %.3f to %.3f", steps, report.Before.ACMR, report.After.ACMR);
+		RockTest::Check(report.After.ATVR <= report.Before.ATVR, "steps %u: ATVR went from %.3f to %.3f", steps, report.Before.ATVR, report.After.ATVR);
+		VertexCacheStats measured = VertexCacheOptimizer::Measure(mesh.Indices, (UINT)mesh.Vertices.size());
+		RockTest::Check(measured.ACMR == report.After.ACMR && measured.ATVR == report.After.ATVR,
+			"steps %u: the report does not describe the generated index buffer", steps);
+
+		//The renumbering keeps every vertex a triangle uses once, drops the rest (splits a later split took the corner
+		//from), and the triangles survive it unchanged
+		auto level = IcosphereCache::Get(steps);
+		std::vector<DWORD> before = SplitIndices(*level);
+		std::vector<UINT> usedVertices(before.begin(), before.end());
+		std::sort(usedVertices.begin(), usedVertices.end());
+		usedVertices.erase(std::unique(usedVertices.begin(), usedVertices.end()), usedVertices.end());
+		std::vector<UINT> keptVertices = level->DrawVertices;
+		std::sort(keptVertices.begin(), keptVertices.end());
+		RockTest::Check(keptVertices == usedVertices, "steps %u: DrawVertices keeps %zu vertices, the split mesh uses %zu",
+			steps, keptVertices.size(), usedVertices.size());
+		DWORD nextVertex = 0;
+		bool firstUseOrder = true;
+		for (DWORD index : level->DrawIndices)
+		{
+			firstUseOrder = firstUseOrder && index <= nextVertex;
+			nextVertex += index == nextVertex ? 1 : 0;
+		}
+		RockTest::Check(firstUseOrder, "steps %u: vertices are not numbered in the order the indices first use them", steps);
+		RockTest::Check(mesh.Indices == level->DrawIndices, "steps %u: Generate does not return the planned draw order", steps);
+		RockTest::Check(TriangleSet(level->DrawIndices, &level->DrawVertices) == TriangleSet(before, nullptr),
+			"steps %u: the reordered triangles differ from the seam split mesh", steps);
+	}
+	return RockTest::Result();
+}
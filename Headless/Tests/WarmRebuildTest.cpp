@@ -0,0 +1,53 @@
+#include "stdafx.h"
+#include "RockAsyncBuilder.h"
+#include "RockTest.h"
+
+//Links RockAllocationHook, so the stage events count heap allocations. The first build of a RockAsyncBuilder sizes
+//its generator's buffers; every later build of the same size, here new seeds and noise, must allocate nothing in any
+//stage, also when the stages run on a pool worker.
+
+int main()
+{
+	RockTest::Check(RockProfiler::IsCountingAllocations(), "the allocation hook is not linked");
+
+	RockBuildRequest request;
+	request.Parameters.Width = 1.0f;
+	request.Parameters.Height = 0.8f;
+	request.Parameters.Depth = 1.2f;
+	request.Parameters.Steps = 5;
+	request.Parameters.MinRandAngle = 10.0f;
+	request.Parameters.MaxRandAngle = 350.0f;
+	request.Parameters.MaxOffsetPercent = 25.0f;
+	request.Parameters.MaxPlanes = 25;
+	request.Parameters.NoiseOctaves = 4;
+	request.LodCount = 3;
+
+	RockAsyncBuilder builder;
+	for (UINT build = 0; build < 4; build++)
+	{
+		request.Parameters.Seed = build;
+		request.Parameters.NoiseSeed = build * 7;
+		builder.Request(request);
+		builder.Wait();
+		std::unique_ptr<RockBuildResult> result = builder.TakeResult();
+		if (!RockTest::Check(result != nullptr, "build %u: no result", build))
+			continue;
+
+		UINT64 allocations = 0;
+		for (const RockStageEvent& event : result->Profiler.GetEvents())
+		{
+			RockTest::Check(event.HasAllocations, "build %u: %s has no allocation count", build, RockProfiler::GetStageName(event.Stage));
+			allocations += event.Allocations;
+			if (build > 0)
+			{
+				RockTest::Check(event.Allocations == 0, "build %u: %s of LOD %u allocated %llu times (%llu bytes)", build,
+					RockProfiler::GetStageName(event.Stage), event.Lod, (unsigned long long)event.Allocations, (unsigned long long)event.AllocatedBytes);
+			}
+		}
+		printf("build %u: %llu allocations in %zu stages\n", build, (unsigned long long)allocations, result->Profiler.GetEvents().size());
+		if (build == 0)
+			RockTest::Check(allocations > 0, "the cold build counted no allocations");
+	}
+
+	return RockTest::Result();
+}
@@ -0,0 +1,36 @@
+#pragma once
+//Headless replacement for the engine's VertexStructs.h: DirectXMath, the Windows integer types and
+//the two engine vertex layouts RockHeader.h refers to
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cstdint>
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef uint32_t UINT;
+typedef int16_t SHORT;
+typedef uint64_t UINT64;
+#endif
+
+#include <vector>
+#include <DirectXMath.h>
+using namespace DirectX;
+
+struct VertexPosNormTex
+{
+	XMFLOAT3 Position;
+	XMFLOAT3 Normal;
+	XMFLOAT2 TexCoord;
+};
+
+struct VertexBase
+{
+	XMFLOAT3 Position;
+	XMFLOAT3 Normal;
+	XMFLOAT3 Tangent;
+	XMFLOAT2 TexCoord;
+};
@@ -0,0 +1,11 @@
+#pragma once
+//Stand-in for the engine's precompiled header when the rock generator is built without the engine
+//(see CMakeLists.txt). Only the pure math part of the repository compiles against it.
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "VertexStructs.h"
@@ -0,0 +1,234 @@
+#include "stdafx.h"
+#include "IcosphereCache.h"
+#include "IcosphereTables.h"
+
+std::mutex IcosphereCache::m_Mutex;
+std::map<UINT, IcosphereCache::IcosphereRef> IcosphereCache::m_Levels;
+
+IcosphereCache::IcosphereRef IcosphereCache::Get(UINT steps)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	auto it = m_Levels.find(steps);
+	if (it != m_Levels.end())
+		return it->second;
+
+	//Built under the lock so concurrent callers for the same level wait instead of subdividing twice
+	auto level = std::make_shared<IcosphereLevel>();
+	level->Mesh = IcosphereTables::MakeIcosphere(steps);
+	BuildPatches(*level, steps);
+	BuildAdjacency(*level);
+	BuildSeamSplits(*level);
+	BuildDrawOrder(*level);
+
+	IcosphereRef ref = level;
+	m_Levels[steps] = ref;
+	return ref;
+}
+
+void IcosphereCache::BuildPatches(IcosphereLevel& level, UINT steps)
+{
+	const auto& vertices = level.Mesh.first;
+	const auto& triangles = level.Mesh.second;
+
+	//SubdivideTriangle emits the 4 children of a triangle back to back, so triangle t
+	//descends from triangle t / 4^k of the level k steps coarser
+	UINT depth = steps < IcosphereLevel::PATCH_DEPTH ? steps : IcosphereLevel::PATCH_DEPTH;
+	UINT trianglesPerPatch = 1u << (2 * depth);
+	UINT patchCount = (UINT)triangles.size() / trianglesPerPatch;
+	level.PatchesPerFace = patchCount / (UINT)icosahedron::triangles.size();
+
+	//Each vertex belongs to the patch of the first triangle that uses it
+	const UINT unassigned = ~0u;
+	std::vector<UINT> vertexPatch(vertices.size(), unassigned);
+	std::vector<UINT> patchSizes(patchCount, 0);
+	for (UINT t = 0; t < triangles.size(); t++)
+	{
+		UINT patch = t / trianglesPerPatch;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			UINT vertex = triangles[t].vertex[corner];
+			if (vertexPatch[vertex] == unassigned)
+			{
+				vertexPatch[vertex] = patch;
+				patchSizes[patch]++;
+			}
+		}
+	}
+
+	level.PatchOffsets.resize(patchCount + 1);
+	level.PatchOffsets[0] = 0;
+	for (UINT patch = 0; patch < patchCount; patch++)
+	{
+		UINT padded = (patchSizes[patch] + 3) & ~3u;
+		level.PatchOffsets[patch + 1] = level.PatchOffsets[patch] + padded;
+	}
+
+	level.PatchVertices.resize(level.PatchOffsets[patchCount]);
+	std::vector<UINT> fill(level.PatchOffsets.begin(), level.PatchOffsets.end() - 1);
+	for (UINT vertex = 0; vertex < vertices.size(); vertex++)
+	{
+		level.PatchVertices[fill[vertexPatch[vertex]]++] = vertex;
+	}
+
+	//Padding repeats the first vertex of the patch; it gets the same result and leaves the bounds alone
+	for (UINT patch = 0; patch < patchCount; patch++)
+	{
+		for (UINT slot = fill[patch]; slot < level.PatchOffsets[patch + 1]; slot++)
+		{
+			level.PatchVertices[slot] = level.PatchVertices[level.PatchOffsets[patch]];
+		}
+	}
+}
+
+void IcosphereCache::BuildAdjacency(IcosphereLevel& level)
+{
+	const auto& vertices = level.Mesh.first;
+	const auto& triangles = level.Mesh.second;
+
+	//Counting sort of the corners by vertex; walking the triangles in order keeps every list sorted
+	level.VertexCornerOffsets.assign(vertices.size() + 1, 0);
+	for (UINT t = 0; t < triangles.size(); t++)
+	{
+		for (int corner = 0; corner < 3; corner++)
+			level.VertexCornerOffsets[triangles[t].vertex[corner] + 1]++;
+	}
+	for (UINT vertex = 0; vertex < vertices.size(); vertex++)
+	{
+		level.VertexCornerOffsets[vertex + 1] += level.VertexCornerOffsets[vertex];
+	}
+
+	level.VertexCorners.resize(triangles.size() * 3);
+	std::vector<UINT> fill(level.VertexCornerOffsets.begin(), level.VertexCornerOffsets.end() - 1);
+	for (UINT t = 0; t < triangles.size(); t++)
+	{
+		for (UINT corner = 0; corner < 3; corner++)
+			level.VertexCorners[fill[triangles[t].vertex[corner]]++] = t * 3 + corner;
+	}
+}
+
+void IcosphereCache::BuildSeamSplits(IcosphereLevel& level)
+{
+	const auto& vertices = level.Mesh.first;
+	const auto& triangles = level.Mesh.second;
+	UINT numVertices = (UINT)vertices.size();
+
+	std::vector<XMFLOAT2> texCoords(numVertices);
+	std::vector<bool> isPole(numVertices);
+	for (UINT i = 0; i < numVertices; i++)
+	{
+		texCoords[i] = UVFromVector3(vertices[i]);
+		isPole[i] = texCoords[i].y == 0 || texCoords[i].y == 1;
+	}
+
+	//Same decisions as the per triangle CorrectUV walk, recorded instead of applied
+	std::vector<UINT> splitOfCorner(triangles.size() * 3, UINT(SeamSplit::NO_INDEX));
+	auto addSplit = [&](UINT corner, UINT source, UINT midpointA, UINT midpointB)
+	{
+		SeamSplit split = { source, corner, midpointA, midpointB };
+		if (splitOfCorner[corner] != SeamSplit::NO_INDEX)
+			level.SeamSplits[splitOfCorner[corner]].Corner = SeamSplit::NO_INDEX;
+		splitOfCorner[corner] = (UINT)level.SeamSplits.size();
+		level.SeamSplits.push_back(split);
+	};
+
+	for (UINT t = 0; t < triangles.size(); t++)
+	{
+		const UINT* v = triangles[t].vertex;
+		const XMFLOAT2& tex0 = texCoords[v[0]];
+		const XMFLOAT2& tex1 = texCoords[v[1]];
+		const XMFLOAT2& tex2 = texCoords[v[2]];
+
+		//SIDES --------------------------------------------
+		//Triangles wound the other way in uv space wrap around the seam
+		float texNormalZ = (tex1.x - tex0.x) * (tex2.y - tex0.y) - (tex1.y - tex0.y) * (tex2.x - tex0.x);
+		if (texNormalZ > 0)
+		{
+			for (UINT corner = 0; corner < 3; corner++)
+			{
+				if (texCoords[v[corner]].x < 0.1f)
+					addSplit(t * 3 + corner, v[corner], SeamSplit::NO_INDEX, SeamSplit::NO_INDEX);
+			}
+		}
+
+		//POLES --------------------------------------------
+		//A corner already moved to a seam copy is no longer a pole. The copy is made from the pole itself: the per triangle
+		//walk copied the first corner into every slot, which collapsed triangles whose pole was not their first corner.
+		for (UINT corner = 0; corner < 3; corner++)
+		{
+			if (splitOfCorner[t * 3 + corner] == SeamSplit::NO_INDEX && isPole[v[corner]])
+			{
+				addSplit(t * 3 + corner, v[corner], v[(corner + 1) % 3], v[(corner + 2) % 3]);
+				break;
+			}
+		}
+	}
+}
+
+void IcosphereCache::BuildDrawOrder(IcosphereLevel& level)
+{
+	const auto& triangles = level.Mesh.second;
+	UINT numVertices = (UINT)(level.Mesh.first.size() + level.SeamSplits.size());
+
+	//Index buffer as CorrectUV leaves it
+	std::vector<DWORD> indices;
+	indices.reserve(triangles.size() * 3);
+	for (const auto& triangle : triangles)
+	{
+		indices.push_back(triangle.vertex[0]);
+		indices.push_back(triangle.vertex[1]);
+		indices.push_back(triangle.vertex[2]);
+	}
+	for (UINT i = 0; i < level.SeamSplits.size(); i++)
+	{
+		if (level.SeamSplits[i].Corner != SeamSplit::NO_INDEX)
+			indices[level.SeamSplits[i].Corner] = (DWORD)(level.Mesh.first.size() + i);
+	}
+	level.DrawReport.Before = VertexCacheOptimizer::Measure(indices, numVertices);
+
+	//Reorder triangles, then vertices
+	std::vector<UINT> order = VertexCacheOptimizer::OrderTriangles(indices, numVertices);
+	level.DrawIndices.resize(indices.size());
+	for (UINT i = 0; i < order.size(); i++)
+	{
+		level.DrawIndices[i * 3] = indices[order[i] * 3];
+		level.DrawIndices[i * 3 + 1] = indices[order[i] * 3 + 1];
+		level.DrawIndices[i * 3 + 2] = indices[order[i] * 3 + 2];
+	}
+	level.DrawVertices = VertexCacheOptimizer::RenumberVertices(level.DrawIndices, numVertices);
+	level.DrawReport.After = VertexCacheOptimizer::Measure(level.DrawIndices, (UINT)level.DrawVertices.size());
+}
+
+size_t IcosphereCache::GetMemoryUsage()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	size_t bytes = 0;
+	for (auto& level : m_Levels)
+	{
+		bytes += sizeof(IcosphereLevel);
+		bytes += level.second->Mesh.first.capacity() * sizeof(XMFLOAT3);
+		bytes += level.second->Mesh.second.capacity() * sizeof(Triangle);
+		bytes += level.second->PatchVertices.capacity() * sizeof(UINT);
+		bytes += level.second->PatchOffsets.capacity() * sizeof(UINT);
+		bytes += level.second->VertexCorners.capacity() * sizeof(UINT);
+		bytes += level.second->VertexCornerOffsets.capacity() * sizeof(UINT);
+		bytes += level.second->SeamSplits.capacity() * sizeof(SeamSplit);
+		bytes += level.second->DrawIndices.capacity() * sizeof(DWORD);
+		bytes += level.second->DrawVertices.capacity() * sizeof(UINT);
+	}
+	return bytes;
+}
+
+UINT IcosphereCache::GetCachedLevels()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return (UINT)m_Levels.size();
+}
+
+void IcosphereCache::Clear()
+{
+	//Levels still referenced by a rock stay alive until that rock releases them
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Levels.clear();
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "RockHeader.h"
+#include "VertexCacheOptimizer.h"
+#include <map>
+#include <memory>
+#include <mutex>
+
+//One vertex CorrectUV adds to fix the texture seam or a pole
+struct SeamSplit
+{
+	UINT Source;	//vertex at Corner, whose position, normal, tangent and v get copied
+	UINT Corner;	//index buffer slot that ends up on the copy, NO_INDEX if a later split took it over
+	UINT MidpointA;	//pole fix: u is the average u of MidpointA and MidpointB
+	UINT MidpointB;	//seam fix (MidpointA == NO_INDEX): u is the u of Source + 1
+
+	static const UINT NO_INDEX = ~0u;
+};
+
+//Everything about a unit icosphere that only depends on the subdivision level
+struct IcosphereLevel
+{
+	IndexedMesh Mesh;
+
+	//Vertices grouped by base face and subdivision patch. Patch p owns the slots
+	//[PatchOffsets[p], PatchOffsets[p + 1]) of PatchVertices. Every patch is padded to a
+	//multiple of 4 slots by repeating its first vertex, so it can be walked four at a time.
+	//Patches of base face f are [f * PatchesPerFace, (f + 1) * PatchesPerFace).
+	std::vector<UINT> PatchVertices;
+	std::vector<UINT> PatchOffsets;
+	UINT PatchesPerFace;
+
+	//A patch is the subtree of 4^PATCH_DEPTH triangles below one triangle of a coarser level
+	static const UINT PATCH_DEPTH = 3;
+
+	//Vertex -> incident triangle corners. The corners of vertex v are
+	//[VertexCornerOffsets[v], VertexCornerOffsets[v + 1]) of VertexCorners, in triangle order.
+	//A corner is triangle * 3 + position, the same numbering as a flat index buffer.
+	std::vector<UINT> VertexCorners;
+	std::vector<UINT> VertexCornerOffsets;
+
+	//Seam and pole splits in creation order; split i becomes vertex Mesh.first.size() + i.
+	//Decided on the UVs of the unit sphere, which only stretch along the axes for a rock.
+	std::vector<SeamSplit> SeamSplits;
+
+	//Final index buffer, seam splits applied and reordered for the vertex cache. Output vertex v
+	//is vertex DrawVertices[v] of the split mesh (base vertices, then one per seam split).
+	std::vector<DWORD> DrawIndices;
+	std::vector<UINT> DrawVertices;
+	VertexCacheReport DrawReport;
+
+	UINT GetPatchCount() const { return (UINT)PatchOffsets.size() - 1; }
+};
+
+//Process-wide cache of unit icospheres, one immutable level per subdivision count.
+//All GenRock instances share these; only the first request for a level subdivides.
+class IcosphereCache
+{
+public:
+	using IcosphereRef = std::shared_ptr<const IcosphereLevel>;
+
+	static IcosphereRef Get(UINT steps);
+
+	static size_t GetMemoryUsage();
+	static UINT GetCachedLevels();
+	static void Clear();
+
+private:
+	static void BuildPatches(IcosphereLevel& level, UINT steps);
+	static void BuildAdjacency(IcosphereLevel& level);
+	static void BuildSeamSplits(IcosphereLevel& level);
+	static void BuildDrawOrder(IcosphereLevel& level);
+
+	static std::mutex m_Mutex;
+	static std::map<UINT, IcosphereRef> m_Levels;
+
+	// -------------------------
+	// Disabling default constructor, copy constructor and
+	// assignment operator.
+	// -------------------------
+	IcosphereCache();
+	IcosphereCache(const IcosphereCache& yRef);
+	IcosphereCache& operator=(const IcosphereCache& yRef);
+};
@@ -0,0 +1,152 @@
+#include "stdafx.h"
+#include "IcosphereTables.h"
+
+//COMPILE TIME TABLES
+//*******************************************************************************************************************************
+//The level 1..MAX_LEVEL subdivision below runs in the compiler. It walks the triangles in the same order as
+//SubdivideTriangle and numbers a new midpoint by first use, which is all that decides the runtime numbering;
+//the hash only has to find edges again. MSVC and Clang need a raised constexpr step limit for it, see CMakeLists.txt.
+namespace
+{
+	const UINT MAX_LEVEL = IcosphereTables::MAX_LEVEL;
+	const UINT MAX_VERTICES = IcosphereTables::GetVertexCount(MAX_LEVEL);
+
+	constexpr UINT GetTriangleOffset(UINT level)
+	{
+		return level == 0 ? 0 : GetTriangleOffset(level - 1) + IcosphereTables::GetTriangleCount(level - 1);
+	}
+
+	//Open addressed edge -> midpoint table of the finest subdivision, load factor <= 0.5 like Lookup
+	const UINT EDGE_CAPACITY = 65536;
+	static_assert(MAX_VERTICES <= 65536, "IcosphereTables stores vertices as WORD");
+	static_assert(EDGE_CAPACITY >= IcosphereTables::GetTriangleCount(MAX_LEVEL - 1) * 3, "Edge table too small for MAX_LEVEL");
+
+	struct Tables
+	{
+		WORD Parents[(MAX_VERTICES - 12) * 2];
+		WORD Triangles[GetTriangleOffset(MAX_LEVEL + 1) * 3];
+	};
+
+	struct EdgeTable
+	{
+		UINT Keys[EDGE_CAPACITY]; //edge + 1, 0 marks a free slot
+		WORD Values[EDGE_CAPACITY];
+	};
+
+	constexpr Tables BuildTables()
+	{
+		Tables tables = {};
+		for (UINT i = 0; i < 60; i++)
+			tables.Triangles[i] = (WORD)icosahedron::indices[i / 3][i % 3];
+
+		UINT vertexCount = 12;
+		for (UINT level = 1; level <= MAX_LEVEL; level++)
+		{
+			EdgeTable edges = {};
+			UINT parents = GetTriangleOffset(level - 1) * 3;
+			UINT children = GetTriangleOffset(level) * 3;
+			for (UINT t = 0; t < IcosphereTables::GetTriangleCount(level - 1); t++)
+			{
+				UINT corner[3] = { tables.Triangles[parents + t * 3], tables.Triangles[parents + t * 3 + 1], tables.Triangles[parents + t * 3 + 2] };
+				UINT mid[3] = {};
+				for (UINT edge = 0; edge < 3; edge++)
+				{
+					UINT first = corner[edge], second = corner[(edge + 1) % 3];
+					if (first > second)
+					{
+						UINT swap = first;
+						first = second;
+						second = swap;
+					}
+
+					UINT key = ((first << 16) | second) + 1;
+					UINT slot = (UINT)((key * 0x9E3779B97F4A7C15ull) >> 32) & (EDGE_CAPACITY - 1);
+					while (edges.Keys[slot] != 0 && edges.Keys[slot] != key)
+						slot = (slot + 1) & (EDGE_CAPACITY - 1);
+
+					if (edges.Keys[slot] == 0)
+					{
+						edges.Keys[slot] = key;
+						edges.Values[slot] = (WORD)vertexCount;
+						tables.Parents[(vertexCount - 12) * 2] = (WORD)first;
+						tables.Parents[(vertexCount - 12) * 2 + 1] = (WORD)second;
+						vertexCount++;
+					}
+					mid[edge] = edges.Values[slot];
+				}
+
+				//Children in SubdivideTriangle's order
+				const UINT child[12] =
+				{
+					corner[0], mid[0], mid[2],
+					corner[1], mid[1], mid[0],
+					corner[2], mid[2], mid[1],
+					mid[0], mid[1], mid[2]
+				};
+				for (UINT i = 0; i < 12; i++)
+					tables.Triangles[children + t * 12 + i] = (WORD)child[i];
+			}
+		}
+		return tables;
+	}
+
+	constexpr Tables TABLES = BuildTables();
+	static_assert(TABLES.Parents[(MAX_VERTICES - 12) * 2 - 1] != 0, "Not every vertex of MAX_LEVEL got its parents");
+}
+
+//RUNTIME
+//*******************************************************************************************************************************
+void IcosphereTables::GetParents(UINT vertex, UINT& first, UINT& second)
+{
+	first = TABLES.Parents[(vertex - 12) * 2];
+	second = TABLES.Parents[(vertex - 12) * 2 + 1];
+}
+
+const WORD* IcosphereTables::GetTriangles(UINT level)
+{
+	return TABLES.Triangles + GetTriangleOffset(level) * 3;
+}
+
+IndexedMesh IcosphereTables::MakeIcosphere(UINT steps)
+{
+	UINT tableLevel = (std::min)(steps, UINT(MAX_LEVEL));
+	UINT vertexCount = GetVertexCount(tableLevel);
+	UINT triangleCount = GetTriangleCount(tableLevel);
+
+	IndexedMesh mesh;
+	VertexList& vertices = mesh.first;
+	TriangleList& triangles = mesh.second;
+	vertices.reserve(GetVertexCount(steps));
+	triangles.reserve(GetTriangleCount(steps));
+
+	//Parents always come first, so one pass in vertex order places every midpoint; same math as VertexForEdge
+	vertices.assign(icosahedron::vertices.begin(), icosahedron::vertices.end());
+	vertices.resize(vertexCount);
+	for (UINT vertex = 12; vertex < vertexCount; vertex++)
+	{
+		UINT first, second;
+		GetParents(vertex, first, second);
+		XMVECTOR point = XMLoadFloat3(&vertices[first]) + XMLoadFloat3(&vertices[second]);
+		XMStoreFloat3(&vertices[vertex], XMVector3Normalize(point));
+	}
+
+	const WORD* pTriangles = GetTriangles(tableLevel);
+	triangles.resize(triangleCount);
+	for (UINT t = 0; t < triangleCount; t++)
+	{
+		triangles[t].vertex[0] = pTriangles[t * 3];
+		triangles[t].vertex[1] = pTriangles[t * 3 + 1];
+		triangles[t].vertex[2] = pTriangles[t * 3 + 2];
+	}
+
+	//Finer levels than the tables hold are subdivided at runtime from the finest one
+	TriangleList next;
+	if (steps > tableLevel)
+		next.reserve(GetTriangleCount(steps));
+	for (UINT level = tableLevel; level < steps; level++)
+	{
+		SubdivideTriangle(vertices, triangles, next);
+		triangles.swap(next);
+	}
+	return mesh;
+}
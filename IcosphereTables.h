@@ -0,0 +1,32 @@
+#pragma once
+#include "RockHeader.h"
+
+//Icosphere topology of levels 1..MAX_LEVEL, generated by the compiler into read only data (see IcosphereTables.cpp).
+//Vertices are numbered exactly like SubdivideTriangle numbers them: level n's vertices are the first GetVertexCount(n)
+//of every finer level, and every vertex past the 12 of the icosahedron is the midpoint of two lower numbered parents.
+//A level then needs no edge hashing at runtime, only one normalisation pass over the parents and a copy of its triangles.
+class IcosphereTables
+{
+public:
+	//Level 5 is 10242 vertices and 20480 triangles; the tables of all levels take about 200 KB
+	static const UINT MAX_LEVEL = 5;
+
+	static constexpr UINT GetVertexCount(UINT level) { return 10 * (1u << (2 * level)) + 2; }
+	static constexpr UINT GetTriangleCount(UINT level) { return 20u << (2 * level); }
+
+	//Same mesh as MakeIcosphere(steps); levels past MAX_LEVEL continue subdividing from the finest table
+	static IndexedMesh MakeIcosphere(UINT steps);
+
+	//Parents of vertex (12 <= vertex < GetVertexCount(MAX_LEVEL)) and the triangles of a level (<= MAX_LEVEL)
+	static void GetParents(UINT vertex, UINT& first, UINT& second);
+	static const WORD* GetTriangles(UINT level);
+
+private:
+	// -------------------------
+	// Disabling default constructor, copy constructor and
+	// assignment operator.
+	// -------------------------
+	IcosphereTables();
+	IcosphereTables(const IcosphereTables& yRef);
+	IcosphereTables& operator=(const IcosphereTables& yRef);
+};
@@ -0,0 +1,440 @@
+#include "stdafx.h"
+#include "ProgressiveMesh.h"
+#include "VertexCacheOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+//Sum of squared distances to a set of planes, the upper triangle of the symmetric 4x4 matrix
+struct Quadric
+{
+	double xx = 0, xy = 0, xz = 0, xw = 0, yy = 0, yz = 0, yw = 0, zz = 0, zw = 0, ww = 0;
+
+	void Add(const Quadric& other)
+	{
+		xx += other.xx; xy += other.xy; xz += other.xz; xw += other.xw;
+		yy += other.yy; yz += other.yz; yw += other.yw;
+		zz += other.zz; zw += other.zw;
+		ww += other.ww;
+	}
+
+	double Evaluate(const XMFLOAT3& p) const
+	{
+		double x = p.x, y = p.y, z = p.z;
+		return xx * x * x + 2 * xy * x * y + 2 * xz * x * z + 2 * xw * x
+			+ yy * y * y + 2 * yz * y * z + 2 * yw * y
+			+ zz * z * z + 2 * zw * z
+			+ ww;
+	}
+};
+
+//Unnormalized triangle normal, its length is twice the area
+const auto TriangleNormal = [](const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2)
+{
+	double ex = p1.x - p0.x, ey = p1.y - p0.y, ez = p1.z - p0.z;
+	double fx = p2.x - p0.x, fy = p2.y - p0.y, fz = p2.z - p0.z;
+	return XMFLOAT3((float)(ey * fz - ez * fy), (float)(ez * fx - ex * fz), (float)(ex * fy - ey * fx));
+};
+
+//Area weighted plane of a triangle
+const auto TriangleQuadric = [](const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2)
+{
+	Quadric quadric;
+	XMFLOAT3 normal = TriangleNormal(p0, p1, p2);
+	double length = sqrt((double)normal.x * normal.x + (double)normal.y * normal.y + (double)normal.z * normal.z);
+	if (length <= 0.0)
+		return quadric;
+
+	double a = normal.x / length, b = normal.y / length, c = normal.z / length;
+	double d = -(a * p0.x + b * p0.y + c * p0.z);
+	double area = length * 0.5;
+	quadric.xx = area * a * a; quadric.xy = area * a * b; quadric.xz = area * a * c; quadric.xw = area * a * d;
+	quadric.yy = area * b * b; quadric.yz = area * b * c; quadric.yw = area * b * d;
+	quadric.zz = area * c * c; quadric.zw = area * c * d;
+	quadric.ww = area * d * d;
+	return quadric;
+};
+
+//BUILD
+//*******************************************************************************************************************************
+ProgressiveMesh ProgressiveMeshBuilder::Build(const std::vector<VertexRock>& vertices, const std::vector<DWORD>& indices)
+{
+	UINT numVertices = (UINT)vertices.size();
+	UINT numTriangles = (UINT)indices.size() / 3;
+	std::vector<DWORD> corners(indices.begin(), indices.begin() + numTriangles * 3);
+
+	//ADJACENCY
+	//-----------------------------------------------------------------------------------------
+	std::vector<std::vector<UINT>> vertexTriangles(numVertices);
+	for (UINT i = 0; i < numTriangles * 3; i++)
+		vertexTriangles[corners[i]].push_back(i / 3);
+
+	//Every edge has to be shared by exactly two triangles for a collapse to keep the surface closed
+	std::vector<bool> locked(numVertices, false);
+	std::vector<UINT64> edges;
+	edges.reserve(numTriangles * 3);
+	for (UINT i = 0; i < numTriangles * 3; i++)
+	{
+		UINT a = corners[i];
+		UINT b = corners[i - i % 3 + (i + 1) % 3];
+		if (a == b)
+			locked[a] = true;
+		edges.push_back(((UINT64)(std::min)(a, b) << 32) | (std::max)(a, b));
+	}
+	std::sort(edges.begin(), edges.end());
+	for (size_t first = 0; first < edges.size();)
+	{
+		size_t last = first;
+		while (last < edges.size() && edges[last] == edges[first])
+			last++;
+		if (last - first != 2)
+		{
+			locked[(UINT)(edges[first] >> 32)] = true;
+			locked[(UINT)edges[first]] = true;
+		}
+		first = last;
+	}
+
+	std::vector<Quadric> quadrics(numVertices);
+	for (UINT t = 0; t < numTriangles; t++)
+	{
+		Quadric quadric = TriangleQuadric(vertices[corners[t * 3]].Position, vertices[corners[t * 3 + 1]].Position, vertices[corners[t * 3 + 2]].Position);
+		for (UINT c = 0; c < 3; c++)
+			quadrics[corners[t * 3 + c]].Add(quadric);
+	}
+
+	//CANDIDATES
+	//-----------------------------------------------------------------------------------------
+	const auto GatherNeighbours = [&](UINT v, std::vector<UINT>& neighbours)
+	{
+		neighbours.clear();
+		for (UINT t : vertexTriangles[v])
+		{
+			for (UINT c = 0; c < 3; c++)
+			{
+				if (corners[t * 3 + c] != v)
+					neighbours.push_back(corners[t * 3 + c]);
+			}
+		}
+		std::sort(neighbours.begin(), neighbours.end());
+		neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+	};
+
+	const auto HasCorner = [&](UINT t, UINT v)
+	{
+		return corners[t * 3] == v || corners[t * 3 + 1] == v || corners[t * 3 + 2] == v;
+	};
+
+	std::vector<UINT> neighbours, targetNeighbours, opposite;
+
+	//Collapsing v into u is allowed when the only vertices both share are across the two triangles on
+	//the edge (otherwise the surface pinches) and no remaining triangle around v turns over
+	const auto CanCollapse = [&](UINT v, UINT u)
+	{
+		opposite.clear();
+		for (UINT t : vertexTriangles[v])
+		{
+			if (!HasCorner(t, u))
+				continue;
+			for (UINT c = 0; c < 3; c++)
+			{
+				if (corners[t * 3 + c] != v && corners[t * 3 + c] != u)
+					opposite.push_back(corners[t * 3 + c]);
+			}
+		}
+
+		GatherNeighbours(u, targetNeighbours);
+		UINT shared = 0;
+		for (UINT w : neighbours)
+		{
+			if (!std::binary_search(targetNeighbours.begin(), targetNeighbours.end(), w))
+				continue;
+			if (std::find(opposite.begin(), opposite.end(), w) == opposite.end())
+				return false;
+			shared++;
+		}
+		if (shared != opposite.size())
+			return false;
+
+		for (UINT t : vertexTriangles[v])
+		{
+			if (HasCorner(t, u))
+				continue;
+
+			XMFLOAT3 p[3], q[3];
+			for (UINT c = 0; c < 3; c++)
+			{
+				UINT corner = corners[t * 3 + c];
+				p[c] = vertices[corner].Position;
+				q[c] = vertices[corner == v ? u : corner].Position;
+			}
+			XMFLOAT3 before = TriangleNormal(p[0], p[1], p[2]);
+			XMFLOAT3 after = TriangleNormal(q[0], q[1], q[2]);
+			if ((double)before.x * after.x + (double)before.y * after.y + (double)before.z * after.z <= 0.0)
+				return false;
+		}
+		return true;
+	};
+
+	struct Candidate
+	{
+		double Cost;
+		UINT Vertex;
+		UINT Target;
+		UINT Stamp;
+
+		//Cheapest first, ties by vertex so the result does not depend on the queue implementation
+		bool operator<(const Candidate& other) const
+		{
+			if (Cost != other.Cost)
+				return Cost > other.Cost;
+			return Vertex > other.Vertex;
+		}
+	};
+
+	std::priority_queue<Candidate> queue;
+	std::vector<UINT> stamps(numVertices, 0);
+	std::vector<bool> alive(numVertices, true);
+
+	const auto PushCandidate = [&](UINT v)
+	{
+		stamps[v]++;
+		if (locked[v] || !alive[v])
+			return;
+
+		GatherNeighbours(v, neighbours);
+		Candidate best = { -1.0, v, 0, stamps[v] };
+		for (UINT u : neighbours)
+		{
+			Quadric merged = quadrics[v];
+			merged.Add(quadrics[u]);
+			double cost = merged.Evaluate(vertices[u].Position);
+			if ((best.Cost < 0.0 || cost < best.Cost) && CanCollapse(v, u))
+			{
+				best.Cost = cost;
+				best.Target = u;
+			}
+		}
+		if (best.Cost >= 0.0)
+			queue.push(best);
+	};
+
+	for (UINT v = 0; v < numVertices; v++)
+		PushCandidate(v);
+
+	//COLLAPSE
+	//-----------------------------------------------------------------------------------------
+	struct Collapse
+	{
+		UINT Vertex;
+		UINT Target;
+		UINT FirstCorner, LastCorner;
+		UINT FirstRemoved, LastRemoved;
+	};
+
+	std::vector<Collapse> collapses;
+	std::vector<UINT> movedCorners;
+	std::vector<UINT> removedTriangles;
+	std::vector<bool> removed(numTriangles, false);
+	//Corners every triangle had when it was removed, which are the corners it reappears with
+	std::vector<DWORD> appearCorners(corners);
+
+	while (!queue.empty())
+	{
+		Candidate candidate = queue.top();
+		queue.pop();
+		if (candidate.Stamp != stamps[candidate.Vertex])
+			continue;
+
+		UINT v = candidate.Vertex;
+		UINT u = candidate.Target;
+
+		Collapse collapse = { v, u, (UINT)movedCorners.size(), 0, (UINT)removedTriangles.size(), 0 };
+		for (UINT t : vertexTriangles[v])
+		{
+			if (HasCorner(t, u))
+			{
+				removed[t] = true;
+				removedTriangles.push_back(t);
+				for (UINT c = 0; c < 3; c++)
+				{
+					UINT corner = corners[t * 3 + c];
+					appearCorners[t * 3 + c] = corner;
+					if (corner != v)
+					{
+						auto& list = vertexTriangles[corner];
+						list.erase(std::find(list.begin(), list.end(), t));
+					}
+				}
+				continue;
+			}
+
+			for (UINT c = 0; c < 3; c++)
+			{
+				if (corners[t * 3 + c] == v)
+				{
+					corners[t * 3 + c] = u;
+					movedCorners.push_back(t * 3 + c);
+				}
+			}
+			vertexTriangles[u].push_back(t);
+		}
+		collapse.LastCorner = (UINT)movedCorners.size();
+		collapse.LastRemoved = (UINT)removedTriangles.size();
+		collapses.push_back(collapse);
+
+		vertexTriangles[v].clear();
+		alive[v] = false;
+		stamps[v]++;
+		quadrics[u].Add(quadrics[v]);
+
+		//Only the target and its ring see a different neighbourhood
+		std::vector<UINT> ring;
+		GatherNeighbours(u, ring);
+		PushCandidate(u);
+		for (UINT w : ring)
+			PushCandidate(w);
+	}
+
+	//ORDER
+	//-----------------------------------------------------------------------------------------
+	//Base triangles go first in cache friendly order, then the triangles of every split in the order
+	//the splits are applied, which is the reverse of the collapses
+	std::vector<DWORD> baseIndices;
+	std::vector<UINT> baseTriangles;
+	for (UINT t = 0; t < numTriangles; t++)
+	{
+		if (removed[t])
+			continue;
+		baseTriangles.push_back(t);
+		for (UINT c = 0; c < 3; c++)
+		{
+			appearCorners[t * 3 + c] = corners[t * 3 + c];
+			baseIndices.push_back(corners[t * 3 + c]);
+		}
+	}
+
+	std::vector<UINT> triangleOrder;
+	triangleOrder.reserve(numTriangles);
+	for (UINT triangle : VertexCacheOptimizer::OrderTriangles(baseIndices, numVertices))
+		triangleOrder.push_back(baseTriangles[triangle]);
+	for (size_t c = collapses.size(); c > 0; c--)
+	{
+		const Collapse& collapse = collapses[c - 1];
+		for (UINT r = collapse.FirstRemoved; r < collapse.LastRemoved; r++)
+			triangleOrder.push_back(removedTriangles[r]);
+	}
+
+	std::vector<UINT> triangleRemap(numTriangles);
+	for (UINT t = 0; t < numTriangles; t++)
+		triangleRemap[triangleOrder[t]] = t;
+
+	//Base vertices in first use order, then one per split
+	const UINT unused = ~0u;
+	std::vector<UINT> vertexOrder;
+	std::vector<UINT> vertexRemap(numVertices, unused);
+	vertexOrder.reserve(numVertices);
+	const auto Append = [&](UINT v)
+	{
+		if (vertexRemap[v] != unused)
+			return;
+		vertexRemap[v] = (UINT)vertexOrder.size();
+		vertexOrder.push_back(v);
+	};
+	for (UINT t = 0; t < baseTriangles.size(); t++)
+	{
+		for (UINT c = 0; c < 3; c++)
+			Append(corners[triangleOrder[t] * 3 + c]);
+	}
+	for (UINT v = 0; v < numVertices; v++)
+	{
+		if (alive[v])
+			Append(v);
+	}
+	UINT baseVertexCount = (UINT)vertexOrder.size();
+	for (size_t c = collapses.size(); c > 0; c--)
+		Append(collapses[c - 1].Vertex);
+
+	//OUTPUT
+	//-----------------------------------------------------------------------------------------
+	ProgressiveMesh mesh;
+	mesh.BaseVertexCount = baseVertexCount;
+	mesh.BaseTriangleCount = (UINT)baseTriangles.size();
+
+	mesh.Vertices.resize(numVertices);
+	for (UINT v = 0; v < numVertices; v++)
+		mesh.Vertices[v] = vertices[vertexOrder[v]];
+
+	mesh.Indices.resize(numTriangles * 3);
+	for (UINT t = 0; t < numTriangles; t++)
+	{
+		for (UINT c = 0; c < 3; c++)
+			mesh.Indices[t * 3 + c] = vertexRemap[appearCorners[triangleOrder[t] * 3 + c]];
+	}
+
+	mesh.Splits.reserve(collapses.size());
+	mesh.SplitCorners.reserve(movedCorners.size());
+	UINT triangleCount = mesh.BaseTriangleCount;
+	for (size_t c = collapses.size(); c > 0; c--)
+	{
+		const Collapse& collapse = collapses[c - 1];
+
+		VertexSplit split;
+		split.Parent = vertexRemap[collapse.Target];
+		split.FirstCorner = (UINT)mesh.SplitCorners.size();
+		split.CornerCount = collapse.LastCorner - collapse.FirstCorner;
+		for (UINT m = collapse.FirstCorner; m < collapse.LastCorner; m++)
+		{
+			UINT corner = movedCorners[m];
+			mesh.SplitCorners.push_back(triangleRemap[corner / 3] * 3 + corner % 3);
+		}
+		triangleCount += collapse.LastRemoved - collapse.FirstRemoved;
+		split.TriangleCount = triangleCount;
+		mesh.Splits.push_back(split);
+	}
+
+	return mesh;
+}
+
+//REFINEMENT
+//*******************************************************************************************************************************
+UINT ProgressiveMesh::GetSplitCountForTriangles(UINT maxTriangles) const
+{
+	//Every split adds at least one triangle, so the counts are sorted
+	auto it = std::upper_bound(Splits.begin(), Splits.end(), maxTriangles, [](UINT count, const VertexSplit& split)
+	{
+		return count < split.TriangleCount;
+	});
+	return (UINT)(it - Splits.begin());
+}
+
+void ProgressiveMesh::Begin(ProgressiveMeshState& state) const
+{
+	state.Indices = Indices;
+	state.SplitCount = 0;
+	state.TriangleCount = BaseTriangleCount;
+}
+
+void ProgressiveMesh::SetSplitCount(ProgressiveMeshState& state, UINT splitCount) const
+{
+	splitCount = (std::min)(splitCount, GetMaxSplitCount());
+
+	while (state.SplitCount < splitCount)
+	{
+		const VertexSplit& split = Splits[state.SplitCount];
+		DWORD vertex = BaseVertexCount + state.SplitCount;
+		for (UINT c = split.FirstCorner; c < split.FirstCorner + split.CornerCount; c++)
+			state.Indices[SplitCorners[c]] = vertex;
+		state.SplitCount++;
+		state.TriangleCount = split.TriangleCount;
+	}
+
+	while (state.SplitCount > splitCount)
+	{
+		state.SplitCount--;
+		const VertexSplit& split = Splits[state.SplitCount];
+		for (UINT c = split.FirstCorner; c < split.FirstCorner + split.CornerCount; c++)
+			state.Indices[SplitCorners[c]] = split.Parent;
+		state.TriangleCount = GetTriangleCount(state.SplitCount);
+	}
+}
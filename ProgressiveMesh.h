@@ -0,0 +1,67 @@
+#pragma once
+#include "RockHeader.h"
+
+//Undoes one edge collapse: vertex BaseVertexCount + split index reappears next to Parent
+struct VertexSplit
+{
+	UINT Parent = 0;
+	//Range in ProgressiveMesh::SplitCorners of the index buffer positions that move from Parent to the new vertex
+	UINT FirstCorner = 0;
+	UINT CornerCount = 0;
+	//Triangles drawn once this split is applied
+	UINT TriangleCount = 0;
+};
+
+//Current refinement of a progressive mesh: draw the first TriangleCount * 3 entries of Indices
+//with the first BaseVertexCount + SplitCount vertices
+struct ProgressiveMeshState
+{
+	UINT SplitCount = 0;
+	UINT TriangleCount = 0;
+	std::vector<DWORD> Indices;
+};
+
+//Base mesh plus an ordered list of vertex splits (Hoppe 1996).
+//Vertices and triangles are stored in the order they appear, so any prefix of Vertices, Indices,
+//Splits and SplitCorners is a complete coarser mesh and a stream can stop after any split.
+//Every triangle is stored with the corners it has at the moment it appears.
+struct ProgressiveMesh
+{
+	std::vector<VertexRock> Vertices;
+	std::vector<DWORD> Indices;
+	std::vector<VertexSplit> Splits;
+	std::vector<UINT> SplitCorners;
+	UINT BaseVertexCount = 0;
+	UINT BaseTriangleCount = 0;
+
+	UINT GetMaxSplitCount() const { return (UINT)Splits.size(); }
+	UINT GetVertexCount(UINT splitCount) const { return BaseVertexCount + splitCount; }
+	UINT GetTriangleCount(UINT splitCount) const { return splitCount == 0 ? BaseTriangleCount : Splits[splitCount - 1].TriangleCount; }
+
+	//Most splits whose mesh stays within maxTriangles, never below the base mesh
+	UINT GetSplitCountForTriangles(UINT maxTriangles) const;
+
+	//Resets state to the base mesh
+	void Begin(ProgressiveMeshState& state) const;
+	//Applies or undoes splits until state has splitCount of them; costs only the corners that change
+	void SetSplitCount(ProgressiveMeshState& state, UINT splitCount) const;
+};
+
+//Builds a ProgressiveMesh from an indexed triangle list by half-edge collapses ordered by quadric error
+//(Garland and Heckbert 1997). Collapses keep the surviving vertex where it is, so every vertex of the
+//coarse meshes is a vertex of the input. Vertices on open edges, such as the duplicated uv seam vertices
+//of a rock, are never removed.
+class ProgressiveMeshBuilder
+{
+public:
+	static ProgressiveMesh Build(const std::vector<VertexRock>& vertices, const std::vector<DWORD>& indices);
+
+private:
+	// -------------------------
+	// Disabling default constructor, copy constructor and
+	// assignment operator.
+	// -------------------------
+	ProgressiveMeshBuilder();
+	ProgressiveMeshBuilder(const ProgressiveMeshBuilder& yRef);
+	ProgressiveMeshBuilder& operator=(const ProgressiveMeshBuilder& yRef);
+};
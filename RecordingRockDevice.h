@@ -0,0 +1,66 @@
+#pragma once
+#include "RockInstancing.h"
+
+//Stand-in RockRenderDevice that only records what it is asked to do, to check batching without a GPU
+class RecordingRockDevice : public RockRenderDevice
+{
+public:
+	enum class CommandType
+	{
+		UploadInstances,
+		BindMaterial,
+		BindMesh,
+		DrawIndexedInstanced
+	};
+
+	struct Command
+	{
+		CommandType Type;
+		UINT Handle;		//material or mesh for the binds
+		UINT IndexCount;
+		UINT InstanceCount;	//also the upload size
+		UINT FirstInstance;
+	};
+
+	RecordingRockDevice() {}
+	~RecordingRockDevice(void) {}
+
+	void UploadInstances(const XMFLOAT4X4* pWorlds, UINT count) override
+	{
+		m_Instances.assign(pWorlds, pWorlds + count);
+		m_Commands.push_back({ CommandType::UploadInstances, 0, 0, count, 0 });
+	}
+	void BindMaterial(UINT material) override { m_Commands.push_back({ CommandType::BindMaterial, material, 0, 0, 0 }); }
+	void BindMesh(UINT mesh) override { m_Commands.push_back({ CommandType::BindMesh, mesh, 0, 0, 0 }); }
+	void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT firstInstance) override
+	{
+		m_Commands.push_back({ CommandType::DrawIndexedInstanced, 0, indexCount, instanceCount, firstInstance });
+	}
+
+	void Clear() { m_Commands.clear(); m_Instances.clear(); }
+
+	UINT GetCount(CommandType type) const
+	{
+		UINT count = 0;
+		for (const auto& command : m_Commands)
+			count += command.Type == type ? 1 : 0;
+		return count;
+	}
+
+	const std::vector<Command>& GetCommands() const { return m_Commands; }
+	//Last uploaded instance stream
+	const std::vector<XMFLOAT4X4>& GetInstances() const { return m_Instances; }
+
+private:
+	std::vector<Command> m_Commands;
+	std::vector<XMFLOAT4X4> m_Instances;
+
+private:
+
+	// -------------------------
+	// Disabling default copy constructor and default
+	// assignment operator.
+	// -------------------------
+	RecordingRockDevice(const RecordingRockDevice& yRef);
+	RecordingRockDevice& operator=(const RecordingRockDevice& yRef);
+};
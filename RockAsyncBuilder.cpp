@@ -0,0 +1,151 @@
+#include "stdafx.h"
+#include "RockAsyncBuilder.h"
+#include "RockThreadPool.h"
+
+const auto IsSameRequest = [](const RockBuildRequest& a, const RockBuildRequest& b)
+{
+	return a.Parameters.GetChanges(b.Parameters) == 0 && a.LodCount == b.LodCount &&
+		a.PackedVertices == b.PackedVertices && a.pCache == b.pCache;
+};
+
+RockAsyncBuilder::RockAsyncBuilder(void) :
+	m_Generator(RockParameters())
+{
+	m_Generator.SetStageReuse(true);
+}
+
+RockAsyncBuilder::~RockAsyncBuilder(void)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Stop = true;
+	m_HasPending = false;
+	m_Idle.wait(lock, [this]() { return !m_Building; });
+}
+
+//QUEUE
+//*******************************************************************************************************************************
+void RockAsyncBuilder::Request(const RockBuildRequest& request)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_RequestCount++;
+		//Built, being built or about to be: e.g. a Reset after a shader only change
+		if (m_HasRequested && IsSameRequest(request, m_LastRequest))
+			return;
+
+		m_Pending = request;
+		m_LastRequest = request;
+		m_HasPending = true;
+		m_HasRequested = true;
+
+		//A running task picks the request up when its build finishes
+		if (m_Building)
+			return;
+		m_Building = true;
+	}
+	RockThreadPool::GetShared().Submit([this]() { Run(); });
+}
+
+std::unique_ptr<RockBuildResult> RockAsyncBuilder::TakeResult()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return std::move(m_pResult);
+}
+
+bool RockAsyncBuilder::IsBusy() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Building || m_HasPending;
+}
+
+void RockAsyncBuilder::Wait()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Idle.wait(lock, [this]() { return !m_Building && !m_HasPending; });
+}
+
+UINT64 RockAsyncBuilder::GetRequestCount() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_RequestCount;
+}
+
+UINT64 RockAsyncBuilder::GetBuildCount() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_BuildCount;
+}
+
+void RockAsyncBuilder::Run()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	while (m_HasPending && !m_Stop)
+	{
+		RockBuildRequest request = m_Pending;
+		m_HasPending = false;
+		m_BuildCount++;
+
+		//Requests arriving from here on only overwrite m_Pending
+		lock.unlock();
+		std::unique_ptr<RockBuildResult> result = Build(request);
+		lock.lock();
+
+		m_pResult = std::move(result);
+	}
+
+	//Notified under the lock, the destructor may free this as soon as it is released
+	m_Building = false;
+	m_Idle.notify_all();
+}
+
+//BUILD
+//*******************************************************************************************************************************
+std::unique_ptr<RockBuildResult> RockAsyncBuilder::Build(const RockBuildRequest& request)
+{
+	std::unique_ptr<RockBuildResult> result(new RockBuildResult());
+	result->Request = request;
+
+	RockCacheKey key;
+	key.Parameters = request.Parameters;
+	key.LodCount = request.LodCount;
+	key.PackedVertices = request.PackedVertices;
+
+	if (request.pCache != nullptr)
+	{
+		result->pCached = request.pCache->Find(key);
+		if (result->pCached)
+			return result;
+	}
+
+	m_Generator.SetParameters(request.Parameters);
+	m_Generator.GenerateLods(request.LodCount, m_Lods);
+	result->Profiler = m_Generator.GetProfiler();
+
+	result->Lods.resize(m_Lods.size());
+	std::vector<RockMeshCache::LodData> cacheData;
+	for (size_t i = 0; i < m_Lods.size(); i++)
+	{
+		const RockMesh& mesh = m_Lods[i].Mesh;
+		RockBuiltLod& lod = result->Lods[i];
+		UINT vertexCount = (UINT)mesh.Vertices.size();
+		lod.GeometricError = m_Lods[i].GeometricError;
+		lod.Indices = RockPacking::PackIndices(mesh.Indices, vertexCount);
+
+		const void* pVertices = nullptr;
+		if (request.PackedVertices)
+		{
+			lod.Bounds = RockPacking::Pack(mesh.Vertices, lod.PackedVertices);
+			pVertices = lod.PackedVertices.data();
+		}
+		else
+		{
+			lod.Vertices = mesh.Vertices;
+			pVertices = lod.Vertices.data();
+		}
+		cacheData.push_back({ pVertices, vertexCount, &lod.Indices, lod.GeometricError, lod.Bounds });
+	}
+
+	if (request.pCache != nullptr)
+		result->CacheStoreFailed = !request.pCache->Store(key, cacheData);
+	return result;
+}
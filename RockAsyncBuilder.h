@@ -0,0 +1,97 @@
+#pragma once
+#include "RockGenerator.h"
+#include "RockPacking.h"
+#include "RockMeshCache.h"
+#include <condition_variable>
+#include <mutex>
+
+//Everything a rebuild of one rock needs, copied when the rebuild is requested
+struct RockBuildRequest
+{
+	RockParameters Parameters;
+	UINT LodCount = 1;
+	bool PackedVertices = false;
+	//Looked up before generating and filled after; not owned, may be nullptr
+	RockMeshCache* pCache = nullptr;
+};
+
+//CPU side of one built LOD, ready to be uploaded. Only the vertex format of the request is filled.
+struct RockBuiltLod
+{
+	std::vector<VertexRock> Vertices;
+	std::vector<VertexRockPacked> PackedVertices;
+	PackedBounds Bounds;
+	PackedIndices Indices;
+	float GeometricError = 0.0f;
+};
+
+//A finished rebuild: either generated LODs or, on a cache hit, the mapped cache file
+struct RockBuildResult
+{
+	RockBuildRequest Request;
+	std::vector<RockBuiltLod> Lods;
+	std::unique_ptr<RockCacheEntry> pCached;
+	bool CacheStoreFailed = false;
+	RockProfiler Profiler;
+};
+
+//Rebuilds one rock in the background, so the caller keeps drawing its current mesh meanwhile.
+//Request() never blocks on a build: while one is running it only replaces the pending request, so any number
+//of requests made during a build collapse into the single rebuild that starts when it finishes.
+//TakeResult() hands over the newest finished build; an older one not taken yet is dropped.
+//Builds of every rock share the workers of RockThreadPool::GetShared() as tasks. Each builder keeps one single
+//threaded generator with stage reuse on, so a rebuild only reruns the stages the changed parameters feed, and a
+//warm rebuild of the same size allocates nothing in its stages. A request equal to the previous one is dropped.
+class RockAsyncBuilder
+{
+public:
+	RockAsyncBuilder(void);
+	//Waits for the running build, a pending request is dropped
+	~RockAsyncBuilder(void);
+
+	void Request(const RockBuildRequest& request);
+	//nullptr when nothing finished since the last call
+	std::unique_ptr<RockBuildResult> TakeResult();
+
+	//True while a build runs or a request waits for one
+	bool IsBusy() const;
+	//Blocks until IsBusy() turns false
+	void Wait();
+
+	//Requests made and builds actually run, to see how many were collapsed
+	UINT64 GetRequestCount() const;
+	UINT64 GetBuildCount() const;
+
+private:
+	//Pool task, builds until no request is pending
+	void Run();
+	//The whole rebuild: cache lookup, generation, packing and cache store
+	std::unique_ptr<RockBuildResult> Build(const RockBuildRequest& request);
+
+	//Only the task touches these, and m_Building keeps it to one task per builder at a time. The LODs are generated
+	//into m_Lods and copied out, so their buffers stay warm for the next build.
+	RockGenerator m_Generator;
+	std::vector<RockLod> m_Lods;
+
+	mutable std::mutex m_Mutex;
+	std::condition_variable m_Idle;
+
+	RockBuildRequest m_Pending;
+	RockBuildRequest m_LastRequest;
+	bool m_HasPending = false;
+	bool m_HasRequested = false;
+	//From submitting the pool task until it returns
+	bool m_Building = false;
+	bool m_Stop = false;
+	std::unique_ptr<RockBuildResult> m_pResult;
+
+	UINT64 m_RequestCount = 0;
+	UINT64 m_BuildCount = 0;
+
+	// -------------------------
+	// Disabling default copy constructor and default
+	// assignment operator.
+	// -------------------------
+	RockAsyncBuilder(const RockAsyncBuilder& yRef);
+	RockAsyncBuilder& operator=(const RockAsyncBuilder& yRef);
+};
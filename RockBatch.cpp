@@ -0,0 +1,56 @@
+#include "stdafx.h"
+#include "RockBatch.h"
+#include "RockThreadPool.h"
+#include <atomic>
+
+UINT RockBatch::GetDefaultThreadCount()
+{
+	UINT count = std::thread::hardware_concurrency();
+	return count > 0 ? count : 1;
+}
+
+std::vector<RockMesh> RockBatch::Generate(const std::vector<RockParameters>& jobs, UINT numThreads)
+{
+	std::vector<RockMesh> results(jobs.size());
+	if (jobs.empty())
+		return results;
+
+	if (numThreads == 0)
+		numThreads = GetDefaultThreadCount();
+	if (numThreads > jobs.size())
+		numThreads = (UINT)jobs.size();
+
+	//One range per thread, each pulling the next job from a shared counter, so uneven step counts still balance out.
+	//Every job profiles its own rock, so workers keep counting allocations as their own.
+	std::atomic<size_t> nextJob(0);
+	const auto work = [&](UINT, UINT)
+	{
+		for (size_t job = nextJob++; job < jobs.size(); job = nextJob++)
+		{
+			RockGenerator generator(jobs[job]);
+			results[job] = generator.Generate();
+		}
+	};
+	RunRanges(numThreads, numThreads, 1, [](const void* pWork, UINT first, UINT last) { (*static_cast<decltype(work)*>(pWork))(first, last); }, &work, false);
+
+	return results;
+}
+
+void RockBatch::RunRanges(UINT count, UINT numThreads, UINT minRangeSize, RangeFunction function, const void* pWork, bool chargeAllocations)
+{
+	if (numThreads == 0)
+		numThreads = GetDefaultThreadCount();
+
+	//More ranges than threads would only queue up, and small ranges cost more to hand out than to run
+	RockThreadPool& pool = RockThreadPool::GetShared();
+	numThreads = (std::min)(numThreads, pool.GetWorkerCount() + 1);
+	numThreads = (std::min)(numThreads, (std::max)(count / (std::max)(minRangeSize, 1u), 1u));
+	if (numThreads <= 1)
+	{
+		if (count > 0)
+			function(pWork, 0, count);
+		return;
+	}
+
+	pool.RunRanges(count, numThreads, function, pWork, chargeAllocations);
+}
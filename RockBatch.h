@@ -0,0 +1,41 @@
+#pragma once
+#include "RockGenerator.h"
+
+//Builds many rocks at once, spreading the jobs over the shared RockThreadPool.
+//Each job runs the full RockGenerator pipeline; results come back in job order.
+//Jobs draw their random numbers from their own RockRandom stream, never from rand(): its state is per thread only
+//on MSVC (glibc shares one locked state), so only the seeded streams build the same rock on any worker.
+class RockBatch
+{
+public:
+	//numThreads == 0 uses every hardware thread
+	static std::vector<RockMesh> Generate(const std::vector<RockParameters>& jobs, UINT numThreads = 0);
+
+	static UINT GetDefaultThreadCount();
+
+	//Below this many items per thread, waking a worker costs about as much as the items themselves
+	static const UINT MIN_RANGE_SIZE = 2048;
+
+	//Splits [0, count) into one contiguous range per thread and runs work(first, last) on each, on the shared
+	//RockThreadPool. Ranges never overlap, so work that only writes inside its range needs no synchronisation.
+	//numThreads is capped by the hardware threads and by count / minRangeSize; one thread runs work right here.
+	//work is called through a function pointer rather than a std::function, which would allocate for larger
+	//captures; with one thread nothing is allocated.
+	template<typename Work>
+	static void ParallelFor(UINT count, UINT numThreads, const Work& work, UINT minRangeSize = MIN_RANGE_SIZE)
+	{
+		RunRanges(count, numThreads, minRangeSize, [](const void* pWork, UINT first, UINT last) { (*static_cast<const Work*>(pWork))(first, last); }, &work, true);
+	}
+
+private:
+	typedef void(*RangeFunction)(const void* pWork, UINT first, UINT last);
+	static void RunRanges(UINT count, UINT numThreads, UINT minRangeSize, RangeFunction function, const void* pWork, bool chargeAllocations);
+
+	// -------------------------
+	// Disabling default constructor, copy constructor and
+	// assignment operator.
+	// -------------------------
+	RockBatch();
+	RockBatch(const RockBatch& yRef);
+	RockBatch& operator=(const RockBatch& yRef);
+};
@@ -0,0 +1,149 @@
+#include "stdafx.h"
+#include "RockDeviceD3D11.h"
+#include <algorithm>
+
+RockDeviceD3D11::RockDeviceD3D11(GameContext* pContext) :
+	m_pContext(pContext),
+	m_pInstanceBuffer(nullptr),
+	m_InstanceCapacity(0),
+	m_CurrentMaterial(0)
+{
+
+}
+
+RockDeviceD3D11::~RockDeviceD3D11(void)
+{
+	if (m_pInstanceBuffer != nullptr)
+		m_pInstanceBuffer->Release();
+}
+
+//REGISTRATION
+//*******************************************************************************************************************************
+UINT RockDeviceD3D11::AddMesh(ID3D11Buffer* pVertexBuffer, UINT vertexStride, ID3D11Buffer* pIndexBuffer, DXGI_FORMAT indexFormat)
+{
+	m_Meshes.push_back({ pVertexBuffer, vertexStride, pIndexBuffer, indexFormat });
+	return (UINT)m_Meshes.size() - 1;
+}
+
+UINT RockDeviceD3D11::AddMaterial(ID3DX11EffectTechnique* pTechnique, ID3D11InputLayout* pInputLayout, const std::function<void()>& apply)
+{
+	m_Materials.push_back({ pTechnique, pInputLayout, apply });
+	return (UINT)m_Materials.size() - 1;
+}
+
+ID3D11InputLayout* RockDeviceD3D11::CreateInputLayout(GameContext* pContext, ID3DX11EffectTechnique* pTechnique, bool packedVertices)
+{
+	D3D11_INPUT_ELEMENT_DESC vertexDesc[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 36, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "WORLD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
+	};
+	UINT numElements = sizeof(vertexDesc) / sizeof(vertexDesc[0]);
+
+	D3D11_INPUT_ELEMENT_DESC packedDesc[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_UNORM, 0, 16, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "WORLD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
+	};
+	UINT numPackedElements = sizeof(packedDesc) / sizeof(packedDesc[0]);
+
+	ID3D11InputLayout* pInputLayout = nullptr;
+	D3DX11_PASS_DESC passDesc;
+	pTechnique->GetPassByIndex(0)->GetDesc(&passDesc);
+	auto hr = pContext->GetDevice()->CreateInputLayout(
+		packedVertices ? packedDesc : vertexDesc,
+		packedVertices ? numPackedElements : numElements,
+		passDesc.pIAInputSignature,
+		passDesc.IAInputSignatureSize,
+		&pInputLayout);
+	Debug::LogHResult(hr, L"Failed to Create instanced InputLayout");
+	return pInputLayout;
+}
+
+//DEVICE
+//*******************************************************************************************************************************
+void RockDeviceD3D11::UploadInstances(const XMFLOAT4X4* pWorlds, UINT count)
+{
+	if (count == 0)
+		return;
+
+	//Grow by doubling so a slowly rising instance count does not recreate the buffer every frame
+	if (count > m_InstanceCapacity)
+	{
+		if (m_pInstanceBuffer != nullptr)
+			m_pInstanceBuffer->Release();
+		m_pInstanceBuffer = nullptr;
+
+		UINT capacity = (std::max)(m_InstanceCapacity * 2, count);
+		D3D11_BUFFER_DESC bd = {};
+		bd.Usage = D3D11_USAGE_DYNAMIC;
+		bd.ByteWidth = sizeof(XMFLOAT4X4) * capacity;
+		bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		bd.MiscFlags = 0;
+		HRESULT hr = m_pContext->GetDevice()->CreateBuffer(&bd, nullptr, &m_pInstanceBuffer);
+		Debug::LogHResult(hr, L"Failed to Create Instancebuffer");
+		m_InstanceCapacity = m_pInstanceBuffer != nullptr ? capacity : 0;
+		if (m_pInstanceBuffer == nullptr)
+			return;
+	}
+
+	auto deviceContext = m_pContext->GetDeviceContext();
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	HRESULT hr = deviceContext->Map(m_pInstanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+	Debug::LogHResult(hr, L"Failed to Map Instancebuffer");
+	if (FAILED(hr))
+		return;
+	memcpy(mapped.pData, pWorlds, sizeof(XMFLOAT4X4) * count);
+	deviceContext->Unmap(m_pInstanceBuffer, 0);
+}
+
+void RockDeviceD3D11::BindMaterial(UINT material)
+{
+	m_CurrentMaterial = material;
+	const Material& current = m_Materials[material];
+	if (current.Apply)
+		current.Apply();
+
+	auto deviceContext = m_pContext->GetDeviceContext();
+	deviceContext->IASetInputLayout(current.pInputLayout);
+	deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+void RockDeviceD3D11::BindMesh(UINT mesh)
+{
+	const Mesh& current = m_Meshes[mesh];
+	ID3D11Buffer* buffers[2] = { current.pVertexBuffer, m_pInstanceBuffer };
+	UINT strides[2] = { current.VertexStride, sizeof(XMFLOAT4X4) };
+	UINT offsets[2] = { 0, 0 };
+
+	auto deviceContext = m_pContext->GetDeviceContext();
+	deviceContext->IASetVertexBuffers(0, 2, buffers, strides, offsets);
+	deviceContext->IASetIndexBuffer(current.pIndexBuffer, current.IndexFormat, 0);
+}
+
+void RockDeviceD3D11::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT firstInstance)
+{
+	auto deviceContext = m_pContext->GetDeviceContext();
+	ID3DX11EffectTechnique* pTechnique = m_Materials[m_CurrentMaterial].pTechnique;
+
+	D3DX11_TECHNIQUE_DESC techDesc;
+	pTechnique->GetDesc(&techDesc);
+	for (UINT p = 0; p < techDesc.Passes; ++p)
+	{
+		pTechnique->GetPassByIndex(p)->Apply(0, deviceContext);
+		deviceContext->DrawIndexedInstanced(indexCount, instanceCount, 0, 0, firstInstance);
+	}
+}
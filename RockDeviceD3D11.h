@@ -0,0 +1,58 @@
+#pragma once
+#include "GameObject.h"
+#include "RockInstancing.h"
+#include <functional>
+
+//RockRenderDevice on top of the engine's D3D11 device context.
+//Vertex and index buffers, techniques and input layouts stay owned by whoever registers them.
+//Instanced techniques read the world matrix as WORLD0..WORLD3 from vertex buffer slot 1.
+class RockDeviceD3D11 : public RockRenderDevice
+{
+public:
+	explicit RockDeviceD3D11(GameContext* pContext);
+	~RockDeviceD3D11(void);
+
+	UINT AddMesh(ID3D11Buffer* pVertexBuffer, UINT vertexStride, ID3D11Buffer* pIndexBuffer, DXGI_FORMAT indexFormat);
+	//apply sets the material's effect variables; it runs once per BindMaterial, before the passes are applied
+	UINT AddMaterial(ID3DX11EffectTechnique* pTechnique, ID3D11InputLayout* pInputLayout, const std::function<void()>& apply);
+
+	//Input layout for a technique reading VertexRock or VertexRockPacked plus the per-instance world matrix
+	static ID3D11InputLayout* CreateInputLayout(GameContext* pContext, ID3DX11EffectTechnique* pTechnique, bool packedVertices);
+
+	void UploadInstances(const XMFLOAT4X4* pWorlds, UINT count) override;
+	void BindMaterial(UINT material) override;
+	void BindMesh(UINT mesh) override;
+	void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT firstInstance) override;
+
+private:
+	struct Mesh
+	{
+		ID3D11Buffer* pVertexBuffer;
+		UINT VertexStride;
+		ID3D11Buffer* pIndexBuffer;
+		DXGI_FORMAT IndexFormat;
+	};
+
+	struct Material
+	{
+		ID3DX11EffectTechnique* pTechnique;
+		ID3D11InputLayout* pInputLayout;
+		std::function<void()> Apply;
+	};
+
+	GameContext* m_pContext;
+	ID3D11Buffer* m_pInstanceBuffer;
+	UINT m_InstanceCapacity;
+	std::vector<Mesh> m_Meshes;
+	std::vector<Material> m_Materials;
+	UINT m_CurrentMaterial;
+
+private:
+
+	// -------------------------
+	// Disabling default copy constructor and default
+	// assignment operator.
+	// -------------------------
+	RockDeviceD3D11(const RockDeviceD3D11& yRef);
+	RockDeviceD3D11& operator=(const RockDeviceD3D11& yRef);
+};
@@ -0,0 +1,182 @@
+#include "stdafx.h"
+#include "RockField.h"
+#include "RockBatch.h"
+#include "RockRandom.h"
+#include <cmath>
+
+//Candidates tried around an active point before it retires (Bridson's k)
+static const UINT SCATTER_ATTEMPTS = 12;
+//Points per spacing^2 a filled Poisson-disk set reaches with SCATTER_ATTEMPTS
+static const float SCATTER_PACKING = 0.82f;
+//Smallest instance scale; the log-uniform scale needs MinScale > 0
+static const float MIN_INSTANCE_SCALE = 0.001f;
+
+//SCATTER
+//*******************************************************************************************************************************
+float RockFieldGenerator::GetSpacing(float density)
+{
+	return density > 0.0f ? sqrtf(SCATTER_PACKING / density) : 0.0f;
+}
+
+std::vector<XMFLOAT2> RockFieldGenerator::Scatter(const XMFLOAT2& min, const XMFLOAT2& max, float spacing, UINT seed, UINT maxPoints)
+{
+	std::vector<XMFLOAT2> points;
+	if (spacing <= 0.0f || max.x <= min.x || max.y <= min.y)
+		return points;
+
+	//A cell's diagonal is the spacing, so every cell holds at most one point. Cells keep the point itself, empty
+	//ones a point far outside, and a border of two empty cells lets every lookup read its 5x5 block unchecked.
+	const float FAR_AWAY = 1e18f;
+	float cellSize = spacing / sqrtf(2.0f);
+	UINT columns = (UINT)ceilf((max.x - min.x) / cellSize) + 4;
+	UINT rows = (UINT)ceilf((max.y - min.y) / cellSize) + 4;
+	std::vector<XMFLOAT2> grid((size_t)columns * rows, XMFLOAT2(FAR_AWAY, FAR_AWAY));
+
+	const auto GetCell = [&](const XMFLOAT2& point)
+	{
+		UINT column = (std::min)((UINT)((point.x - min.x) / cellSize), columns - 5) + 2;
+		UINT row = (std::min)((UINT)((point.y - min.y) / cellSize), rows - 5) + 2;
+		return (size_t)row * columns + column;
+	};
+
+	//The corner cells of the block are a full spacing away and can be skipped
+	const auto IsFree = [&](const XMFLOAT2& point)
+	{
+		const XMFLOAT2* pCenter = &grid[GetCell(point)];
+		float closest = FAR_AWAY;
+		for (int r = -2; r <= 2; r++)
+		{
+			int reach = (r == -2 || r == 2) ? 1 : 2;
+			const XMFLOAT2* pRow = pCenter + (ptrdiff_t)r * columns;
+			for (int c = -reach; c <= reach; c++)
+			{
+				float dx = pRow[c].x - point.x, dy = pRow[c].y - point.y;
+				closest = (std::min)(closest, dx * dx + dy * dy);
+			}
+		}
+		return closest >= spacing * spacing;
+	};
+
+	std::vector<UINT> active;
+	const auto AddPoint = [&](const XMFLOAT2& point)
+	{
+		grid[GetCell(point)] = point;
+		active.push_back((UINT)points.size());
+		points.push_back(point);
+	};
+
+	float distance = spacing * 1.0001f;
+	float stepCos = cosf(XM_2PI / SCATTER_ATTEMPTS), stepSin = sinf(XM_2PI / SCATTER_ATTEMPTS);
+	RockRandom random(seed, 0);
+	AddPoint(XMFLOAT2(min.x + random.NextFloat() * (max.x - min.x), min.y + random.NextFloat() * (max.y - min.y)));
+	while (!active.empty() && (maxPoints == 0 || points.size() < maxPoints))
+	{
+		UINT slot = random.Next() % (UINT)active.size();
+		XMFLOAT2 center = points[active[slot]];
+
+		//Candidates just past the spacing, evenly around the active point from a random angle, instead of
+		//Bridson's random ones in [spacing, 2 * spacing): packs tighter and retires points after far fewer tries
+		float angle = random.NextFloat() * XM_2PI;
+		XMFLOAT2 direction(cosf(angle), sinf(angle));
+		bool placed = false;
+		for (UINT attempt = 0; attempt < SCATTER_ATTEMPTS && !placed; attempt++)
+		{
+			XMFLOAT2 candidate(center.x + direction.x * distance, center.y + direction.y * distance);
+			direction = XMFLOAT2(direction.x * stepCos - direction.y * stepSin, direction.x * stepSin + direction.y * stepCos);
+			if (candidate.x < min.x || candidate.x >= max.x || candidate.y < min.y || candidate.y >= max.y)
+				continue;
+
+			if (IsFree(candidate))
+			{
+				AddPoint(candidate);
+				placed = true;
+			}
+		}
+
+		//Nothing fits around it any more
+		if (!placed)
+		{
+			active[slot] = active.back();
+			active.pop_back();
+		}
+	}
+	return points;
+}
+
+//FIELD
+//*******************************************************************************************************************************
+RockField RockFieldGenerator::Generate(const RockFieldDesc& desc, UINT numThreads)
+{
+	RockField field;
+
+	//SCATTER
+	//-----------------------------------------------------------------------------------------
+	double start = RockProfiler::GetTime();
+	float spacing = desc.MinSpacing > 0.0f ? desc.MinSpacing : GetSpacing(desc.Density);
+	std::vector<XMFLOAT2> points = Scatter(desc.Min, desc.Max, spacing, desc.Seed, desc.MaxInstances);
+	double scattered = RockProfiler::GetTime();
+
+	//PLACE
+	//-----------------------------------------------------------------------------------------
+	//Every instance draws from its own stream, so the instances can be placed on any thread
+	UINT variantCount = (std::max)(desc.VariantCount, 1u);
+	float minScale = (std::max)(MIN_INSTANCE_SCALE, desc.MinScale);
+	float maxScale = (std::max)(minScale, desc.MaxScale);
+	UINT minSteps = (std::min)(desc.MinSteps, desc.Parameters.Steps);
+	UINT levelCount = desc.Parameters.Steps - minSteps + 1;
+	std::vector<UINT> meshKeys(points.size());
+	field.Instances.resize(points.size());
+	RockBatch::ParallelFor((UINT)points.size(), numThreads, [&](UINT first, UINT last)
+	{
+		for (UINT i = first; i < last; i++)
+		{
+			RockRandom random(desc.Seed, i + 1);
+			UINT variant = random.Next() % variantCount;
+			float size = random.NextFloat();
+			float scale = minScale * powf(maxScale / minScale, size);
+			float yaw = random.NextFloat() * XM_2PI;
+			XMFLOAT3 stretch;
+			stretch.x = 1.0f + (random.NextFloat() * 2.0f - 1.0f) * desc.MaxStretch;
+			stretch.y = 1.0f + (random.NextFloat() * 2.0f - 1.0f) * desc.MaxStretch;
+			stretch.z = 1.0f + (random.NextFloat() * 2.0f - 1.0f) * desc.MaxStretch;
+
+			//Bigger rocks get more subdivisions
+			UINT level = (std::min)((UINT)(size * levelCount), levelCount - 1);
+			meshKeys[i] = variant * levelCount + level;
+
+			XMMATRIX world = XMMatrixScaling(scale * stretch.x, scale * stretch.y, scale * stretch.z) *
+				XMMatrixRotationY(yaw) * XMMatrixTranslation(points[i].x, desc.Height, points[i].y);
+			XMStoreFloat4x4(&field.Instances[i].World, world);
+		}
+	});
+
+	//Instances sharing variant and level share the mesh; meshes are numbered by first use
+	const UINT NO_MESH = ~0u;
+	std::vector<UINT> meshOfKey(variantCount * levelCount, NO_MESH);
+	for (UINT i = 0; i < points.size(); i++)
+	{
+		UINT& mesh = meshOfKey[meshKeys[i]];
+		if (mesh == NO_MESH)
+		{
+			mesh = (UINT)field.Parameters.size();
+			RockParameters parameters = desc.Parameters;
+			parameters.Seed = (UINT)RockRandom::Mix((static_cast<UINT64>(desc.Seed) << 32) | (meshKeys[i] / levelCount));
+			parameters.Steps = minSteps + meshKeys[i] % levelCount;
+			field.Parameters.push_back(parameters);
+		}
+		field.Instances[i].Mesh = mesh;
+	}
+	double placed = RockProfiler::GetTime();
+
+	//MESHES
+	//-----------------------------------------------------------------------------------------
+	field.Meshes = RockBatch::Generate(field.Parameters, numThreads);
+	double built = RockProfiler::GetTime();
+
+	field.Stats.Instances = (UINT)field.Instances.size();
+	field.Stats.UniqueMeshes = (UINT)field.Meshes.size();
+	field.Stats.ScatterMilliseconds = scattered - start;
+	field.Stats.PlaceMilliseconds = placed - scattered;
+	field.Stats.MeshMilliseconds = built - placed;
+	return field;
+}
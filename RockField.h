@@ -0,0 +1,83 @@
+#pragma once
+#include "RockGenerator.h"
+
+//How a rock field is scattered and what its rocks look like
+struct RockFieldDesc
+{
+	//Rectangle on the xz plane; rocks sit at y = Height
+	XMFLOAT2 Min = XMFLOAT2(0, 0);
+	XMFLOAT2 Max = XMFLOAT2(100, 100);
+	float Height = 0.0f;
+
+	//Rocks per square unit, turned into the Poisson-disk spacing. MinSpacing > 0 sets the spacing directly.
+	//Keep MaxScale * the largest rock radius below half the spacing, or neighbours can overlap.
+	float Density = 0.05f;
+	float MinSpacing = 0.0f;
+	//Stops scattering after this many rocks, 0 fills the area
+	UINT MaxInstances = 0;
+
+	//Uniform scale, log-uniform in [MinScale, MaxScale], and an extra stretch of up to +-MaxStretch per axis.
+	//MinScale is raised to at least 0.001 and MaxScale to at least MinScale.
+	float MinScale = 0.5f;
+	float MaxScale = 2.0f;
+	float MaxStretch = 0.25f;
+
+	//Shape of every rock. Each of the VariantCount variants gets its own seed; the smallest rocks are built
+	//with MinSteps subdivisions, the largest with Parameters.Steps.
+	RockParameters Parameters;
+	UINT VariantCount = 16;
+	UINT MinSteps = 0;
+	UINT Seed = 0;
+};
+
+struct RockFieldInstance
+{
+	XMFLOAT4X4 World;
+	UINT Mesh = 0; //index into RockField::Meshes and RockField::Parameters
+};
+
+struct RockFieldStats
+{
+	UINT Instances = 0;
+	UINT UniqueMeshes = 0;
+	double ScatterMilliseconds = 0.0;
+	double PlaceMilliseconds = 0.0;
+	double MeshMilliseconds = 0.0;
+};
+
+//A scattered field: every instance points at one of the deduplicated meshes
+struct RockField
+{
+	std::vector<RockFieldInstance> Instances;
+	std::vector<RockParameters> Parameters;
+	std::vector<RockMesh> Meshes;
+	RockFieldStats Stats;
+};
+
+//Scatters rocks over an area with blue noise spacing and builds the meshes they need.
+//Instances only choose a variant and a detail level, so however many there are, at most
+//VariantCount * (Parameters.Steps - MinSteps + 1) meshes get built, in parallel over RockBatch.
+class RockFieldGenerator
+{
+public:
+	//numThreads == 0 uses every hardware thread; the field does not depend on it
+	static RockField Generate(const RockFieldDesc& desc, UINT numThreads = 0);
+
+	//Poisson-disk sampling after Bridson: no two points closer than spacing. Each active point tries 12 candidates
+	//evenly around it at 1.0001 * spacing before it retires, so the set is dense but not maximal: a gap can still
+	//hold a point no candidate landed on. Points come out in the order they were placed; maxPoints == 0 fills the
+	//whole rectangle.
+	static std::vector<XMFLOAT2> Scatter(const XMFLOAT2& min, const XMFLOAT2& max, float spacing, UINT seed, UINT maxPoints = 0);
+
+	//Spacing that gives about density points per square unit
+	static float GetSpacing(float density);
+
+private:
+	// -------------------------
+	// Disabling default constructor, copy constructor and
+	// assignment operator.
+	// -------------------------
+	RockFieldGenerator();
+	RockFieldGenerator(const RockFieldGenerator& yRef);
+	RockFieldGenerator& operator=(const RockFieldGenerator& yRef);
+};
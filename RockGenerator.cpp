@@ -0,0 +1,901 @@
+#include "stdafx.h"
+#include "RockGenerator.h"
+#include "RockRandom.h"
+#include "RockBatch.h"
+#include "RockNoise.h"
+#include <algorithm>
+#include <cfloat>
+
+RockGenerator::RockGenerator(const RockParameters& parameters, UINT numThreads) :
+	m_Parameters(parameters),
+	m_NumThreads(numThreads),
+	m_NumVertices(0),
+	m_NumIndices(0)
+{
+
+}
+
+RockMesh RockGenerator::Generate()
+{
+	RockMesh mesh;
+	Generate(mesh);
+	return mesh;
+}
+
+void RockGenerator::Generate(RockMesh& mesh)
+{
+	m_Profiler.Clear();
+	m_Profiler.SetLod(0);
+	UpdatePlanes();
+
+	//Borrows mesh's buffers for the one LOD, so their capacity is kept
+	RockLod lod;
+	std::swap(lod.Mesh, mesh);
+	BuildLevel(lod, nullptr, nullptr, nullptr);
+	std::swap(lod.Mesh, mesh);
+	TrimStageCache(m_Parameters.Steps, m_Parameters.Steps);
+}
+
+std::vector<RockLod> RockGenerator::GenerateLods(UINT lodCount)
+{
+	std::vector<RockLod> lods;
+	GenerateLods(lodCount, lods);
+	return lods;
+}
+
+void RockGenerator::GenerateLods(UINT lodCount, std::vector<RockLod>& lods)
+{
+	//Planes only depend on the seed, so every LOD is flattened by the same set and the silhouettes match
+	m_Profiler.Clear();
+	m_Profiler.SetLod(0);
+	UpdatePlanes();
+
+	UINT finestSteps = m_Parameters.Steps;
+	IcosphereCache::IcosphereRef finestLevel;
+
+	lods.resize((std::min)(lodCount, finestSteps + 1));
+	for (UINT lod = 0; lod < lods.size(); lod++)
+	{
+		m_Parameters.Steps = finestSteps - lod;
+		m_Profiler.SetLod(lod);
+		if (lod == 0)
+		{
+			BuildLevel(lods[lod], &m_FinestPositions, nullptr, nullptr);
+			finestLevel = m_Level;
+		}
+		else
+		{
+			BuildLevel(lods[lod], nullptr, &m_FinestPositions, finestLevel.get());
+		}
+	}
+
+	m_Parameters.Steps = finestSteps;
+	if (finestLevel)
+		m_Level = finestLevel;
+	TrimStageCache(finestSteps + 1 - (UINT)lods.size(), finestSteps);
+}
+
+ProgressiveMesh RockGenerator::GenerateProgressive()
+{
+	RockMesh mesh = Generate();
+	return ProgressiveMeshBuilder::Build(mesh.Vertices, mesh.Indices);
+}
+
+float RockGenerator::ProjectScreenError(float geometricError, float distance, float projectionScaleY)
+{
+	//Clip space y spans 2 units over the viewport height
+	if (distance <= 0.0f)
+		return FLT_MAX;
+	return geometricError * projectionScaleY / (2.0f * distance);
+}
+
+UINT RockGenerator::SelectLod(const std::vector<RockLod>& lods, float distance, float projectionScaleY, float maxScreenError)
+{
+	for (UINT lod = (UINT)lods.size(); lod > 1; lod--)
+	{
+		if (ProjectScreenError(lods[lod - 1].GeometricError, distance, projectionScaleY) <= maxScreenError)
+			return lod - 1;
+	}
+	return 0;
+}
+
+//STAGE REUSE
+//*******************************************************************************************************************************
+UINT RockParameters::GetChanges(const RockParameters& other) const
+{
+	UINT changes = 0;
+	const auto Compare = [&changes](bool differs, RockParameter parameter)
+	{
+		if (differs)
+			changes |= GetBit(parameter);
+	};
+	Compare(Width != other.Width, RockParameter::Width);
+	Compare(Height != other.Height, RockParameter::Height);
+	Compare(Depth != other.Depth, RockParameter::Depth);
+	Compare(Steps != other.Steps, RockParameter::Steps);
+	Compare(MinRandAngle != other.MinRandAngle, RockParameter::MinRandAngle);
+	Compare(MaxRandAngle != other.MaxRandAngle, RockParameter::MaxRandAngle);
+	Compare(MaxOffsetPercent != other.MaxOffsetPercent, RockParameter::MaxOffsetPercent);
+	Compare(MaxRandShift != other.MaxRandShift, RockParameter::MaxRandShift);
+	Compare(MinPlaneVerts != other.MinPlaneVerts, RockParameter::MinPlaneVerts);
+	Compare(MaxPlaneVerts != other.MaxPlaneVerts, RockParameter::MaxPlaneVerts);
+	Compare(MaxPlanes != other.MaxPlanes, RockParameter::MaxPlanes);
+	Compare(Seed != other.Seed, RockParameter::Seed);
+	Compare(NoiseOctaves != other.NoiseOctaves, RockParameter::NoiseOctaves);
+	Compare(NoiseFrequency != other.NoiseFrequency, RockParameter::NoiseFrequency);
+	Compare(NoiseAmplitude != other.NoiseAmplitude, RockParameter::NoiseAmplitude);
+	Compare(NoiseLacunarity != other.NoiseLacunarity, RockParameter::NoiseLacunarity);
+	Compare(NoiseGain != other.NoiseGain, RockParameter::NoiseGain);
+	Compare(NoiseSeed != other.NoiseSeed, RockParameter::NoiseSeed);
+	return changes;
+}
+
+//MaxRandShift, MinPlaneVerts and MaxPlaneVerts are read by no stage, changing them rebuilds nothing
+UINT RockGenerator::GetStageParameters(RockStage stage)
+{
+	const UINT size = RockParameters::GetBit(RockParameter::Width) | RockParameters::GetBit(RockParameter::Height) | RockParameters::GetBit(RockParameter::Depth);
+	switch (stage)
+	{
+	case RockStage::Planes:
+		return size | RockParameters::GetBit(RockParameter::MinRandAngle) | RockParameters::GetBit(RockParameter::MaxRandAngle) |
+			RockParameters::GetBit(RockParameter::MaxOffsetPercent) | RockParameters::GetBit(RockParameter::MaxPlanes) | RockParameters::GetBit(RockParameter::Seed);
+	case RockStage::Ico:
+		return size | RockParameters::GetBit(RockParameter::Steps);
+	case RockStage::Rock: //flatten tolerance
+	case RockStage::Expand: //push distance
+		return size;
+	case RockStage::Displace: //noise, scaled by the average radius
+		return size | RockParameters::GetBit(RockParameter::NoiseOctaves) | RockParameters::GetBit(RockParameter::NoiseFrequency) |
+			RockParameters::GetBit(RockParameter::NoiseAmplitude) | RockParameters::GetBit(RockParameter::NoiseLacunarity) |
+			RockParameters::GetBit(RockParameter::NoiseGain) | RockParameters::GetBit(RockParameter::NoiseSeed);
+	default:
+		return 0;
+	}
+}
+
+void RockGenerator::SetStageReuse(bool reuse)
+{
+	m_ReuseStages = reuse;
+	if (!reuse)
+	{
+		m_StageCache.clear();
+		m_HasPlanes = false;
+	}
+}
+
+RockStage RockGenerator::GetFirstDirtyStage(const StageCache& cache) const
+{
+	if (!cache.Level)
+		return RockStage::Ico;
+
+	UINT changes = m_Parameters.GetChanges(cache.Parameters);
+	for (UINT stage = UINT(RockStage::Ico); stage <= UINT(RockStage::Interleave); stage++)
+	{
+		UINT parameters = GetStageParameters(RockStage(stage));
+		if (RockStage(stage) == RockStage::Rock)
+			parameters |= GetStageParameters(RockStage::Planes);
+		if ((changes & parameters) != 0)
+			return RockStage(stage);
+	}
+	return cache.HasMesh ? RockStage::Count : RockStage::Rock;
+}
+
+//Levels the last call did not build are dropped, so memory stays bounded by one LOD chain
+void RockGenerator::TrimStageCache(UINT minSteps, UINT maxSteps)
+{
+	for (auto it = m_StageCache.begin(); it != m_StageCache.end();)
+	{
+		if (it->first < minSteps || it->first > maxSteps)
+			it = m_StageCache.erase(it);
+		else
+			++it;
+	}
+}
+
+void RockGenerator::UpdatePlanes()
+{
+	UINT changes = m_Parameters.GetChanges(m_PlanesParameters);
+	if (m_ReuseStages && m_HasPlanes && (changes & GetStageParameters(RockStage::Planes)) == 0)
+		return;
+
+	RunStage(RockStage::Planes, &RockGenerator::BuildPlanes);
+	m_PlanesParameters = m_Parameters;
+	m_HasPlanes = true;
+}
+
+void RockGenerator::BuildLevel(RockLod& result, Float3Stream* pShape, const Float3Stream* pFinestShape, const IcosphereLevel* pFinestLevel)
+{
+	result.Steps = m_Parameters.Steps;
+	result.GeometricError = 0.0f;
+	StageCache* pCache = m_ReuseStages ? &m_StageCache[m_Parameters.Steps] : nullptr;
+
+	//Nothing this level depends on changed: hand out the kept mesh, no stage runs
+	if (pCache != nullptr && GetFirstDirtyStage(*pCache) == RockStage::Count)
+	{
+		m_Level = pCache->Level;
+		if (pShape != nullptr)
+			*pShape = pCache->ShapePositions;
+		if (pFinestShape != nullptr)
+			result.GeometricError = MeasureLodError(*pFinestShape, *pFinestLevel, pCache->ShapePositions, *m_Level);
+		result.Mesh = pCache->Mesh;
+		pCache->Parameters = m_Parameters;
+		return;
+	}
+
+	BuildShape(pCache);
+	if (pShape != nullptr)
+		*pShape = m_Positions;
+	if (pFinestShape != nullptr)
+		result.GeometricError = MeasureLodError(*pFinestShape, *pFinestLevel, m_Positions, *m_Level);
+	if (pCache != nullptr)
+		pCache->ShapePositions = m_Positions;
+
+	BuildMesh(result.Mesh);
+	if (pCache != nullptr)
+	{
+		pCache->Mesh = result.Mesh;
+		pCache->HasMesh = true;
+		pCache->Parameters = m_Parameters;
+	}
+}
+
+//Everything up to the final vertex data, in the order of the unit sphere.
+//With a cache only the scaled sphere is kept as a restart point: a level whose sphere is still valid restarts at
+//BuildRock, which every plane parameter dirties anyway, and reruns the stages after it.
+void RockGenerator::BuildShape(StageCache* pCache)
+{
+	if (pCache == nullptr || GetFirstDirtyStage(*pCache) == RockStage::Ico)
+	{
+		m_Positions.clear();
+		m_Normals.clear();
+		m_Tangents.clear();
+		m_TexCoords.clear();
+		m_VecIndices.clear();
+		m_NumVertices = 0;
+		m_NumIndices = 0;
+
+		RunStage(RockStage::Ico, &RockGenerator::BuildIco);
+		if (pCache != nullptr)
+		{
+			pCache->Level = m_Level;
+			pCache->IcoPositions = m_Positions;
+			pCache->IcoNormals = m_Normals;
+			pCache->IcoTexCoords = m_TexCoords;
+			pCache->IcoIndices = m_VecIndices;
+			pCache->HasMesh = false;
+		}
+	}
+	else
+	{
+		m_Level = pCache->Level;
+		m_Positions = pCache->IcoPositions;
+		m_Normals = pCache->IcoNormals;
+		m_Tangents = pCache->IcoNormals;
+		m_TexCoords = pCache->IcoTexCoords;
+		m_VecIndices = pCache->IcoIndices;
+		m_NumVertices = (UINT)m_Positions.size();
+		m_NumIndices = (UINT)m_VecIndices.size();
+	}
+
+	RunStage(RockStage::Rock, &RockGenerator::BuildRock);
+	RunStage(RockStage::Expand, &RockGenerator::Expand);
+	RunStage(RockStage::Displace, &RockGenerator::Displace);
+	RunStage(RockStage::CorrectUV, &RockGenerator::CorrectUV);
+	RunStage(RockStage::Surface, &RockGenerator::BuildSurface);
+}
+
+void RockGenerator::BuildMesh(RockMesh& mesh)
+{
+	RunStage(RockStage::DrawOrder, &RockGenerator::OptimizeDrawOrder);
+
+	m_Profiler.Begin((UINT)m_Positions.size(), (UINT)m_VecIndices.size());
+	Interleave(mesh.Vertices);
+	m_Profiler.End(RockStage::Interleave, (UINT)mesh.Vertices.size(), (UINT)m_VecIndices.size());
+	//The mesh's old index buffer becomes the next build's scratch
+	mesh.Indices.swap(m_VecIndices);
+}
+
+void RockGenerator::RunStage(RockStage stage, void (RockGenerator::*build)())
+{
+	m_Profiler.Begin((UINT)m_Positions.size(), (UINT)m_VecIndices.size());
+	(this->*build)();
+	m_Profiler.End(stage, (UINT)m_Positions.size(), (UINT)m_VecIndices.size());
+}
+
+//BUILD ICOSPHERE
+//*******************************************************************************************************************************
+void RockGenerator::BuildIco()
+{
+	//Unit sphere topology is shared between every rock with the same step count
+	m_Level = IcosphereCache::Get(m_Parameters.Steps);
+	const auto& vertices = m_Level->Mesh.first;
+	const auto& indices = m_Level->Mesh.second;
+
+	//Exact sizes up front: CorrectUV appends the seam splits to the vertices. The scratch streams swap with the
+	//working ones in OptimizeDrawOrder, so both get room for every scratch use as well: patch order in BuildRock
+	//and one value per triangle in Expand and BuildSurface.
+	size_t vertexCount = vertices.size() + m_Level->SeamSplits.size();
+	size_t streamCount = (std::max)((std::max)(vertexCount, m_Level->PatchVertices.size()), indices.size());
+	m_Positions.reserve(streamCount);
+	m_Normals.reserve(streamCount);
+	m_Tangents.reserve(streamCount);
+	m_TexCoords.reserve(vertexCount);
+	m_ScratchPositions.reserve(streamCount);
+	m_ScratchNormals.reserve(streamCount);
+	m_ScratchTangents.reserve(streamCount);
+	m_ScratchTexCoords.reserve(vertexCount);
+
+	//SUBDIVIDE TRIANGLES + ADD NEW VERTICES TO BUFFER
+	//-----------------------------------------------------------------------------------------
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		auto vertice = vertices[i];
+		auto vertVector = XMVector3Normalize(XMLoadFloat3(&vertice));
+		XMFLOAT3 vert;
+		DirectX::XMStoreFloat3(&vert, XMVector3Normalize(vertVector));
+
+		XMFLOAT3 newVert;
+		newVert = vert;
+		newVert.x *= m_Parameters.Width;
+		newVert.y *= m_Parameters.Height;
+		newVert.z *= m_Parameters.Depth;
+
+		XMFLOAT3 normal;
+		auto normalVector = XMVector3Normalize(XMLoadFloat3(&newVert));
+		DirectX::XMStoreFloat3(&normal, XMVector3Normalize(normalVector));
+
+		XMFLOAT2 texcoord;
+		texcoord = UVFromVector3(newVert);
+
+		//Tangents start out as the normal, the same way VertexRock(VertexBase) seeds them
+		m_Positions.push_back(newVert);
+		m_Normals.push_back(normal);
+		m_Tangents.push_back(normal);
+		m_TexCoords.push_back(texcoord);
+	}
+	m_NumVertices = m_Positions.size();
+
+	//SET INDICES
+	//-----------------------------------------------------------------------------------------
+	m_VecIndices.reserve(indices.size() * 3);
+	for (auto indice : indices)
+	{
+		m_VecIndices.push_back(indice.vertex[0]);
+		m_VecIndices.push_back(indice.vertex[1]);
+		m_VecIndices.push_back(indice.vertex[2]);
+	}
+	m_NumIndices = m_VecIndices.size();
+}
+
+//CONVERT ICOSPHERE INTO 'ROCK'
+//*******************************************************************************************************************************
+RockGenerator::Plane RockGenerator::BuildPlane(UINT index) const
+{
+	//Every plane draws from its own stream, so planes do not depend on each other or on call order
+	RockRandom random(m_Parameters.Seed, index);
+
+	//Determine position of plane by angle on sphere
+	XMFLOAT2 angles;
+	angles.x = (float)random.NextInt((int)m_Parameters.MinRandAngle, (int)m_Parameters.MaxRandAngle);
+	angles.y = (float)random.NextInt((int)m_Parameters.MinRandAngle, (int)m_Parameters.MaxRandAngle);
+
+	//Origin plane
+	XMFLOAT3 originPlane, radiusPlane;
+	originPlane.x = m_Parameters.Width * cos(angles.x) * cos(angles.y);
+	originPlane.y = m_Parameters.Height * cos(angles.x) * sin(angles.y);
+	originPlane.z = m_Parameters.Depth * sin(angles.x);
+
+	radiusPlane.x = m_Parameters.Width * cos(angles.x + XM_PI) * cos(angles.y + XM_PI);
+	radiusPlane.y = m_Parameters.Height * cos(angles.x + XM_PI) * sin(angles.y + XM_PI);
+	radiusPlane.z = m_Parameters.Depth * sin(angles.x + XM_PI);
+
+	//Create plane
+	Plane plane;
+	XMVECTOR origin = DirectX::XMLoadFloat3(&originPlane);
+	float offset = (float)random.NextInt(0, (int)m_Parameters.MaxOffsetPercent);
+	origin *= (100.0f - offset) / 100.0f;
+	DirectX::XMStoreFloat3(&plane.origin, origin);
+	DirectX::XMStoreFloat3(&plane.normal, XMVector3Normalize(origin));
+	plane.diameter = LengthBetweenPoints(XMFLOAT3(0,0,0), radiusPlane) / 2.0f;
+
+	return plane;
+}
+
+void RockGenerator::BuildPlanes()
+{
+	m_Planes.resize(m_Parameters.MaxPlanes);
+	for (UINT plane = 0; plane < m_Parameters.MaxPlanes; plane++)
+	{
+		m_Planes[plane] = BuildPlane(plane);
+	}
+}
+
+void RockGenerator::BuildRock()
+{
+	if (m_Planes.empty())
+		return;
+
+	//GROUP VERTICES BY BASE FACE AND PATCH
+	//-----------------------------------------------------------------------------------------
+	//Patch ordered copies, so every patch is a contiguous run of 4-wide groups
+	const auto& patchVertices = m_Level->PatchVertices;
+	const auto& patchOffsets = m_Level->PatchOffsets;
+	UINT patchCount = m_Level->GetPatchCount();
+	UINT patchesPerFace = m_Level->PatchesPerFace;
+	UINT faceCount = patchCount / patchesPerFace;
+
+	Float3Stream& positions = m_ScratchPositions;
+	Float3Stream& normals = m_ScratchNormals;
+	positions.resize(patchVertices.size());
+	normals.resize(patchVertices.size());
+	for (UINT slot = 0; slot < patchVertices.size(); slot++)
+	{
+		positions.Set(slot, m_Positions.Get(patchVertices[slot]));
+		normals.Set(slot, m_Normals.Get(patchVertices[slot]));
+	}
+
+	std::vector<PatchBounds>& patchBounds = m_PatchBounds;
+	std::vector<PatchBounds>& faceBounds = m_FaceBounds;
+	patchBounds.resize(patchCount);
+	faceBounds.resize(faceCount);
+	for (UINT patch = 0; patch < patchCount; patch++)
+	{
+		patchBounds[patch] = ComputePatchBounds(positions, patchOffsets[patch], patchOffsets[patch + 1]);
+	}
+	for (UINT face = 0; face < faceCount; face++)
+	{
+		faceBounds[face] = MergePatchBounds(patchBounds, face * patchesPerFace, (face + 1) * patchesPerFace);
+	}
+
+	//FLATTEN BY 'PLANES'
+	//-----------------------------------------------------------------------------------------
+	//Positions move with every plane, so a patch refreshes its bounds as soon as a plane touches it
+	float tolerance = 1e-4f * (m_Parameters.Width + m_Parameters.Height + m_Parameters.Depth) / 3.0f;
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR half = XMVectorReplicate(0.5f);
+	XMVECTOR one = XMVectorReplicate(1.0f);
+	for (UINT plane = 0; plane < m_Planes.size(); plane++)
+	{
+		const Plane& currentPlane = m_Planes[plane];
+		XMVECTOR originX = XMVectorReplicate(currentPlane.origin.x);
+		XMVECTOR originY = XMVectorReplicate(currentPlane.origin.y);
+		XMVECTOR originZ = XMVectorReplicate(currentPlane.origin.z);
+		XMVECTOR normalX = XMVectorReplicate(currentPlane.normal.x);
+		XMVECTOR normalY = XMVectorReplicate(currentPlane.normal.y);
+		XMVECTOR normalZ = XMVectorReplicate(currentPlane.normal.z);
+		XMVECTOR invDiameter = XMVectorReplicate(1.0f / currentPlane.diameter);
+
+		for (UINT face = 0; face < faceCount; face++)
+		{
+			if (IsBehindPlane(faceBounds[face], currentPlane, tolerance))
+				continue;
+
+			bool faceChanged = false;
+			for (UINT patch = face * patchesPerFace; patch < (face + 1) * patchesPerFace; patch++)
+			{
+				if (IsBehindPlane(patchBounds[patch], currentPlane, tolerance))
+					continue;
+
+				//Flatten vertices onto plane, four at a time
+				bool patchChanged = false;
+				XMVECTOR minX = XMVectorReplicate(FLT_MAX), minY = minX, minZ = minX;
+				XMVECTOR maxX = XMVectorReplicate(-FLT_MAX), maxY = maxX, maxZ = maxX;
+				for (UINT i = patchOffsets[patch]; i < patchOffsets[patch + 1]; i += 4)
+				{
+					XMVECTOR pointX, pointY, pointZ;
+					positions.Load4(i, pointX, pointY, pointZ);
+
+					//Check if vertice is in front of the plane
+					XMVECTOR vecPX = pointX - originX;
+					XMVECTOR vecPY = pointY - originY;
+					XMVECTOR vecPZ = pointZ - originZ;
+					XMVECTOR dist = vecPX * normalX + vecPY * normalY + vecPZ * normalZ;
+					XMVECTOR inFront = XMVectorGreaterOrEqual(dist, zero); // skip if dot is negative == more then 90 degree
+					if (XMComparisonAnyTrue(XMVector4GreaterOrEqualR(dist, zero)))
+					{
+						//Project on plane
+						XMVECTOR projX = pointX - dist * normalX - originX;
+						XMVECTOR projY = pointY - dist * normalY - originY;
+						XMVECTOR projZ = pointZ - dist * normalZ - originZ;
+						XMVECTOR distToCenter = XMVectorSqrt(projX * projX + projY * projY + projZ * projZ);
+
+						//Create new vertice, make curved
+						XMVECTOR strength = invDiameter * distToCenter - one;
+						XMVECTOR push = dist * half;
+
+						pointX = XMVectorSelect(pointX, pointX - push * normalX * strength, inFront);
+						pointY = XMVectorSelect(pointY, pointY - push * normalY * strength, inFront);
+						pointZ = XMVectorSelect(pointZ, pointZ - push * normalZ * strength, inFront);
+						positions.Store4(i, pointX, pointY, pointZ);
+
+						XMVECTOR oldNormalX, oldNormalY, oldNormalZ;
+						normals.Load4(i, oldNormalX, oldNormalY, oldNormalZ);
+						normals.Store4(i,
+							XMVectorSelect(oldNormalX, normalX, inFront),
+							XMVectorSelect(oldNormalY, normalY, inFront),
+							XMVectorSelect(oldNormalZ, normalZ, inFront));
+
+						patchChanged = true;
+					}
+
+					minX = XMVectorMin(minX, pointX); minY = XMVectorMin(minY, pointY); minZ = XMVectorMin(minZ, pointZ);
+					maxX = XMVectorMax(maxX, pointX); maxY = XMVectorMax(maxY, pointY); maxZ = XMVectorMax(maxZ, pointZ);
+				}
+
+				if (patchChanged)
+				{
+					patchBounds[patch] = ReducePatchBounds(minX, minY, minZ, maxX, maxY, maxZ);
+					faceChanged = true;
+				}
+			}
+
+			if (faceChanged)
+				faceBounds[face] = MergePatchBounds(patchBounds, face * patchesPerFace, (face + 1) * patchesPerFace);
+		}
+	}
+
+	//Back to vertex order, padding slots hold the same values as the vertex they repeat
+	for (UINT slot = 0; slot < patchVertices.size(); slot++)
+	{
+		m_Positions.Set(patchVertices[slot], positions.Get(slot));
+		m_Normals.Set(patchVertices[slot], normals.Get(slot));
+	}
+}
+
+RockGenerator::PatchBounds RockGenerator::ComputePatchBounds(const Float3Stream& positions, UINT first, UINT last)
+{
+	XMVECTOR minX = XMVectorReplicate(FLT_MAX), minY = minX, minZ = minX;
+	XMVECTOR maxX = XMVectorReplicate(-FLT_MAX), maxY = maxX, maxZ = maxX;
+	for (UINT i = first; i < last; i += 4)
+	{
+		XMVECTOR pointX, pointY, pointZ;
+		positions.Load4(i, pointX, pointY, pointZ);
+		minX = XMVectorMin(minX, pointX); minY = XMVectorMin(minY, pointY); minZ = XMVectorMin(minZ, pointZ);
+		maxX = XMVectorMax(maxX, pointX); maxY = XMVectorMax(maxY, pointY); maxZ = XMVectorMax(maxZ, pointZ);
+	}
+	return ReducePatchBounds(minX, minY, minZ, maxX, maxY, maxZ);
+}
+
+//Folds 4-wide per component minima/maxima into one box
+RockGenerator::PatchBounds RockGenerator::ReducePatchBounds(FXMVECTOR minX, FXMVECTOR minY, FXMVECTOR minZ, GXMVECTOR maxX, HXMVECTOR maxY, HXMVECTOR maxZ)
+{
+	XMFLOAT4 lanes[6];
+	XMStoreFloat4(&lanes[0], minX);
+	XMStoreFloat4(&lanes[1], minY);
+	XMStoreFloat4(&lanes[2], minZ);
+	XMStoreFloat4(&lanes[3], maxX);
+	XMStoreFloat4(&lanes[4], maxY);
+	XMStoreFloat4(&lanes[5], maxZ);
+
+	float reduced[6];
+	for (int component = 0; component < 6; component++)
+	{
+		const XMFLOAT4& lane = lanes[component];
+		reduced[component] = component < 3 ?
+			(std::min)((std::min)(lane.x, lane.y), (std::min)(lane.z, lane.w)) :
+			(std::max)((std::max)(lane.x, lane.y), (std::max)(lane.z, lane.w));
+	}
+
+	PatchBounds bounds;
+	bounds.min = XMFLOAT3(reduced[0], reduced[1], reduced[2]);
+	bounds.max = XMFLOAT3(reduced[3], reduced[4], reduced[5]);
+	return bounds;
+}
+
+RockGenerator::PatchBounds RockGenerator::MergePatchBounds(const std::vector<PatchBounds>& bounds, UINT first, UINT last)
+{
+	PatchBounds merged = bounds[first];
+	for (UINT patch = first + 1; patch < last; patch++)
+	{
+		merged.min.x = (std::min)(merged.min.x, bounds[patch].min.x);
+		merged.min.y = (std::min)(merged.min.y, bounds[patch].min.y);
+		merged.min.z = (std::min)(merged.min.z, bounds[patch].min.z);
+		merged.max.x = (std::max)(merged.max.x, bounds[patch].max.x);
+		merged.max.y = (std::max)(merged.max.y, bounds[patch].max.y);
+		merged.max.z = (std::max)(merged.max.z, bounds[patch].max.z);
+	}
+	return merged;
+}
+
+//Conservative: true only when every point of the box lies behind the plane
+bool RockGenerator::IsBehindPlane(const PatchBounds& bounds, const Plane& plane, float tolerance)
+{
+	if (bounds.min.x > bounds.max.x) // empty patch
+		return true;
+
+	XMFLOAT3 center, extents;
+	center.x = (bounds.min.x + bounds.max.x) * 0.5f - plane.origin.x;
+	center.y = (bounds.min.y + bounds.max.y) * 0.5f - plane.origin.y;
+	center.z = (bounds.min.z + bounds.max.z) * 0.5f - plane.origin.z;
+	extents.x = (bounds.max.x - bounds.min.x) * 0.5f;
+	extents.y = (bounds.max.y - bounds.min.y) * 0.5f;
+	extents.z = (bounds.max.z - bounds.min.z) * 0.5f;
+
+	float centerDist = center.x * plane.normal.x + center.y * plane.normal.y + center.z * plane.normal.z;
+	float radius = extents.x * fabsf(plane.normal.x) + extents.y * fabsf(plane.normal.y) + extents.z * fabsf(plane.normal.z);
+	return centerDist + radius < -tolerance;
+}
+
+//PUSH VERTICES OUTWARDS TO COUNTER OVERLAP
+//*******************************************************************************************************************************
+//All faces read the flattened positions and every vertex gathers the faces around it, so the
+//push no longer depends on triangle order and vertices can be handled on any thread
+void RockGenerator::Expand()
+{
+	const auto& triangles = m_Level->Mesh.second;
+	const auto& corners = m_Level->VertexCorners;
+	const auto& cornerOffsets = m_Level->VertexCornerOffsets;
+
+	Float3Stream& faceNormals = m_ScratchNormals;
+	faceNormals.resize(triangles.size());
+	RockBatch::ParallelFor((UINT)triangles.size(), m_NumThreads, [&](UINT first, UINT last)
+	{
+		for (UINT tri = first; tri < last; tri++)
+		{
+			XMVECTOR P0 = m_Positions.Load(triangles[tri].vertex[0]);
+			XMVECTOR P = m_Positions.Load(triangles[tri].vertex[1]) - P0;
+			XMVECTOR Q = m_Positions.Load(triangles[tri].vertex[2]) - P0;
+			faceNormals.Store(tri, XMVector3Normalize(XMVector3Cross(Q, P)));
+		}
+	});
+
+	//Push all vertices out by every face around them
+	float averageRadius = (m_Parameters.Width + m_Parameters.Height + m_Parameters.Depth) / 3.0f;
+	XMVECTOR pushScale = XMVectorReplicate(averageRadius / 100.f);
+	RockBatch::ParallelFor((UINT)cornerOffsets.size() - 1, m_NumThreads, [&](UINT first, UINT last)
+	{
+		for (UINT vertex = first; vertex < last; vertex++)
+		{
+			XMVECTOR push = XMVectorZero();
+			for (UINT c = cornerOffsets[vertex]; c < cornerOffsets[vertex + 1]; c++)
+				push += faceNormals.Load(corners[c] / 3);
+
+			m_Positions.Store(vertex, m_Positions.Load(vertex) + push * pushScale);
+		}
+	});
+}
+
+//FRACTAL NOISE DISPLACEMENT
+//*******************************************************************************************************************************
+//Four vertices per RockNoise::Fbm4 call. The noise is sampled at the vertex's unit sphere direction, so it does not
+//stretch with the size and the seam copies CorrectUV makes next match, and pushes along the radial direction: that
+//direction scaled by the size and normalized, BuildIco's starting normal. The current normals are no use, flattened
+//vertices carry their plane's normal, which would move whole facets rigidly instead of roughening them. BuildSurface
+//recomputes the normals afterwards.
+void RockGenerator::Displace()
+{
+	if (m_Parameters.NoiseOctaves == 0)
+		return;
+
+	RockNoiseOctaves octaves = RockNoise::MakeOctaves(m_Parameters.NoiseSeed, m_Parameters.NoiseOctaves, m_Parameters.NoiseFrequency,
+		m_Parameters.NoiseAmplitude, m_Parameters.NoiseLacunarity, m_Parameters.NoiseGain);
+	float averageRadius = (m_Parameters.Width + m_Parameters.Height + m_Parameters.Depth) / 3.0f;
+	XMVECTOR scale = XMVectorReplicate(averageRadius);
+	XMVECTOR size = XMVectorSet(m_Parameters.Width, m_Parameters.Height, m_Parameters.Depth, 0.0f);
+	const auto& directions = m_Level->Mesh.first;
+
+	//A block of four costs a few hundred nanoseconds, far more than an item of the other stages
+	RockBatch::ParallelFor((m_NumVertices + 3) / 4, m_NumThreads, [&](UINT first, UINT last)
+	{
+		for (UINT block = first; block < last; block++)
+		{
+			//The icosphere's directions are unit length already. The radial direction repeats BuildIco's normal
+			//step for step, so the push is the same bit for bit as the direction BuildIco stored
+			XMFLOAT4 lx(0, 0, 0, 0), ly(0, 0, 0, 0), lz(0, 0, 0, 0);
+			XMFLOAT4 radialX(0, 0, 0, 0), radialY(0, 0, 0, 0), radialZ(0, 0, 0, 0);
+			for (UINT lane = 0; lane < 4 && block * 4 + lane < m_NumVertices; lane++)
+			{
+				const XMFLOAT3& direction = directions[block * 4 + lane];
+				(&lx.x)[lane] = direction.x;
+				(&ly.x)[lane] = direction.y;
+				(&lz.x)[lane] = direction.z;
+
+				XMFLOAT3 radial;
+				XMVECTOR scaled = XMVectorMultiply(XMVector3Normalize(XMVector3Normalize(XMLoadFloat3(&direction))), size);
+				XMStoreFloat3(&radial, XMVector3Normalize(XMVector3Normalize(scaled)));
+				(&radialX.x)[lane] = radial.x;
+				(&radialY.x)[lane] = radial.y;
+				(&radialZ.x)[lane] = radial.z;
+			}
+
+			XMVECTOR rx = XMLoadFloat4(&radialX), ry = XMLoadFloat4(&radialY), rz = XMLoadFloat4(&radialZ);
+			XMVECTOR px, py, pz;
+			m_Positions.Load4(block * 4, px, py, pz);
+			XMVECTOR offset = XMVectorMultiply(RockNoise::Fbm4(XMLoadFloat4(&lx), XMLoadFloat4(&ly), XMLoadFloat4(&lz), octaves), scale);
+			m_Positions.Store4(block * 4, XMVectorMultiplyAdd(rx, offset, px), XMVectorMultiplyAdd(ry, offset, py), XMVectorMultiplyAdd(rz, offset, pz));
+		}
+	}, 64);
+}
+
+//CORRECT UV SEAMS
+//*******************************************************************************************************************************
+//The splits are planned once per level by IcosphereCache; this only appends the copies and rewrites their corners
+void RockGenerator::CorrectUV()
+{
+	const auto& splits = m_Level->SeamSplits;
+	UINT numBaseVertices = m_NumVertices;
+
+	m_Positions.resize(numBaseVertices + splits.size());
+	m_Normals.resize(numBaseVertices + splits.size());
+	m_Tangents.resize(numBaseVertices + splits.size());
+	m_TexCoords.resize(numBaseVertices + splits.size());
+
+	for (UINT i = 0; i < splits.size(); i++)
+	{
+		const SeamSplit& split = splits[i];
+		UINT vertex = numBaseVertices + i;
+
+		m_Positions.Store(vertex, m_Positions.Load(split.Source));
+		m_Normals.Store(vertex, m_Normals.Load(split.Source));
+		m_Tangents.Store(vertex, m_Tangents.Load(split.Source));
+
+		float texCoordX = split.MidpointA == SeamSplit::NO_INDEX ?
+			m_TexCoords[split.Source].x + 1.0f :
+			(m_TexCoords[split.MidpointA].x + m_TexCoords[split.MidpointB].x) / 2.0f;
+		m_TexCoords[vertex] = XMFLOAT2(texCoordX, m_TexCoords[split.Source].y);
+
+		if (split.Corner != SeamSplit::NO_INDEX)
+			m_VecIndices[split.Corner] = vertex;
+	}
+
+	m_NumVertices = m_Positions.size();
+	m_NumIndices = m_VecIndices.size();
+}
+
+//NORMALS AND TANGENTS
+//*******************************************************************************************************************************
+//Every face computes its edges once for both its normal and its tangent, then every vertex gathers
+//the faces around it in triangle order. Nothing is scattered, so both passes run on any number of
+//threads and give the same result as accumulating triangle by triangle.
+void RockGenerator::BuildSurface()
+{
+	const auto& triangles = m_Level->Mesh.second;
+	const auto& corners = m_Level->VertexCorners;
+	const auto& cornerOffsets = m_Level->VertexCornerOffsets;
+	UINT numBaseVertices = (UINT)m_Level->Mesh.first.size();
+
+	//PER FACE --------------------------------------------
+	Float3Stream& faceNormals = m_ScratchNormals;
+	Float3Stream& faceTangents = m_ScratchTangents;
+	faceNormals.resize(triangles.size());
+	faceTangents.resize(triangles.size());
+	RockBatch::ParallelFor((UINT)triangles.size(), m_NumThreads, [&](UINT first, UINT last)
+	{
+		for (UINT tri = first; tri < last; tri++)
+		{
+			//Positions come from the welded vertices, texture coordinates from the (possibly seam split) ones in the
+			//index buffer; a split copies the corner it replaces, so both describe the same triangle
+			UINT base0 = triangles[tri].vertex[0], base1 = triangles[tri].vertex[1], base2 = triangles[tri].vertex[2];
+			UINT idx0 = m_VecIndices[tri * 3], idx1 = m_VecIndices[tri * 3 + 1], idx2 = m_VecIndices[tri * 3 + 2];
+
+			XMVECTOR P0 = m_Positions.Load(base0);
+			XMVECTOR P = m_Positions.Load(base1) - P0;
+			XMVECTOR Q = m_Positions.Load(base2) - P0;
+			faceNormals.Store(tri, XMVector3Normalize(XMVector3Cross(Q, P)));
+
+			//Tangent, same solve as ComputeTangent
+			const XMFLOAT2& UV0 = m_TexCoords[idx0];
+			float s1 = m_TexCoords[idx1].x - UV0.x;
+			float t1 = m_TexCoords[idx1].y - UV0.y;
+			float s2 = m_TexCoords[idx2].x - UV0.x;
+			float t2 = m_TexCoords[idx2].y - UV0.y;
+
+			float determinant = s1*t2 - s2*t1;
+			float tmp = fabsf(determinant) <= 0.0001f ? 1.0f : 1.0f / determinant;
+			faceTangents.Store(tri, XMVector3Normalize((P * t2 - Q * t1) * tmp));
+		}
+	});
+
+	//PER VERTEX --------------------------------------------
+	//A corner still counts towards the tangent of its welded vertex unless CorrectUV moved it to a copy
+	RockBatch::ParallelFor(numBaseVertices, m_NumThreads, [&](UINT first, UINT last)
+	{
+		for (UINT vertex = first; vertex < last; vertex++)
+		{
+			XMVECTOR normal = m_Normals.Load(vertex);
+			XMVECTOR tangent = m_Tangents.Load(vertex);
+			for (UINT c = cornerOffsets[vertex]; c < cornerOffsets[vertex + 1]; c++)
+			{
+				UINT corner = corners[c];
+				normal += faceNormals.Load(corner / 3);
+				if (m_VecIndices[corner] == vertex)
+					tangent += faceTangents.Load(corner / 3);
+			}
+			m_Normals.Store(vertex, normal);
+			m_Tangents.Store(vertex, tangent);
+		}
+	});
+
+	//Seam split vertices own at most one corner; copies a later split took over own none
+	const auto& splits = m_Level->SeamSplits;
+	for (UINT i = 0; i < splits.size(); i++)
+	{
+		UINT vertex = numBaseVertices + i;
+		m_Normals.Store(vertex, m_Normals.Load(splits[i].Source));
+		if (splits[i].Corner != SeamSplit::NO_INDEX)
+			m_Tangents.Store(vertex, m_Tangents.Load(vertex) + faceTangents.Load(splits[i].Corner / 3));
+	}
+
+	NormalizeStream(m_Normals);
+	NormalizeStream(m_Tangents);
+}
+
+//OPTIMIZE DRAW ORDER
+//*******************************************************************************************************************************
+//Triangle and vertex order are planned once per level by IcosphereCache, this only gathers the streams into that order
+void RockGenerator::OptimizeDrawOrder()
+{
+	const auto& drawVertices = m_Level->DrawVertices;
+	UINT numVertices = (UINT)drawVertices.size();
+
+	//Gathered into the scratch streams, which then swap with the working ones
+	Float3Stream& positions = m_ScratchPositions;
+	Float3Stream& normals = m_ScratchNormals;
+	Float3Stream& tangents = m_ScratchTangents;
+	std::vector<XMFLOAT2>& texCoords = m_ScratchTexCoords;
+	texCoords.resize(numVertices);
+	positions.resize(numVertices);
+	normals.resize(numVertices);
+	tangents.resize(numVertices);
+	for (UINT i = 0; i < numVertices; i++)
+	{
+		UINT vertex = drawVertices[i];
+		positions.Set(i, m_Positions.Get(vertex));
+		normals.Set(i, m_Normals.Get(vertex));
+		tangents.Set(i, m_Tangents.Get(vertex));
+		texCoords[i] = m_TexCoords[vertex];
+	}
+
+	std::swap(m_Positions, positions);
+	std::swap(m_Normals, normals);
+	std::swap(m_Tangents, tangents);
+	std::swap(m_TexCoords, texCoords);
+	m_VecIndices = m_Level->DrawIndices;
+	m_NumVertices = numVertices;
+	m_NumIndices = m_VecIndices.size();
+}
+
+//LOD ERROR
+//*******************************************************************************************************************************
+//Largest distance of a finest LOD vertex to the plane of the current (coarser) triangle it lies under.
+//Both levels come from the same subdivision, so fine triangle t descends from coarse triangle t / 4^k.
+float RockGenerator::MeasureLodError(const Float3Stream& finePositions, const IcosphereLevel& fineLevel, const Float3Stream& coarsePositions, const IcosphereLevel& coarseLevel)
+{
+	const auto& fineTriangles = fineLevel.Mesh.second;
+	const auto& coarseTriangles = coarseLevel.Mesh.second;
+	UINT descendants = (UINT)(fineTriangles.size() / coarseTriangles.size());
+
+	float maxError = 0.0f;
+	for (UINT coarse = 0; coarse < coarseTriangles.size(); coarse++)
+	{
+		XMVECTOR P0 = coarsePositions.Load(coarseTriangles[coarse].vertex[0]);
+		XMVECTOR P1 = coarsePositions.Load(coarseTriangles[coarse].vertex[1]);
+		XMVECTOR P2 = coarsePositions.Load(coarseTriangles[coarse].vertex[2]);
+		XMVECTOR normal = XMVector3Normalize(XMVector3Cross(P1 - P0, P2 - P0));
+
+		for (UINT fine = coarse * descendants; fine < (coarse + 1) * descendants; fine++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				XMVECTOR point = finePositions.Load(fineTriangles[fine].vertex[corner]);
+				float error = fabsf(XMVectorGetX(XMVector3Dot(point - P0, normal)));
+				maxError = (std::max)(maxError, error);
+			}
+		}
+	}
+	return maxError;
+}
+
+//INTERLEAVE STREAMS INTO VERTEXROCK
+//*******************************************************************************************************************************
+void RockGenerator::Interleave(std::vector<VertexRock>& vertices) const
+{
+	vertices.resize(m_NumVertices);
+	for (UINT i = 0; i < m_NumVertices; i++)
+	{
+		vertices[i].Position = m_Positions.Get(i);
+		vertices[i].Normal = m_Normals.Get(i);
+		vertices[i].Tangent = m_Tangents.Get(i);
+		vertices[i].TexCoord = m_TexCoords[i];
+	}
+}
@@ -0,0 +1,222 @@
+#pragma once
+#include "VertexStructs.h"
+#include "RockHeader.h"
+#include "IcosphereCache.h"
+#include "ProgressiveMesh.h"
+#include "RockProfiler.h"
+#include <map>
+
+//One bit per RockParameters field, see RockParameters::GetChanges and RockGenerator::GetStageParameters
+enum class RockParameter
+{
+	Width,
+	Height,
+	Depth,
+	Steps,
+	MinRandAngle,
+	MaxRandAngle,
+	MaxOffsetPercent,
+	MaxRandShift,
+	MinPlaneVerts,
+	MaxPlaneVerts,
+	MaxPlanes,
+	Seed,
+	NoiseOctaves,
+	NoiseFrequency,
+	NoiseAmplitude,
+	NoiseLacunarity,
+	NoiseGain,
+	NoiseSeed,
+	Count
+};
+
+//Everything that shapes a rock mesh; shader settings are not part of this
+struct RockParameters
+{
+	float Width = 1.0f;
+	float Height = 1.0f;
+	float Depth = 1.0f;
+	UINT Steps = 0;
+
+	float MinRandAngle = 0.0f;
+	float MaxRandAngle = 360.0f;
+	float MaxOffsetPercent = 10.0f;
+	float MaxRandShift = 0.0f;
+
+	UINT MinPlaneVerts = 0;
+	UINT MaxPlaneVerts = 0;
+	UINT MaxPlanes = 0;
+
+	//Drives every random choice in BuildRock; equal seeds rebuild identical rocks
+	UINT Seed = 0;
+
+	//fBm displacement along the radial direction after Expand, 0 octaves turns it off. Frequency is per unit of
+	//direction, amplitude a fraction of the average radius; every octave multiplies them by lacunarity and gain.
+	//At most RockNoiseOctaves::MAX_OCTAVES (8) octaves are summed, higher counts build the same rock as 8.
+	UINT NoiseOctaves = 0;
+	float NoiseFrequency = 2.0f;
+	float NoiseAmplitude = 0.05f;
+	float NoiseLacunarity = 2.0f;
+	float NoiseGain = 0.5f;
+	UINT NoiseSeed = 0;
+
+	static UINT GetBit(RockParameter parameter) { return 1u << UINT(parameter); }
+	//Bits of the fields that differ from other, 0 when both build the same rock
+	UINT GetChanges(const RockParameters& other) const;
+};
+
+struct RockMesh
+{
+	std::vector<VertexRock> Vertices;
+	std::vector<DWORD> Indices;
+};
+
+//One level of detail. GeometricError is the largest distance, in object units, between the finest
+//LOD's surface and this one; 0 for the finest.
+struct RockLod
+{
+	RockMesh Mesh;
+	UINT Steps = 0;
+	float GeometricError = 0.0f;
+};
+
+//Engine independent rock pipeline:
+//BuildIco -> BuildRock -> Expand -> Displace -> CorrectUV -> BuildSurface (normals + tangents) -> OptimizeDrawOrder
+class RockGenerator
+{
+public:
+	//numThreads splits Expand and BuildSurface inside this one rock; the output does not depend on it
+	RockGenerator(const RockParameters& parameters, UINT numThreads = 1);
+	~RockGenerator(void) {}
+
+	struct Plane
+	{
+		XMFLOAT3 origin;
+		XMFLOAT3 normal;
+		float diameter;
+	};
+
+	RockMesh Generate();
+	//Fills mesh in place: a generator and mesh that already built a rock of this size do not allocate
+	void Generate(RockMesh& mesh);
+
+	//LOD i is built with Steps - i subdivisions and the same planes, down to at most Steps 0
+	std::vector<RockLod> GenerateLods(UINT lodCount);
+	void GenerateLods(UINT lodCount, std::vector<RockLod>& lods);
+
+	//Error of a LOD seen at distance, as a fraction of the viewport height.
+	//projectionScaleY is the y scale of the projection matrix, 1 / tan(fovY / 2).
+	static float ProjectScreenError(float geometricError, float distance, float projectionScaleY);
+	//Coarsest LOD whose projected error stays within maxScreenError
+	static UINT SelectLod(const std::vector<RockLod>& lods, float distance, float projectionScaleY, float maxScreenError);
+
+	//The finest mesh as a base mesh plus vertex splits, for any triangle count between the two
+	ProgressiveMesh GenerateProgressive();
+
+	const RockParameters& GetParameters() const { return m_Parameters; }
+	void SetParameters(const RockParameters& parameters) { m_Parameters = parameters; }
+
+	//Keeps the output of the stages between calls, so after SetParameters the next Generate or GenerateLods
+	//only reruns the stages that read a changed parameter and the ones after them. Costs a copy of the scaled
+	//sphere and of the finished mesh per step count built by the last call.
+	void SetStageReuse(bool reuse);
+	//Parameters a stage reads itself, as RockParameters::GetBit bits. Rock also takes the planes as input.
+	static UINT GetStageParameters(RockStage stage);
+	const std::vector<Plane>& GetPlanes() const { return m_Planes; }
+
+	//Vertex cache behaviour of the index buffer before and after OptimizeDrawOrder, valid after Generate
+	const VertexCacheReport& GetVertexCacheReport() const { return m_Level->DrawReport; }
+	//One event per stage of the last Generate or GenerateLods call
+	const RockProfiler& GetProfiler() const { return m_Profiler; }
+
+private:
+	//Output of the stages for one step count, see SetStageReuse
+	struct StageCache
+	{
+		//What everything below was last built with
+		RockParameters Parameters;
+		IcosphereCache::IcosphereRef Level;
+
+		//After BuildIco; tangents start out equal to the normals
+		Float3Stream IcoPositions, IcoNormals;
+		std::vector<XMFLOAT2> IcoTexCoords;
+		std::vector<DWORD> IcoIndices;
+
+		//After BuildShape (positions for the LOD error) and BuildMesh
+		bool HasMesh = false;
+		Float3Stream ShapePositions;
+		RockMesh Mesh;
+	};
+
+	void UpdatePlanes();
+	//Shape and mesh of the current Steps. pShape receives the positions before OptimizeDrawOrder, pFinestShape and
+	//pFinestLevel give the finest LOD to measure the error against (nullptr for the finest itself).
+	void BuildLevel(RockLod& lod, Float3Stream* pShape, const Float3Stream* pFinestShape, const IcosphereLevel* pFinestLevel);
+	//RockStage::Count when nothing the cached level depends on changed
+	RockStage GetFirstDirtyStage(const StageCache& cache) const;
+	void TrimStageCache(UINT minSteps, UINT maxSteps);
+
+	void BuildShape(StageCache* pCache);
+	void BuildMesh(RockMesh& mesh);
+
+	void BuildIco();
+
+	void CorrectUV();
+
+	struct PatchBounds
+	{
+		XMFLOAT3 min;
+		XMFLOAT3 max;
+	};
+
+	void BuildPlanes();
+	Plane BuildPlane(UINT index) const;
+	void BuildRock();
+	static PatchBounds ComputePatchBounds(const Float3Stream& positions, UINT first, UINT last);
+	static PatchBounds ReducePatchBounds(FXMVECTOR minX, FXMVECTOR minY, FXMVECTOR minZ, GXMVECTOR maxX, HXMVECTOR maxY, HXMVECTOR maxZ);
+	static PatchBounds MergePatchBounds(const std::vector<PatchBounds>& bounds, UINT first, UINT last);
+	static bool IsBehindPlane(const PatchBounds& bounds, const Plane& plane, float tolerance);
+	void Expand();
+	void Displace();
+	void BuildSurface();
+	void OptimizeDrawOrder();
+	static float MeasureLodError(const Float3Stream& finePositions, const IcosphereLevel& fineLevel, const Float3Stream& coarsePositions, const IcosphereLevel& coarseLevel);
+	//Runs one stage under the profiler, with the vertex and index counts before and after it
+	void RunStage(RockStage stage, void (RockGenerator::*build)());
+
+	void Interleave(std::vector<VertexRock>& vertices) const;
+
+	RockParameters m_Parameters;
+	UINT m_NumThreads;
+	IcosphereCache::IcosphereRef m_Level;
+	std::vector<Plane> m_Planes;
+
+	//Working layout is one stream per attribute, interleaved into VertexRock only at the end
+	Float3Stream m_Positions, m_Normals, m_Tangents;
+	std::vector<XMFLOAT2> m_TexCoords;
+	std::vector<DWORD> m_VecIndices;
+	UINT m_NumVertices, m_NumIndices;
+
+	//Scratch buffers of the stages. They keep their capacity between calls, so a generator that built a rock
+	//of a given step count before builds the next one without touching the heap.
+	Float3Stream m_ScratchPositions, m_ScratchNormals, m_ScratchTangents;
+	std::vector<XMFLOAT2> m_ScratchTexCoords;
+	std::vector<PatchBounds> m_PatchBounds, m_FaceBounds;
+	Float3Stream m_FinestPositions;
+
+	RockProfiler m_Profiler;
+
+	bool m_ReuseStages = false;
+	std::map<UINT, StageCache> m_StageCache;
+	bool m_HasPlanes = false;
+	RockParameters m_PlanesParameters;
+
+private:
+
+	// -------------------------
+	// Disabling default copy constructor and default 
+	// assignment operator.
+	// -------------------------
+	RockGenerator(const RockGenerator& yRef);
+	RockGenerator& operator=(const RockGenerator& yRef);
+};
@@ -9,9 +9,49 @@ struct Triangle
 
 using TriangleList = std::vector<Triangle>;
 using VertexList = std::vector<XMFLOAT3>;
-using Lookup = std::map<std::pair<UINT, UINT>, UINT>;
 using IndexedMesh = std::pair<VertexList, TriangleList>;
 
+//Flat open-addressed edge -> midpoint table, sized once per subdivision level
+struct Lookup
+{
+	explicit Lookup(size_t edgeCount)
+	{
+		//Keep the load factor at or below 0.5 so probe chains stay short
+		size_t capacity = 16;
+		while (capacity < edgeCount * 2)
+			capacity <<= 1;
+
+		m_Keys.assign(capacity, UINT64(EMPTY_KEY));
+		m_Values.resize(capacity);
+		m_Mask = capacity - 1;
+	}
+
+	//Returns the stored value and whether the edge was newly inserted
+	std::pair<UINT, bool> Insert(UINT first, UINT second, UINT value)
+	{
+		UINT64 key = (static_cast<UINT64>(first) << 32) | second;
+		size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & m_Mask;
+
+		while (m_Keys[slot] != EMPTY_KEY)
+		{
+			if (m_Keys[slot] == key)
+				return{ m_Values[slot], false };
+			slot = (slot + 1) & m_Mask;
+		}
+
+		m_Keys[slot] = key;
+		m_Values[slot] = value;
+		return{ value, true };
+	}
+
+private:
+	static const UINT64 EMPTY_KEY = ~0ull;
+
+	std::vector<UINT64> m_Keys;
+	std::vector<UINT> m_Values;
+	size_t m_Mask;
+};
+
 namespace icosahedron
 {
 	const float X = .525731112119133606f;
@@ -25,13 +65,22 @@ namespace icosahedron
 		{ Z,X,N },{ -Z,X, N },{ Z,-X,N },{ -Z,-X, N }
 	};
 
-	static const TriangleList triangles =
+	//constexpr so IcosphereTables can subdivide it at compile time
+	constexpr UINT indices[20][3] =
 	{
 		{ 0,4,1 },{ 0,9,4 },{ 9,5,4 },{ 4,5,8 },{ 4,8,1 },
 		{ 8,10,1 },{ 8,3,10 },{ 5,3,8 },{ 5,2,3 },{ 2,7,3 },
 		{ 7,10,3 },{ 7,6,10 },{ 7,11,6 },{ 11,0,6 },{ 0,1,6 },
 		{ 6,1,10 },{ 9,0,11 },{ 9,11,2 },{ 9,2,5 },{ 7,2,11 }
 	};
+
+	static const TriangleList triangles = []()
+	{
+		TriangleList list;
+		for (const auto& triangle : indices)
+			list.push_back({ triangle[0], triangle[1], triangle[2] });
+		return list;
+	}();
 }
 
 struct VertexRock
@@ -56,6 +105,100 @@ struct VertexRock
 	XMFLOAT2 TexCoord;
 };
 
+//20 byte alternative to the 44 byte VertexRock, see RockPacking for encoding and decoding.
+//Position and TexCoord are UNORM relative to the mesh bounds (Position[3] is always 1.0 so the
+//input assembler hands the shader w = 1), Normal and Tangent are octahedral SNORM pairs.
+struct VertexRockPacked
+{
+	WORD Position[4];
+	SHORT Normal[2];
+	SHORT Tangent[2];
+	WORD TexCoord[2];
+};
+
+//Component-split float3 stream: x, y and z live in their own arrays so
+//per-vertex loops can process four vertices per XMVECTOR
+struct Float3Stream
+{
+	std::vector<float> x, y, z;
+
+	size_t size() const { return x.size(); }
+	void clear() { x.clear(); y.clear(); z.clear(); }
+	void reserve(size_t count) { x.reserve(count); y.reserve(count); z.reserve(count); }
+	void resize(size_t count) { x.resize(count); y.resize(count); z.resize(count); }
+	void push_back(const XMFLOAT3& value) { x.push_back(value.x); y.push_back(value.y); z.push_back(value.z); }
+
+	XMFLOAT3 Get(size_t i) const { return XMFLOAT3(x[i], y[i], z[i]); }
+	void Set(size_t i, const XMFLOAT3& value) { x[i] = value.x; y[i] = value.y; z[i] = value.z; }
+
+	XMVECTOR Load(size_t i) const { return XMVectorSet(x[i], y[i], z[i], 0.0f); }
+	void Store(size_t i, FXMVECTOR value) { x[i] = XMVectorGetX(value); y[i] = XMVectorGetY(value); z[i] = XMVectorGetZ(value); }
+
+	//Vertices [i, i+4) with one component per vector, lanes past the end read as 0
+	void Load4(size_t i, XMVECTOR& vx, XMVECTOR& vy, XMVECTOR& vz) const
+	{
+		if (i + 4 <= size())
+		{
+			vx = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&x[i]));
+			vy = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&y[i]));
+			vz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&z[i]));
+			return;
+		}
+
+		XMFLOAT4 lx(0, 0, 0, 0), ly(0, 0, 0, 0), lz(0, 0, 0, 0);
+		for (size_t lane = 0; i + lane < size(); lane++)
+		{
+			(&lx.x)[lane] = x[i + lane];
+			(&ly.x)[lane] = y[i + lane];
+			(&lz.x)[lane] = z[i + lane];
+		}
+		vx = XMLoadFloat4(&lx);
+		vy = XMLoadFloat4(&ly);
+		vz = XMLoadFloat4(&lz);
+	}
+
+	void Store4(size_t i, FXMVECTOR vx, FXMVECTOR vy, FXMVECTOR vz)
+	{
+		if (i + 4 <= size())
+		{
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&x[i]), vx);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&y[i]), vy);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&z[i]), vz);
+			return;
+		}
+
+		XMFLOAT4 lx, ly, lz;
+		XMStoreFloat4(&lx, vx);
+		XMStoreFloat4(&ly, vy);
+		XMStoreFloat4(&lz, vz);
+		for (size_t lane = 0; i + lane < size(); lane++)
+		{
+			x[i + lane] = (&lx.x)[lane];
+			y[i + lane] = (&ly.x)[lane];
+			z[i + lane] = (&lz.x)[lane];
+		}
+	}
+};
+
+//Normalizes every entry of a stream four at a time, zero length stays zero like XMVector3Normalize
+const auto NormalizeStream = [](Float3Stream& stream)
+{
+	XMVECTOR zero = XMVectorZero();
+	for (size_t i = 0; i < stream.size(); i += 4)
+	{
+		XMVECTOR vx, vy, vz;
+		stream.Load4(i, vx, vy, vz);
+
+		XMVECTOR length = XMVectorSqrt(vx * vx + vy * vy + vz * vz);
+		XMVECTOR valid = XMVectorGreater(length, zero);
+		vx = XMVectorSelect(zero, vx / length, valid);
+		vy = XMVectorSelect(zero, vy / length, valid);
+		vz = XMVectorSelect(zero, vz / length, valid);
+
+		stream.Store4(i, vx, vy, vz);
+	}
+};
+
 const auto UVFromVector3 = [](const XMFLOAT3 position)
 {
 	XMFLOAT3 normalizedPos;
@@ -96,16 +239,16 @@ const auto CrossProduct = [](const XMFLOAT3 v1, const XMFLOAT3 v2)
 	return crossResult;
 };
 
-const auto WeldVertices = [](std::vector<VertexRock> points)
+const auto WeldVertices = [](const std::vector<VertexRock>& points)
 {
 	VertexRock weldedPoint;
 
-	XMVECTOR pos = XMLoadFloat3(&XMFLOAT3(0, 0, 0)), 
-		norm = XMLoadFloat3(&XMFLOAT3(0, 0, 0)), 
-		tex = XMLoadFloat3(&XMFLOAT3(0, 0, 0)), 
-		tang = XMLoadFloat3(&XMFLOAT3(0, 0, 0));
+	XMVECTOR pos = XMVectorZero(), 
+		norm = XMVectorZero(), 
+		tex = XMVectorZero(), 
+		tang = XMVectorZero();
 	UINT size = points.size();
-	for each (auto point in points)
+	for (const auto& point : points)
 	{
 		pos += XMLoadFloat3(&point.Position);
 		norm += XMLoadFloat3(&point.Normal);
@@ -113,10 +256,10 @@ const auto WeldVertices = [](std::vector<VertexRock> points)
 		tang += XMLoadFloat3(&point.Tangent);
 	}
 
-	pos = pos / size;
-	norm = norm / size;
-	tex = tex / size;
-	tang = tang / size;
+	pos = pos / (float)size;
+	norm = norm / (float)size;
+	tex = tex / (float)size;
+	tang = tang / (float)size;
 
 	XMStoreFloat3(&weldedPoint.Position, pos);
 	XMStoreFloat3(&weldedPoint.Normal, norm);
@@ -126,22 +269,22 @@ const auto WeldVertices = [](std::vector<VertexRock> points)
 	return weldedPoint;
 };
 
-const auto WeldVerticesProto = [](std::vector<VertexPosNormTex> points)
+const auto WeldVerticesProto = [](const std::vector<VertexPosNormTex>& points)
 {
 	VertexPosNormTex weldedPoint;
 
-	XMVECTOR pos, norm, tex;
+	XMVECTOR pos = XMVectorZero(), norm = XMVectorZero(), tex = XMVectorZero();
 	UINT size = points.size();
-	for each (auto point in points)
+	for (const auto& point : points)
 	{
 		pos += XMLoadFloat3(&point.Position);
 		norm += XMLoadFloat3(&point.Normal);
 		tex += XMLoadFloat2(&point.TexCoord);
 	}
 
-	pos = pos / size;
-	norm = norm / size;
-	tex = tex / size;
+	pos = pos / (float)size;
+	norm = norm / (float)size;
+	tex = tex / (float)size;
 
 	XMStoreFloat3(&weldedPoint.Position, pos);
 	XMStoreFloat3(&weldedPoint.Normal, norm);
@@ -151,28 +294,32 @@ const auto WeldVerticesProto = [](std::vector<VertexPosNormTex> points)
 
 const auto VertexForEdge = [](Lookup& lookup, VertexList& vertices, UINT first, UINT second)
 {
-	Lookup::key_type key(first, second);
-	if (key.first>key.second)
-		std::swap(key.first, key.second);
+	if (first > second)
+		std::swap(first, second);
 
-	auto inserted = lookup.insert({ key, vertices.size() });
+	auto inserted = lookup.Insert(first, second, (UINT)vertices.size());
 	if (inserted.second)
 	{
-		auto& edge0 = XMLoadFloat3(&vertices[first]);
-		auto& edge1 = XMLoadFloat3(&vertices[second]);
+		auto edge0 = XMLoadFloat3(&vertices[first]);
+		auto edge1 = XMLoadFloat3(&vertices[second]);
 		auto point = edge0 + edge1;
 		XMFLOAT3 newVert;
 		XMStoreFloat3(&newVert, XMVector3Normalize(point));
 		vertices.push_back(newVert);
 	}
 
-	return inserted.first->second;
+	return inserted.first;
 };
 
-const auto SubdivideTriangle = [](VertexList& vertices, TriangleList triangles)
+//Writes the 4 children of every triangle to result, which must not alias triangles
+const auto SubdivideTriangle = [](VertexList& vertices, const TriangleList& triangles, TriangleList& result)
 {
-	Lookup lookup;
-	TriangleList result;
+	//Closed mesh: every edge is shared by two triangles
+	size_t edgeCount = triangles.size() * 3 / 2;
+	Lookup lookup(edgeCount);
+	result.clear();
+	result.reserve(triangles.size() * 4);
+	vertices.reserve(vertices.size() + edgeCount);
 
 	for (auto&& each : triangles)
 	{
@@ -186,8 +333,6 @@ const auto SubdivideTriangle = [](VertexList& vertices, TriangleList triangles)
 		result.push_back({ each.vertex[2], mid[2], mid[1] });
 		result.push_back({ mid[0], mid[1], mid[2] });
 	}
-
-	return result;
 };
 
 const auto MakeIcosphere = [](int subdivisions)
@@ -195,17 +340,26 @@ const auto MakeIcosphere = [](int subdivisions)
 	VertexList vertices = icosahedron::vertices;
 	TriangleList triangles = icosahedron::triangles;
 
+	//Final counts are known up front: 10*4^n+2 vertices, 20*4^n triangles
+	size_t levelSize = (size_t)1 << (2 * subdivisions);
+	vertices.reserve(10 * levelSize + 2);
+	triangles.reserve(20 * levelSize);
+
+	//Both lists are sized for the final level once and swap roles every level
+	TriangleList next;
+	next.reserve(20 * levelSize);
 	for (int i = 0; i<subdivisions; ++i)
 	{
-		triangles = SubdivideTriangle(vertices, triangles);
+		SubdivideTriangle(vertices, triangles, next);
+		triangles.swap(next);
 	}
 
-	IndexedMesh result{ vertices, triangles };
+	IndexedMesh result{ std::move(vertices), std::move(triangles) };
 
 	return result;
 };
 
-const auto CalculateTangent = [](const XMFLOAT3& P1, const XMFLOAT3& P2, const XMFLOAT3& P3, const XMFLOAT2& UV1, const XMFLOAT2& UV2, const XMFLOAT2& UV3)
+const auto CalculateTangent = [](const XMFLOAT3& P1, const XMFLOAT3& P2, const XMFLOAT3& P3, const XMFLOAT2& /*UV1*/, const XMFLOAT2& /*UV2*/, const XMFLOAT2& /*UV3*/)
 {
 	XMFLOAT3 tangent;
 	XMFLOAT3 normal;
@@ -219,7 +373,7 @@ const auto CalculateTangent = [](const XMFLOAT3& P1, const XMFLOAT3& P2, const X
 	normalV = XMVector3Normalize(XMVector3Cross(XMLoadFloat3(&v2v1), XMLoadFloat3(&v3v1)));
 	XMStoreFloat3(&normal, normalV);
 
-	tangentV = XMVector3Normalize(XMVector3Cross(normalV, XMLoadFloat3(&XMFLOAT3(0,1,0))));
+	tangentV = XMVector3Normalize(XMVector3Cross(normalV, XMVectorSet(0, 1, 0, 0)));
 	tangentV = XMVector3Normalize(tangentV);
 	XMStoreFloat3(&tangent, tangentV);
 
@@ -417,16 +571,15 @@ const auto MinLengthTriangleLine = [](const XMFLOAT3& v0, const XMFLOAT3& v1, co
 	return distance;
 };
 
-const auto AverageXmfloat3 = [](std::vector<XMFLOAT3> points)
+const auto AverageXmfloat3 = [](const XMFLOAT3* points, UINT size)
 {
 	XMFLOAT3 average;
-	XMVECTOR pos;
-	UINT size = points.size();
-	for each (auto point in points)
+	XMVECTOR pos = XMVectorZero();
+	for (UINT i = 0; i < size; i++)
 	{
-		pos += XMLoadFloat3(&point);
+		pos += XMLoadFloat3(&points[i]);
 	}
-	pos = pos / size;
+	pos = pos / (float)size;
 
 	XMStoreFloat3(&average, pos);
 	return average;
@@ -439,7 +592,7 @@ const auto CheckUVForDistance = [](std::vector<VertexRock*> points)
 	UINT size = points.size();
 	UVlist.resize(size);
 
-	for each (auto point in points)
+	for (auto point : points)
 	{
 		auto uv = point->TexCoord;
 		while (uv.x > 0.99)
@@ -471,7 +624,7 @@ const auto SameSide = [](const XMFLOAT3 p1, const XMFLOAT3 p2, const XMFLOAT3 A,
 	XMVECTOR vecB = XMLoadFloat3(&B);
 
 	XMVECTOR cp1 = XMVector3Cross((vecA - vecB), (vecA - vecP1));
-	XMVECTOR cp2 = XMVector3Cross((vecA - vecB), (vecA - vecP1));
+	XMVECTOR cp2 = XMVector3Cross((vecA - vecB), (vecA - vecP2));
 
 	auto d = XMVector3Dot(cp1, cp2);
 	float dot;
@@ -506,7 +659,8 @@ const auto PointInTriangle = [](const XMFLOAT3 TriangleVectors [3], const XMFLOA
 const auto LinePlaneIntersection = [](const XMFLOAT3 triangle[3], const XMFLOAT3 triangleNormal, const XMFLOAT3 rayStart, const XMFLOAT3 rayEnd)
 {
 	auto triangleN = XMLoadFloat3(&triangleNormal);
-	auto pointOnPlane = XMLoadFloat3(&AverageXmfloat3({ triangle[0] ,triangle[1] ,triangle[2] }));
+	XMFLOAT3 average = AverageXmfloat3(triangle, 3);
+	auto pointOnPlane = XMLoadFloat3(&average);
 	auto rayOrigin = XMLoadFloat3(&rayStart);
 	auto rayDirection = XMLoadFloat3(&rayEnd) - rayOrigin;
 
@@ -0,0 +1,168 @@
+#include "stdafx.h"
+#include "RockInstancing.h"
+#include <algorithm>
+#include <cmath>
+
+RockInstanceRenderer::RockInstanceRenderer(RockRenderDevice* pDevice) :
+	m_pDevice(pDevice)
+{
+	for (auto& plane : m_FrustumPlanes)
+		plane = XMFLOAT4(0, 0, 0, 1);
+}
+
+//FRAME
+//*******************************************************************************************************************************
+void RockInstanceRenderer::Begin(const XMFLOAT4X4& viewProjection)
+{
+	m_Instances.clear();
+	m_Stats = RockDrawStats();
+
+	//Gribb/Hartmann: with clip = p * M every clip plane is a sum or difference of two columns of M,
+	//near is z >= 0 as in D3D
+	const XMFLOAT4X4& m = viewProjection;
+	XMFLOAT4 column[4];
+	for (UINT c = 0; c < 4; c++)
+		column[c] = XMFLOAT4(m.m[0][c], m.m[1][c], m.m[2][c], m.m[3][c]);
+
+	const auto Combine = [](const XMFLOAT4& a, const XMFLOAT4& b, float sign)
+	{
+		XMFLOAT4 plane(a.x + sign * b.x, a.y + sign * b.y, a.z + sign * b.z, a.w + sign * b.w);
+		float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		if (length > 0.0f)
+		{
+			plane.x /= length; plane.y /= length; plane.z /= length; plane.w /= length;
+		}
+		return plane;
+	};
+
+	m_FrustumPlanes[0] = Combine(column[3], column[0], 1.0f);
+	m_FrustumPlanes[1] = Combine(column[3], column[0], -1.0f);
+	m_FrustumPlanes[2] = Combine(column[3], column[1], 1.0f);
+	m_FrustumPlanes[3] = Combine(column[3], column[1], -1.0f);
+	m_FrustumPlanes[4] = Combine(column[2], column[3], 0.0f);
+	m_FrustumPlanes[5] = Combine(column[3], column[2], -1.0f);
+}
+
+void RockInstanceRenderer::Submit(const RockDrawMesh& mesh, UINT material, const XMFLOAT4X4& world)
+{
+	m_Stats.Submitted++;
+	if (mesh.IndexCount == 0 || !IsVisible(mesh, world))
+		return;
+
+	Instance instance;
+	instance.Key = ((UINT64)material << 32) | mesh.Mesh;
+	instance.IndexCount = mesh.IndexCount;
+	instance.World = world;
+	m_Instances.push_back(instance);
+}
+
+void RockInstanceRenderer::SubmitField(const RockField& field, const std::vector<RockDrawMesh>& meshes, UINT material)
+{
+	m_Instances.reserve(m_Instances.size() + field.Instances.size());
+	for (const auto& instance : field.Instances)
+		Submit(meshes[instance.Mesh], material, instance.World);
+}
+
+void RockInstanceRenderer::Flush()
+{
+	m_Stats.Visible = (UINT)m_Instances.size();
+	if (m_Instances.empty())
+		return;
+
+	//Stable, so instances inside a group keep their submission order
+	std::stable_sort(m_Instances.begin(), m_Instances.end(), [](const Instance& a, const Instance& b)
+	{
+		return a.Key < b.Key;
+	});
+
+	//One upload for the whole frame, every group draws its own range of it
+	m_InstanceStream.resize(m_Instances.size());
+	for (size_t i = 0; i < m_Instances.size(); i++)
+		m_InstanceStream[i] = m_Instances[i].World;
+	m_pDevice->UploadInstances(m_InstanceStream.data(), (UINT)m_InstanceStream.size());
+
+	bool first = true;
+	UINT material = 0, mesh = 0;
+	for (size_t begin = 0; begin < m_Instances.size();)
+	{
+		size_t end = begin + 1;
+		while (end < m_Instances.size() && m_Instances[end].Key == m_Instances[begin].Key)
+			end++;
+
+		UINT groupMaterial = (UINT)(m_Instances[begin].Key >> 32);
+		UINT groupMesh = (UINT)m_Instances[begin].Key;
+		if (first || groupMaterial != material)
+		{
+			m_pDevice->BindMaterial(groupMaterial);
+			m_Stats.MaterialBinds++;
+		}
+		if (first || groupMaterial != material || groupMesh != mesh)
+		{
+			//A material switch can replace the input layout, so the mesh is bound again after one
+			m_pDevice->BindMesh(groupMesh);
+			m_Stats.MeshBinds++;
+		}
+		material = groupMaterial;
+		mesh = groupMesh;
+		first = false;
+
+		m_pDevice->DrawIndexedInstanced(m_Instances[begin].IndexCount, (UINT)(end - begin), (UINT)begin);
+		m_Stats.Draws++;
+		begin = end;
+	}
+
+	m_Instances.clear();
+}
+
+//CULLING
+//*******************************************************************************************************************************
+RockDrawMesh RockInstanceRenderer::DescribeMesh(UINT mesh, const std::vector<VertexRock>& vertices, UINT indexCount)
+{
+	RockDrawMesh result;
+	result.Mesh = mesh;
+	result.IndexCount = indexCount;
+	if (vertices.empty())
+		return result;
+
+	XMFLOAT3 minPos = vertices[0].Position, maxPos = vertices[0].Position;
+	for (const auto& vertex : vertices)
+	{
+		minPos.x = (std::min)(minPos.x, vertex.Position.x); maxPos.x = (std::max)(maxPos.x, vertex.Position.x);
+		minPos.y = (std::min)(minPos.y, vertex.Position.y); maxPos.y = (std::max)(maxPos.y, vertex.Position.y);
+		minPos.z = (std::min)(minPos.z, vertex.Position.z); maxPos.z = (std::max)(maxPos.z, vertex.Position.z);
+	}
+	result.BoundsCenter = XMFLOAT3((minPos.x + maxPos.x) * 0.5f, (minPos.y + maxPos.y) * 0.5f, (minPos.z + maxPos.z) * 0.5f);
+
+	float radiusSq = 0.0f;
+	for (const auto& vertex : vertices)
+	{
+		float dx = vertex.Position.x - result.BoundsCenter.x;
+		float dy = vertex.Position.y - result.BoundsCenter.y;
+		float dz = vertex.Position.z - result.BoundsCenter.z;
+		radiusSq = (std::max)(radiusSq, dx * dx + dy * dy + dz * dz);
+	}
+	result.BoundsRadius = sqrtf(radiusSq);
+	return result;
+}
+
+bool RockInstanceRenderer::IsVisible(const RockDrawMesh& mesh, const XMFLOAT4X4& world) const
+{
+	const XMFLOAT3& c = mesh.BoundsCenter;
+	XMFLOAT3 center(
+		c.x * world._11 + c.y * world._21 + c.z * world._31 + world._41,
+		c.x * world._12 + c.y * world._22 + c.z * world._32 + world._42,
+		c.x * world._13 + c.y * world._23 + c.z * world._33 + world._43);
+
+	//Non uniform scale grows the sphere by the largest axis
+	float scale = 0.0f;
+	for (UINT r = 0; r < 3; r++)
+		scale = (std::max)(scale, world.m[r][0] * world.m[r][0] + world.m[r][1] * world.m[r][1] + world.m[r][2] * world.m[r][2]);
+	float radius = mesh.BoundsRadius * sqrtf(scale);
+
+	for (const auto& plane : m_FrustumPlanes)
+	{
+		if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "RockHeader.h"
+#include "RockField.h"
+
+//The few device calls instanced rock drawing needs. Meshes and materials are handles the device hands out,
+//so the batching below never touches an API and can run against a stand-in device.
+class RockRenderDevice
+{
+public:
+	virtual ~RockRenderDevice() {}
+
+	//Replaces the instance stream; instance i of a draw reads pWorlds[firstInstance + i]
+	virtual void UploadInstances(const XMFLOAT4X4* pWorlds, UINT count) = 0;
+	virtual void BindMaterial(UINT material) = 0;
+	virtual void BindMesh(UINT mesh) = 0;
+	virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT firstInstance) = 0;
+};
+
+//What the renderer needs to know about a mesh the device owns. The bounding sphere is in object space.
+struct RockDrawMesh
+{
+	UINT Mesh = 0;
+	UINT IndexCount = 0;
+	XMFLOAT3 BoundsCenter = XMFLOAT3(0, 0, 0);
+	float BoundsRadius = 0.0f;
+};
+
+struct RockDrawStats
+{
+	UINT Submitted = 0;
+	UINT Visible = 0;
+	UINT Draws = 0;
+	UINT MaterialBinds = 0;
+	UINT MeshBinds = 0;
+};
+
+//Collects rock instances for a frame, drops the ones outside the view frustum and draws the rest with one
+//instanced draw per (material, mesh) group. Groups are sorted by material first, so every material is bound once.
+class RockInstanceRenderer
+{
+public:
+	explicit RockInstanceRenderer(RockRenderDevice* pDevice);
+	~RockInstanceRenderer(void) {}
+
+	//Starts a frame; viewProjection uses the row vector convention of the camera, clip = position * viewProjection
+	void Begin(const XMFLOAT4X4& viewProjection);
+	//Instances whose bounding sphere is outside the frustum are dropped here
+	void Submit(const RockDrawMesh& mesh, UINT material, const XMFLOAT4X4& world);
+	//Every instance of a scattered field; meshes[i] describes field.Meshes[i] as the device holds it
+	void SubmitField(const RockField& field, const std::vector<RockDrawMesh>& meshes, UINT material);
+	void Flush();
+
+	const RockDrawStats& GetStats() const { return m_Stats; }
+
+	//Index count and a bounding sphere around the box of the vertices
+	static RockDrawMesh DescribeMesh(UINT mesh, const std::vector<VertexRock>& vertices, UINT indexCount);
+
+private:
+	struct Instance
+	{
+		UINT64 Key;	//material in the high half, mesh in the low half
+		UINT IndexCount;
+		XMFLOAT4X4 World;
+	};
+
+	bool IsVisible(const RockDrawMesh& mesh, const XMFLOAT4X4& world) const;
+
+	RockRenderDevice* m_pDevice;
+	std::vector<Instance> m_Instances;
+	XMFLOAT4 m_FrustumPlanes[6];
+	std::vector<XMFLOAT4X4> m_InstanceStream;
+	RockDrawStats m_Stats;
+
+private:
+
+	// -------------------------
+	// Disabling default copy constructor and default
+	// assignment operator.
+	// -------------------------
+	RockInstanceRenderer(const RockInstanceRenderer& yRef);
+	RockInstanceRenderer& operator=(const RockInstanceRenderer& yRef);
+};
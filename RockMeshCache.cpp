@@ -0,0 +1,338 @@
+#include "stdafx.h"
+#include "RockMeshCache.h"
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char CACHE_MAGIC[4] = { 'R', 'O', 'C', 'K' };
+static const UINT64 DATA_ALIGNMENT = 64;
+
+//Every key field at a fixed place, so files compare and hash independent of struct padding
+struct KeyRecord
+{
+	float Width, Height, Depth;
+	UINT Steps;
+	float MinRandAngle, MaxRandAngle, MaxOffsetPercent, MaxRandShift;
+	UINT MinPlaneVerts, MaxPlaneVerts, MaxPlanes;
+	UINT Seed;
+	UINT NoiseOctaves;
+	float NoiseFrequency, NoiseAmplitude, NoiseLacunarity, NoiseGain;
+	UINT NoiseSeed;
+	UINT LodCount;
+	UINT PackedVertices;
+};
+
+struct FileHeader
+{
+	char Magic[4];
+	UINT FormatVersion;
+	UINT LodCount;
+	UINT Reserved;
+	KeyRecord Key;
+};
+
+struct LodRecord
+{
+	UINT64 VertexOffset;
+	UINT64 IndexOffset;
+	UINT VertexCount;
+	UINT VertexStride;
+	UINT IndexCount;
+	UINT IndexStride;
+	float GeometricError;
+	PackedBounds Bounds;
+};
+
+const auto MakeKeyRecord = [](const RockCacheKey& key)
+{
+	KeyRecord record;
+	memset(&record, 0, sizeof(record));
+	const RockParameters& parameters = key.Parameters;
+	record.Width = parameters.Width;
+	record.Height = parameters.Height;
+	record.Depth = parameters.Depth;
+	record.Steps = parameters.Steps;
+	record.MinRandAngle = parameters.MinRandAngle;
+	record.MaxRandAngle = parameters.MaxRandAngle;
+	record.MaxOffsetPercent = parameters.MaxOffsetPercent;
+	record.MaxRandShift = parameters.MaxRandShift;
+	record.MinPlaneVerts = parameters.MinPlaneVerts;
+	record.MaxPlaneVerts = parameters.MaxPlaneVerts;
+	record.MaxPlanes = parameters.MaxPlanes;
+	record.Seed = parameters.Seed;
+	record.NoiseOctaves = parameters.NoiseOctaves;
+	record.NoiseFrequency = parameters.NoiseFrequency;
+	record.NoiseAmplitude = parameters.NoiseAmplitude;
+	record.NoiseLacunarity = parameters.NoiseLacunarity;
+	record.NoiseGain = parameters.NoiseGain;
+	record.NoiseSeed = parameters.NoiseSeed;
+	record.LodCount = key.LodCount;
+	record.PackedVertices = key.PackedVertices ? 1 : 0;
+	return record;
+};
+
+const auto AlignOffset = [](UINT64 offset)
+{
+	return (offset + DATA_ALIGNMENT - 1) & ~(DATA_ALIGNMENT - 1);
+};
+
+//KEY
+//*******************************************************************************************************************************
+UINT64 RockCacheKey::GetHash() const
+{
+	//FNV-1a over the format version and the key record
+	KeyRecord record = MakeKeyRecord(*this);
+	UINT version = RockMeshCache::FORMAT_VERSION;
+	UINT64 hash = 0xCBF29CE484222325ull;
+	const auto Hash = [&hash](const void* data, size_t size)
+	{
+		const BYTE* bytes = static_cast<const BYTE*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 0x100000001B3ull;
+		}
+	};
+	Hash(&version, sizeof(version));
+	Hash(&record, sizeof(record));
+	return hash;
+}
+
+//CACHE
+//*******************************************************************************************************************************
+RockMeshCache::RockMeshCache(const std::string& directory) :
+	m_Directory(directory)
+{
+#ifdef _WIN32
+	CreateDirectoryA(m_Directory.c_str(), nullptr);
+#else
+	mkdir(m_Directory.c_str(), 0755);
+#endif
+}
+
+std::string RockMeshCache::GetPath(const RockCacheKey& key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.rock", (unsigned long long)key.GetHash());
+	return m_Directory + "/" + name;
+}
+
+std::unique_ptr<RockCacheEntry> RockMeshCache::Find(const RockCacheKey& key) const
+{
+	std::string path = GetPath(key);
+	std::unique_ptr<RockCacheEntry> entry(new RockCacheEntry());
+
+	//MAP
+	//-----------------------------------------------------------------------------------------
+#ifdef _WIN32
+	//FILE_SHARE_DELETE lets Store replace the file while rocks still have it mapped
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return nullptr;
+	entry->m_File = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart < (LONGLONG)sizeof(FileHeader))
+		return nullptr;
+	entry->m_Mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (entry->m_Mapping == nullptr)
+		return nullptr;
+	entry->m_pData = static_cast<const BYTE*>(MapViewOfFile(entry->m_Mapping, FILE_MAP_READ, 0, 0, 0));
+	if (entry->m_pData == nullptr)
+		return nullptr;
+	entry->m_Size = (size_t)size.QuadPart;
+#else
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return nullptr;
+	struct stat status;
+	if (fstat(file, &status) != 0 || status.st_size < (off_t)sizeof(FileHeader))
+	{
+		close(file);
+		return nullptr;
+	}
+	void* pData = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (pData == MAP_FAILED)
+		return nullptr;
+	entry->m_pData = static_cast<const BYTE*>(pData);
+	entry->m_Size = (size_t)status.st_size;
+#endif
+
+	//VALIDATE
+	//-----------------------------------------------------------------------------------------
+	const FileHeader* pHeader = reinterpret_cast<const FileHeader*>(entry->m_pData);
+	KeyRecord record = MakeKeyRecord(key);
+	if (memcmp(pHeader->Magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+		pHeader->FormatVersion != FORMAT_VERSION ||
+		memcmp(&pHeader->Key, &record, sizeof(record)) != 0 ||
+		pHeader->LodCount == 0 ||
+		sizeof(FileHeader) + (UINT64)pHeader->LodCount * sizeof(LodRecord) > entry->m_Size)
+	{
+		return nullptr;
+	}
+
+	UINT vertexStride = key.PackedVertices ? sizeof(VertexRockPacked) : sizeof(VertexRock);
+	const LodRecord* pRecords = reinterpret_cast<const LodRecord*>(entry->m_pData + sizeof(FileHeader));
+	for (UINT i = 0; i < pHeader->LodCount; i++)
+	{
+		const LodRecord& lodRecord = pRecords[i];
+		if (lodRecord.VertexStride != vertexStride ||
+			(lodRecord.IndexStride != sizeof(WORD) && lodRecord.IndexStride != sizeof(DWORD)) ||
+			lodRecord.VertexOffset % DATA_ALIGNMENT != 0 || lodRecord.IndexOffset % DATA_ALIGNMENT != 0 ||
+			lodRecord.VertexOffset + (UINT64)lodRecord.VertexCount * lodRecord.VertexStride > entry->m_Size ||
+			lodRecord.IndexOffset + (UINT64)lodRecord.IndexCount * lodRecord.IndexStride > entry->m_Size)
+		{
+			return nullptr;
+		}
+
+		//Every index has to address a vertex of its LOD, a damaged file must not reach the GPU
+		const BYTE* pIndices = entry->m_pData + lodRecord.IndexOffset;
+		UINT maxIndex = 0;
+		if (lodRecord.IndexStride == sizeof(WORD))
+		{
+			for (UINT j = 0; j < lodRecord.IndexCount; j++)
+				maxIndex = (std::max)(maxIndex, (UINT)reinterpret_cast<const WORD*>(pIndices)[j]);
+		}
+		else
+		{
+			for (UINT j = 0; j < lodRecord.IndexCount; j++)
+				maxIndex = (std::max)(maxIndex, (UINT)reinterpret_cast<const DWORD*>(pIndices)[j]);
+		}
+		if (lodRecord.IndexCount > 0 && maxIndex >= lodRecord.VertexCount)
+			return nullptr;
+
+		RockCachedLod lod;
+		lod.pVertices = entry->m_pData + lodRecord.VertexOffset;
+		lod.VertexCount = lodRecord.VertexCount;
+		lod.VertexStride = lodRecord.VertexStride;
+		lod.pIndices = entry->m_pData + lodRecord.IndexOffset;
+		lod.IndexCount = lodRecord.IndexCount;
+		lod.IndexStride = lodRecord.IndexStride;
+		lod.GeometricError = lodRecord.GeometricError;
+		lod.Bounds = lodRecord.Bounds;
+		entry->m_Lods.push_back(lod);
+	}
+
+	return entry;
+}
+
+bool RockMeshCache::Store(const RockCacheKey& key, const std::vector<LodData>& lods) const
+{
+	if (lods.empty())
+		return false;
+
+	//LAYOUT
+	//-----------------------------------------------------------------------------------------
+	FileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.Magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.FormatVersion = FORMAT_VERSION;
+	header.LodCount = (UINT)lods.size();
+	header.Key = MakeKeyRecord(key);
+
+	UINT vertexStride = key.PackedVertices ? sizeof(VertexRockPacked) : sizeof(VertexRock);
+	std::vector<LodRecord> records(lods.size());	//value initialised, so the padding goes to the file as zeros
+	UINT64 offset = sizeof(FileHeader) + lods.size() * sizeof(LodRecord);
+	for (size_t i = 0; i < lods.size(); i++)
+	{
+		LodRecord& record = records[i];
+		record.VertexCount = lods[i].VertexCount;
+		record.VertexStride = vertexStride;
+		record.IndexCount = lods[i].pIndices->GetCount();
+		record.IndexStride = lods[i].pIndices->GetStride();
+		record.GeometricError = lods[i].GeometricError;
+		record.Bounds = lods[i].Bounds;
+
+		record.VertexOffset = AlignOffset(offset);
+		offset = record.VertexOffset + (UINT64)record.VertexCount * record.VertexStride;
+		record.IndexOffset = AlignOffset(offset);
+		offset = record.IndexOffset + (UINT64)record.IndexCount * record.IndexStride;
+	}
+
+	//WRITE
+	//-----------------------------------------------------------------------------------------
+	//Process and thread in the name, so writers in other processes sharing the directory never collide
+	std::string path = GetPath(key);
+#ifdef _WIN32
+	unsigned long processId = GetCurrentProcessId();
+#else
+	unsigned long processId = (unsigned long)getpid();
+#endif
+	char suffix[64];
+	snprintf(suffix, sizeof(suffix), ".%lx.%zx.tmp", processId, std::hash<std::thread::id>()(std::this_thread::get_id()));
+	std::string tempPath = path + suffix;
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		UINT64 written = 0;
+		const auto Write = [&](const void* data, UINT64 size)
+		{
+			file.write(static_cast<const char*>(data), (std::streamsize)size);
+			written += size;
+		};
+		const auto PadTo = [&](UINT64 target)
+		{
+			static const char zeros[DATA_ALIGNMENT] = {};
+			Write(zeros, target - written);
+		};
+
+		Write(&header, sizeof(header));
+		Write(records.data(), records.size() * sizeof(LodRecord));
+		for (size_t i = 0; i < lods.size(); i++)
+		{
+			PadTo(records[i].VertexOffset);
+			Write(lods[i].pVertices, (UINT64)records[i].VertexCount * records[i].VertexStride);
+			PadTo(records[i].IndexOffset);
+			Write(lods[i].pIndices->GetData(), (UINT64)records[i].IndexCount * records[i].IndexStride);
+		}
+		if (!file.good())
+		{
+			file.close();
+			std::remove(tempPath.c_str());
+			return false;
+		}
+	}
+
+#ifdef _WIN32
+	bool renamed = MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	bool renamed = std::rename(tempPath.c_str(), path.c_str()) == 0;
+#endif
+	if (renamed)
+		return true;
+
+	//Another writer got there first, or (on Windows) a rock still maps a file the replace cannot take over.
+	//Equal keys build equal meshes, so a valid file already there is as good as ours.
+	std::remove(tempPath.c_str());
+	return Find(key) != nullptr;
+}
+
+//ENTRY
+//*******************************************************************************************************************************
+RockCacheEntry::~RockCacheEntry(void)
+{
+#ifdef _WIN32
+	if (m_pData != nullptr)
+		UnmapViewOfFile(m_pData);
+	if (m_Mapping != nullptr)
+		CloseHandle(m_Mapping);
+	if (m_File != nullptr)
+		CloseHandle(m_File);
+#else
+	if (m_pData != nullptr)
+		munmap(const_cast<BYTE*>(m_pData), m_Size);
+#endif
+}
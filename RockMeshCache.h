@@ -0,0 +1,100 @@
+#pragma once
+#include "RockGenerator.h"
+#include "RockPacking.h"
+#include <memory>
+#include <string>
+
+//Everything the cached meshes of a rock depend on
+struct RockCacheKey
+{
+	RockParameters Parameters;
+	UINT LodCount = 1;
+	bool PackedVertices = false;
+
+	UINT64 GetHash() const;
+};
+
+//One LOD as it lies in a mapped cache file. Vertices are VertexRock or VertexRockPacked (see VertexStride),
+//indices are WORD or DWORD (see IndexStride); both start 64 byte aligned and can be handed to the GPU as they are.
+struct RockCachedLod
+{
+	const void* pVertices = nullptr;
+	UINT VertexCount = 0;
+	UINT VertexStride = 0;
+	const void* pIndices = nullptr;
+	UINT IndexCount = 0;
+	UINT IndexStride = 0;
+	float GeometricError = 0.0f;
+	PackedBounds Bounds;
+};
+
+//A cache file mapped read only; the RockCachedLod pointers stay valid while it lives
+class RockCacheEntry
+{
+public:
+	~RockCacheEntry(void);
+
+	UINT GetLodCount() const { return (UINT)m_Lods.size(); }
+	const RockCachedLod& GetLod(UINT lod) const { return m_Lods[lod]; }
+
+private:
+	friend class RockMeshCache;
+	RockCacheEntry() {}
+
+	const BYTE* m_pData = nullptr;
+	size_t m_Size = 0;
+	std::vector<RockCachedLod> m_Lods;
+#ifdef _WIN32
+	void* m_File = nullptr;
+	void* m_Mapping = nullptr;
+#endif
+
+	// -------------------------
+	// Disabling default copy constructor and default
+	// assignment operator.
+	// -------------------------
+	RockCacheEntry(const RockCacheEntry& yRef);
+	RockCacheEntry& operator=(const RockCacheEntry& yRef);
+};
+
+//Persistent cache of generated rock meshes, one file per key named after its hash.
+//File layout, all offsets from the start of the file:
+//	FileHeader | LodRecord[LodCount] | per LOD: vertices, indices (each 64 byte aligned)
+//The header repeats the key, so a hash collision or a file of an older FORMAT_VERSION reads as a miss.
+class RockMeshCache
+{
+public:
+	//Bump whenever the file layout or the generated meshes change, old files then stop matching
+	static const UINT FORMAT_VERSION = 4;
+
+	//The directory is created when it does not exist yet
+	explicit RockMeshCache(const std::string& directory);
+	~RockMeshCache(void) {}
+
+	//nullptr when there is no valid file for key
+	std::unique_ptr<RockCacheEntry> Find(const RockCacheKey& key) const;
+
+	//Vertices must match key.PackedVertices: VertexRockPacked when set, VertexRock otherwise
+	struct LodData
+	{
+		const void* pVertices;
+		UINT VertexCount;
+		const PackedIndices* pIndices;
+		float GeometricError;
+		PackedBounds Bounds;
+	};
+	//Writes to a temporary file first and renames it, so readers never map a half written file
+	bool Store(const RockCacheKey& key, const std::vector<LodData>& lods) const;
+
+	std::string GetPath(const RockCacheKey& key) const;
+
+private:
+	std::string m_Directory;
+
+	// -------------------------
+	// Disabling default copy constructor and default
+	// assignment operator.
+	// -------------------------
+	RockMeshCache(const RockMeshCache& yRef);
+	RockMeshCache& operator=(const RockMeshCache& yRef);
+};
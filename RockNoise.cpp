@@ -0,0 +1,177 @@
+#include "stdafx.h"
+#include "RockNoise.h"
+#include "RockRandom.h"
+#include <cmath>
+
+//LATTICE HASH
+//*******************************************************************************************************************************
+//permute(v) = ((34v + 1) v) mod 289 stays below 2^24 for v < 578, so it is exact in float and every lattice point
+//hashes to the same value in both versions. The hash picks one of 7 x 7 gradients spread over an octahedron.
+const float MODULUS = 289.0f;
+const float INV_MODULUS = 1.0f / 289.0f;
+const float INV_SEVEN = 1.0f / 7.0f;
+const float INV_FORTY_NINE = 1.0f / 49.0f;
+
+const auto Mod289 = [](float v)
+{
+	return v - floorf(v * INV_MODULUS) * MODULUS;
+};
+
+const auto Permute = [](float v)
+{
+	return Mod289((v * 34.0f + 1.0f) * v);
+};
+
+const auto Fade = [](float t)
+{
+	return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+};
+
+//Gradient of hash h dotted with the offset (dx, dy, dz) from its lattice point
+const auto GradientDot = [](float h, float dx, float dy, float dz)
+{
+	float j = h - floorf(h * INV_FORTY_NINE) * 49.0f;
+	float row = floorf(j * INV_SEVEN);
+	float column = j - row * 7.0f;
+	float gx = (row + 0.5f) * (2.0f / 7.0f) - 1.0f;
+	float gy = (column + 0.5f) * (2.0f / 7.0f) - 1.0f;
+	float gz = 1.0f - fabsf(gx) - fabsf(gy);
+	return gx * dx + gy * dy + gz * dz;
+};
+
+const auto Mod289V = [](FXMVECTOR v)
+{
+	return XMVectorSubtract(v, XMVectorMultiply(XMVectorFloor(XMVectorMultiply(v, XMVectorReplicate(INV_MODULUS))), XMVectorReplicate(MODULUS)));
+};
+
+const auto PermuteV = [](FXMVECTOR v)
+{
+	XMVECTOR linear = XMVectorAdd(XMVectorMultiply(v, XMVectorReplicate(34.0f)), XMVectorReplicate(1.0f));
+	return Mod289V(XMVectorMultiply(linear, v));
+};
+
+const auto FadeV = [](FXMVECTOR t)
+{
+	XMVECTOR inner = XMVectorAdd(XMVectorMultiply(t, XMVectorSubtract(XMVectorMultiply(t, XMVectorReplicate(6.0f)), XMVectorReplicate(15.0f))), XMVectorReplicate(10.0f));
+	return XMVectorMultiply(XMVectorMultiply(XMVectorMultiply(t, t), t), inner);
+};
+
+const auto GradientDotV = [](FXMVECTOR h, FXMVECTOR dx, FXMVECTOR dy, GXMVECTOR dz)
+{
+	XMVECTOR j = XMVectorSubtract(h, XMVectorMultiply(XMVectorFloor(XMVectorMultiply(h, XMVectorReplicate(INV_FORTY_NINE))), XMVectorReplicate(49.0f)));
+	XMVECTOR row = XMVectorFloor(XMVectorMultiply(j, XMVectorReplicate(INV_SEVEN)));
+	XMVECTOR column = XMVectorSubtract(j, XMVectorMultiply(row, XMVectorReplicate(7.0f)));
+	XMVECTOR gx = XMVectorSubtract(XMVectorMultiply(XMVectorAdd(row, XMVectorReplicate(0.5f)), XMVectorReplicate(2.0f / 7.0f)), XMVectorReplicate(1.0f));
+	XMVECTOR gy = XMVectorSubtract(XMVectorMultiply(XMVectorAdd(column, XMVectorReplicate(0.5f)), XMVectorReplicate(2.0f / 7.0f)), XMVectorReplicate(1.0f));
+	XMVECTOR gz = XMVectorSubtract(XMVectorSubtract(XMVectorReplicate(1.0f), XMVectorAbs(gx)), XMVectorAbs(gy));
+	return XMVectorAdd(XMVectorAdd(XMVectorMultiply(gx, dx), XMVectorMultiply(gy, dy)), XMVectorMultiply(gz, dz));
+};
+
+//OCTAVES
+//*******************************************************************************************************************************
+RockNoiseOctaves RockNoise::MakeOctaves(UINT seed, UINT count, float frequency, float amplitude, float lacunarity, float gain)
+{
+	RockNoiseOctaves octaves;
+	octaves.Count = (std::min)(count, UINT(RockNoiseOctaves::MAX_OCTAVES));
+	for (UINT o = 0; o < octaves.Count; o++)
+	{
+		//Offsets stay small enough that the lattice coordinates keep their fractional precision
+		RockRandom random(seed, o);
+		octaves.Frequency[o] = frequency;
+		octaves.Amplitude[o] = amplitude;
+		octaves.Offset[o] = XMFLOAT3(random.NextFloat() * 256.0f, random.NextFloat() * 256.0f, random.NextFloat() * 256.0f);
+		frequency *= lacunarity;
+		amplitude *= gain;
+	}
+	return octaves;
+}
+
+//SCALAR REFERENCE
+//*******************************************************************************************************************************
+float RockNoise::Gradient(float x, float y, float z)
+{
+	float ix = floorf(x), iy = floorf(y), iz = floorf(z);
+	float fx = x - ix, fy = y - iy, fz = z - iz;
+	ix = Mod289(ix);
+	iy = Mod289(iy);
+	iz = Mod289(iz);
+
+	float x0 = Permute(ix), x1 = Permute(ix + 1.0f);
+	float y00 = Permute(x0 + iy), y10 = Permute(x1 + iy);
+	float y01 = Permute(x0 + iy + 1.0f), y11 = Permute(x1 + iy + 1.0f);
+
+	float n000 = GradientDot(Permute(y00 + iz), fx, fy, fz);
+	float n100 = GradientDot(Permute(y10 + iz), fx - 1.0f, fy, fz);
+	float n010 = GradientDot(Permute(y01 + iz), fx, fy - 1.0f, fz);
+	float n110 = GradientDot(Permute(y11 + iz), fx - 1.0f, fy - 1.0f, fz);
+	float n001 = GradientDot(Permute(y00 + iz + 1.0f), fx, fy, fz - 1.0f);
+	float n101 = GradientDot(Permute(y10 + iz + 1.0f), fx - 1.0f, fy, fz - 1.0f);
+	float n011 = GradientDot(Permute(y01 + iz + 1.0f), fx, fy - 1.0f, fz - 1.0f);
+	float n111 = GradientDot(Permute(y11 + iz + 1.0f), fx - 1.0f, fy - 1.0f, fz - 1.0f);
+
+	float u = Fade(fx), v = Fade(fy), w = Fade(fz);
+	float nx00 = n000 + (n100 - n000) * u, nx10 = n010 + (n110 - n010) * u;
+	float nx01 = n001 + (n101 - n001) * u, nx11 = n011 + (n111 - n011) * u;
+	float nxy0 = nx00 + (nx10 - nx00) * v, nxy1 = nx01 + (nx11 - nx01) * v;
+	return nxy0 + (nxy1 - nxy0) * w;
+}
+
+float RockNoise::Fbm(float x, float y, float z, const RockNoiseOctaves& octaves)
+{
+	float sum = 0.0f;
+	for (UINT o = 0; o < octaves.Count; o++)
+	{
+		float frequency = octaves.Frequency[o];
+		const XMFLOAT3& offset = octaves.Offset[o];
+		sum += octaves.Amplitude[o] * Gradient(x * frequency + offset.x, y * frequency + offset.y, z * frequency + offset.z);
+	}
+	return sum;
+}
+
+//FOUR LANES
+//*******************************************************************************************************************************
+XMVECTOR XM_CALLCONV RockNoise::Gradient4(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z)
+{
+	const XMVECTOR one = XMVectorReplicate(1.0f);
+	XMVECTOR ix = XMVectorFloor(x), iy = XMVectorFloor(y), iz = XMVectorFloor(z);
+	XMVECTOR fx = XMVectorSubtract(x, ix), fy = XMVectorSubtract(y, iy), fz = XMVectorSubtract(z, iz);
+	XMVECTOR gx = XMVectorSubtract(fx, one), gy = XMVectorSubtract(fy, one), gz = XMVectorSubtract(fz, one);
+	ix = Mod289V(ix);
+	iy = Mod289V(iy);
+	iz = Mod289V(iz);
+	XMVECTOR iz1 = XMVectorAdd(iz, one);
+
+	XMVECTOR x0 = PermuteV(ix), x1 = PermuteV(XMVectorAdd(ix, one));
+	XMVECTOR y00 = PermuteV(XMVectorAdd(x0, iy)), y10 = PermuteV(XMVectorAdd(x1, iy));
+	XMVECTOR y01 = PermuteV(XMVectorAdd(XMVectorAdd(x0, iy), one)), y11 = PermuteV(XMVectorAdd(XMVectorAdd(x1, iy), one));
+
+	XMVECTOR n000 = GradientDotV(PermuteV(XMVectorAdd(y00, iz)), fx, fy, fz);
+	XMVECTOR n100 = GradientDotV(PermuteV(XMVectorAdd(y10, iz)), gx, fy, fz);
+	XMVECTOR n010 = GradientDotV(PermuteV(XMVectorAdd(y01, iz)), fx, gy, fz);
+	XMVECTOR n110 = GradientDotV(PermuteV(XMVectorAdd(y11, iz)), gx, gy, fz);
+	XMVECTOR n001 = GradientDotV(PermuteV(XMVectorAdd(y00, iz1)), fx, fy, gz);
+	XMVECTOR n101 = GradientDotV(PermuteV(XMVectorAdd(y10, iz1)), gx, fy, gz);
+	XMVECTOR n011 = GradientDotV(PermuteV(XMVectorAdd(y01, iz1)), fx, gy, gz);
+	XMVECTOR n111 = GradientDotV(PermuteV(XMVectorAdd(y11, iz1)), gx, gy, gz);
+
+	XMVECTOR u = FadeV(fx), v = FadeV(fy), w = FadeV(fz);
+	XMVECTOR nx00 = XMVectorLerpV(n000, n100, u), nx10 = XMVectorLerpV(n010, n110, u);
+	XMVECTOR nx01 = XMVectorLerpV(n001, n101, u), nx11 = XMVectorLerpV(n011, n111, u);
+	return XMVectorLerpV(XMVectorLerpV(nx00, nx10, v), XMVectorLerpV(nx01, nx11, v), w);
+}
+
+XMVECTOR XM_CALLCONV RockNoise::Fbm4(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z, const RockNoiseOctaves& octaves)
+{
+	XMVECTOR sum = XMVectorZero();
+	for (UINT o = 0; o < octaves.Count; o++)
+	{
+		XMVECTOR frequency = XMVectorReplicate(octaves.Frequency[o]);
+		const XMFLOAT3& offset = octaves.Offset[o];
+		XMVECTOR noise = Gradient4(
+			XMVectorMultiplyAdd(x, frequency, XMVectorReplicate(offset.x)),
+			XMVectorMultiplyAdd(y, frequency, XMVectorReplicate(offset.y)),
+			XMVectorMultiplyAdd(z, frequency, XMVectorReplicate(offset.z)));
+		sum = XMVectorMultiplyAdd(noise, XMVectorReplicate(octaves.Amplitude[o]), sum);
+	}
+	return sum;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "RockHeader.h"
+
+//Frequency, amplitude and lattice offset of every octave of one fBm sum
+struct RockNoiseOctaves
+{
+	static const UINT MAX_OCTAVES = 8;
+
+	UINT Count = 0;
+	float Frequency[MAX_OCTAVES];
+	float Amplitude[MAX_OCTAVES];
+	XMFLOAT3 Offset[MAX_OCTAVES];
+};
+
+//3D gradient noise (Perlin's, with the quintic fade) and fBm sums of it. The lattice hash is the mod 289 permutation
+//polynomial, which stays exact in float, so the four lane versions run on plain XMVECTOR math and hash exactly like
+//the scalar ones; the two only differ by rounding in the interpolation.
+class RockNoise
+{
+public:
+	//Octave o samples at frequency * lacunarity^o with amplitude * gain^o; the seed picks a lattice offset per octave.
+	//count is capped at MAX_OCTAVES.
+	static RockNoiseOctaves MakeOctaves(UINT seed, UINT count, float frequency, float amplitude, float lacunarity, float gain);
+
+	//Scalar reference, roughly in [-1, 1]
+	static float Gradient(float x, float y, float z);
+	static float Fbm(float x, float y, float z, const RockNoiseOctaves& octaves);
+
+	//The same for four points, one coordinate per vector
+	static XMVECTOR XM_CALLCONV Gradient4(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z);
+	static XMVECTOR XM_CALLCONV Fbm4(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z, const RockNoiseOctaves& octaves);
+
+private:
+	// -------------------------
+	// Disabling default constructor, copy constructor and
+	// assignment operator.
+	// -------------------------
+	RockNoise();
+	RockNoise(const RockNoise& yRef);
+	RockNoise& operator=(const RockNoise& yRef);
+};
@@ -0,0 +1,237 @@
+#include "stdafx.h"
+#include "RockPacking.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+const auto QuantiseUnorm = [](float value, float min, float extent)
+{
+	float normalized = extent > 0 ? (value - min) / extent : 0.0f;
+	normalized = (std::min)((std::max)(normalized, 0.0f), 1.0f);
+	return (WORD)(normalized * 65535.0f + 0.5f);
+};
+
+const auto DequantiseUnorm = [](WORD value, float min, float extent)
+{
+	return min + (value / 65535.0f) * extent;
+};
+
+const auto QuantiseSnorm = [](float value)
+{
+	value = (std::min)((std::max)(value, -1.0f), 1.0f);
+	return (SHORT)floorf(value * 32767.0f + 0.5f);
+};
+
+//Same clamp as D3D: -32768 and -32767 both map to -1
+const auto DequantiseSnorm = [](SHORT value)
+{
+	return (std::max)(value / 32767.0f, -1.0f);
+};
+
+const auto WriteVarint = [](std::vector<BYTE>& out, DWORD value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((BYTE)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((BYTE)value);
+};
+
+//False when the data ends in the middle of a value or the value does not fit 32 bits
+const auto ReadVarint = [](const std::vector<BYTE>& in, size_t& pos, DWORD& value)
+{
+	value = 0;
+	for (UINT shift = 0; shift < 35; shift += 7)
+	{
+		if (pos >= in.size())
+			return false;
+		BYTE byte = in[pos++];
+		value |= (DWORD)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+			return shift < 28 || byte < 0x10;
+	}
+	return false;
+};
+
+//PACK
+//*******************************************************************************************************************************
+PackedBounds RockPacking::Pack(const std::vector<VertexRock>& vertices, std::vector<VertexRockPacked>& packed)
+{
+	PackedBounds bounds;
+	packed.resize(vertices.size());
+	if (vertices.empty())
+		return bounds;
+
+	//BOUNDS
+	//-----------------------------------------------------------------------------------------
+	XMFLOAT3 minPos(FLT_MAX, FLT_MAX, FLT_MAX), maxPos(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	XMFLOAT2 minTex(FLT_MAX, FLT_MAX), maxTex(-FLT_MAX, -FLT_MAX);
+	for (const auto& vertex : vertices)
+	{
+		minPos.x = (std::min)(minPos.x, vertex.Position.x); maxPos.x = (std::max)(maxPos.x, vertex.Position.x);
+		minPos.y = (std::min)(minPos.y, vertex.Position.y); maxPos.y = (std::max)(maxPos.y, vertex.Position.y);
+		minPos.z = (std::min)(minPos.z, vertex.Position.z); maxPos.z = (std::max)(maxPos.z, vertex.Position.z);
+		minTex.x = (std::min)(minTex.x, vertex.TexCoord.x); maxTex.x = (std::max)(maxTex.x, vertex.TexCoord.x);
+		minTex.y = (std::min)(minTex.y, vertex.TexCoord.y); maxTex.y = (std::max)(maxTex.y, vertex.TexCoord.y);
+	}
+	bounds.PositionMin = minPos;
+	bounds.PositionExtent = XMFLOAT3(maxPos.x - minPos.x, maxPos.y - minPos.y, maxPos.z - minPos.z);
+	bounds.TexCoordMin = minTex;
+	bounds.TexCoordExtent = XMFLOAT2(maxTex.x - minTex.x, maxTex.y - minTex.y);
+
+	//VERTICES
+	//-----------------------------------------------------------------------------------------
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const VertexRock& vertex = vertices[i];
+		VertexRockPacked& out = packed[i];
+
+		out.Position[0] = QuantiseUnorm(vertex.Position.x, bounds.PositionMin.x, bounds.PositionExtent.x);
+		out.Position[1] = QuantiseUnorm(vertex.Position.y, bounds.PositionMin.y, bounds.PositionExtent.y);
+		out.Position[2] = QuantiseUnorm(vertex.Position.z, bounds.PositionMin.z, bounds.PositionExtent.z);
+		out.Position[3] = 65535;
+
+		EncodeOctahedral(vertex.Normal, out.Normal);
+		EncodeOctahedral(vertex.Tangent, out.Tangent);
+
+		out.TexCoord[0] = QuantiseUnorm(vertex.TexCoord.x, bounds.TexCoordMin.x, bounds.TexCoordExtent.x);
+		out.TexCoord[1] = QuantiseUnorm(vertex.TexCoord.y, bounds.TexCoordMin.y, bounds.TexCoordExtent.y);
+	}
+
+	return bounds;
+}
+
+//UNPACK
+//*******************************************************************************************************************************
+void RockPacking::Unpack(const std::vector<VertexRockPacked>& packed, const PackedBounds& bounds, std::vector<VertexRock>& vertices)
+{
+	vertices.resize(packed.size());
+	for (size_t i = 0; i < packed.size(); i++)
+	{
+		vertices[i] = Unpack(packed[i], bounds);
+	}
+}
+
+VertexRock RockPacking::Unpack(const VertexRockPacked& vertex, const PackedBounds& bounds)
+{
+	VertexRock out;
+	out.Position.x = DequantiseUnorm(vertex.Position[0], bounds.PositionMin.x, bounds.PositionExtent.x);
+	out.Position.y = DequantiseUnorm(vertex.Position[1], bounds.PositionMin.y, bounds.PositionExtent.y);
+	out.Position.z = DequantiseUnorm(vertex.Position[2], bounds.PositionMin.z, bounds.PositionExtent.z);
+	out.Normal = DecodeOctahedral(vertex.Normal);
+	out.Tangent = DecodeOctahedral(vertex.Tangent);
+	out.TexCoord.x = DequantiseUnorm(vertex.TexCoord[0], bounds.TexCoordMin.x, bounds.TexCoordExtent.x);
+	out.TexCoord.y = DequantiseUnorm(vertex.TexCoord[1], bounds.TexCoordMin.y, bounds.TexCoordExtent.y);
+	return out;
+}
+
+//OCTAHEDRAL
+//*******************************************************************************************************************************
+void RockPacking::EncodeOctahedral(const XMFLOAT3& direction, SHORT encoded[2])
+{
+	//Project onto the octahedron |x| + |y| + |z| = 1, then fold the lower half over the upper one
+	float length = fabsf(direction.x) + fabsf(direction.y) + fabsf(direction.z);
+	if (length <= 0.0f)
+	{
+		encoded[0] = encoded[1] = 0;
+		return;
+	}
+
+	float x = direction.x / length;
+	float y = direction.y / length;
+	if (direction.z < 0.0f)
+	{
+		float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	encoded[0] = QuantiseSnorm(x);
+	encoded[1] = QuantiseSnorm(y);
+}
+
+XMFLOAT3 RockPacking::DecodeOctahedral(const SHORT encoded[2])
+{
+	float x = DequantiseSnorm(encoded[0]);
+	float y = DequantiseSnorm(encoded[1]);
+	float z = 1.0f - fabsf(x) - fabsf(y);
+
+	//Unfold the lower half
+	float fold = (std::max)(-z, 0.0f);
+	x += x >= 0.0f ? -fold : fold;
+	y += y >= 0.0f ? -fold : fold;
+
+	XMFLOAT3 direction;
+	XMStoreFloat3(&direction, XMVector3Normalize(XMVectorSet(x, y, z, 0)));
+	return direction;
+}
+
+//INDICES
+//*******************************************************************************************************************************
+PackedIndices RockPacking::PackIndices(const std::vector<DWORD>& indices, UINT numVertices)
+{
+	PackedIndices packed;
+	packed.Is16Bit = numVertices <= 0xFFFF;
+	if (packed.Is16Bit)
+		packed.Indices16.assign(indices.begin(), indices.end());
+	else
+		packed.Indices32 = indices;
+	return packed;
+}
+
+void RockPacking::UnpackIndices(const PackedIndices& packed, std::vector<DWORD>& indices)
+{
+	if (packed.Is16Bit)
+		indices.assign(packed.Indices16.begin(), packed.Indices16.end());
+	else
+		indices = packed.Indices32;
+}
+
+void RockPacking::CompressIndices(const std::vector<DWORD>& indices, std::vector<BYTE>& compressed)
+{
+	//Subdivided triangles sit next to each other in the vertex list, so most deltas fit one or two bytes
+	compressed.clear();
+	compressed.reserve(indices.size() * 2 + 5);
+	WriteVarint(compressed, (DWORD)indices.size());
+
+	DWORD previous = 0;
+	for (DWORD index : indices)
+	{
+		int delta = (int)(index - previous);
+		WriteVarint(compressed, ((DWORD)delta << 1) ^ (DWORD)(delta >> 31));
+		previous = index;
+	}
+}
+
+bool RockPacking::DecompressIndices(const std::vector<BYTE>& compressed, std::vector<DWORD>& indices)
+{
+	indices.clear();
+
+	size_t pos = 0;
+	DWORD count;
+	if (!ReadVarint(compressed, pos, count) || count > compressed.size() - pos)
+		return false;
+
+	indices.resize(count);
+	DWORD previous = 0;
+	for (DWORD i = 0; i < count; i++)
+	{
+		DWORD zigzag;
+		if (!ReadVarint(compressed, pos, zigzag))
+		{
+			indices.clear();
+			return false;
+		}
+		previous += (zigzag >> 1) ^ (0u - (zigzag & 1));
+		indices[i] = previous;
+	}
+
+	if (pos != compressed.size())
+	{
+		indices.clear();
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "RockHeader.h"
+
+//Range a packed mesh was quantised against; the shader needs it to decode positions and uvs
+struct PackedBounds
+{
+	XMFLOAT3 PositionMin = XMFLOAT3(0, 0, 0);
+	XMFLOAT3 PositionExtent = XMFLOAT3(0, 0, 0);
+	XMFLOAT2 TexCoordMin = XMFLOAT2(0, 0);
+	XMFLOAT2 TexCoordExtent = XMFLOAT2(0, 0);
+};
+
+//Index buffer stored at the narrowest width the vertex count allows; only one of the two vectors is used
+struct PackedIndices
+{
+	std::vector<WORD> Indices16;
+	std::vector<DWORD> Indices32;
+	bool Is16Bit = false;
+
+	UINT GetCount() const { return (UINT)(Is16Bit ? Indices16.size() : Indices32.size()); }
+	UINT GetStride() const { return Is16Bit ? sizeof(WORD) : sizeof(DWORD); }
+	const void* GetData() const { return Is16Bit ? (const void*)Indices16.data() : (const void*)Indices32.data(); }
+	DWORD Get(UINT i) const { return Is16Bit ? Indices16[i] : Indices32[i]; }
+	void Clear() { Indices16.clear(); Indices32.clear(); }
+};
+
+//Converts between VertexRock and VertexRockPacked, and between DWORD indices and their compact forms.
+//Decoding matches what the packed rock shader does:
+//	position = PositionMin + unorm * PositionExtent
+//	texcoord = TexCoordMin + unorm * TexCoordExtent
+//	normal / tangent = DecodeOctahedral(snorm)
+class RockPacking
+{
+public:
+	static PackedBounds Pack(const std::vector<VertexRock>& vertices, std::vector<VertexRockPacked>& packed);
+	static void Unpack(const std::vector<VertexRockPacked>& packed, const PackedBounds& bounds, std::vector<VertexRock>& vertices);
+	static VertexRock Unpack(const VertexRockPacked& vertex, const PackedBounds& bounds);
+
+	//Unit vector <-> point on the octahedron folded into [-1, 1]^2, stored as two SNORM16
+	static void EncodeOctahedral(const XMFLOAT3& direction, SHORT encoded[2]);
+	static XMFLOAT3 DecodeOctahedral(const SHORT encoded[2]);
+
+	//16 bit whenever every index fits below the 0xFFFF strip cut value, 32 bit otherwise
+	static PackedIndices PackIndices(const std::vector<DWORD>& indices, UINT numVertices);
+	static void UnpackIndices(const PackedIndices& packed, std::vector<DWORD>& indices);
+
+	//Storage form for disk or cache copies: index count, then every index as the zigzag
+	//encoded difference to the index before it, all as LEB128 varints
+	static void CompressIndices(const std::vector<DWORD>& indices, std::vector<BYTE>& compressed);
+	static bool DecompressIndices(const std::vector<BYTE>& compressed, std::vector<DWORD>& indices);
+
+private:
+	// -------------------------
+	// Disabling default constructor, copy constructor and
+	// assignment operator.
+	// -------------------------
+	RockPacking();
+	RockPacking(const RockPacking& yRef);
+	RockPacking& operator=(const RockPacking& yRef);
+};
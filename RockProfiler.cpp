@@ -0,0 +1,186 @@
+#include "stdafx.h"
+#include "RockProfiler.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+//Atomic, as pool workers charge the thread they run ranges for while it runs ranges of its own
+struct RockAllocationAccount
+{
+	std::atomic<UINT64> Count;
+	std::atomic<UINT64> Bytes;
+};
+
+static thread_local RockAllocationAccount s_OwnAllocations = {};
+static thread_local RockAllocationAccount* s_pChargedAllocations = nullptr;
+static std::atomic<bool> s_CountingAllocations(false);
+
+//Small sequential ids read better in a trace viewer than hashed std::thread ids
+static UINT GetThreadId()
+{
+	static std::atomic<UINT> s_NextId(1);
+	static thread_local UINT s_Id = 0;
+	if (s_Id == 0)
+		s_Id = s_NextId++;
+	return s_Id;
+}
+
+//ALLOCATION COUNTING
+//*******************************************************************************************************************************
+bool RockProfiler::IsCountingAllocations()
+{
+	return s_CountingAllocations.load(std::memory_order_relaxed);
+}
+
+bool RockProfiler::EnableAllocationCounting()
+{
+	s_CountingAllocations.store(true, std::memory_order_relaxed);
+	return true;
+}
+
+void RockProfiler::CountAllocation(size_t bytes)
+{
+	RockAllocationAccount* pAccount = GetAllocationAccount();
+	pAccount->Count.fetch_add(1, std::memory_order_relaxed);
+	pAccount->Bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+RockAllocationAccount* RockProfiler::GetAllocationAccount()
+{
+	return s_pChargedAllocations ? s_pChargedAllocations : &s_OwnAllocations;
+}
+
+RockAllocationAccount* RockProfiler::SetAllocationAccount(RockAllocationAccount* pAccount)
+{
+	RockAllocationAccount* pPrevious = s_pChargedAllocations;
+	s_pChargedAllocations = pAccount;
+	return pPrevious;
+}
+
+RockAllocationCounters RockProfiler::GetThreadAllocations()
+{
+	RockAllocationCounters counters;
+	counters.Count = s_OwnAllocations.Count.load(std::memory_order_relaxed);
+	counters.Bytes = s_OwnAllocations.Bytes.load(std::memory_order_relaxed);
+	return counters;
+}
+
+double RockProfiler::GetTime()
+{
+	static const auto s_Epoch = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - s_Epoch).count();
+}
+
+//RECORDING
+//*******************************************************************************************************************************
+void RockProfiler::Begin(UINT verticesIn, UINT indicesIn)
+{
+	m_BeginVertices = verticesIn;
+	m_BeginIndices = indicesIn;
+	m_BeginAllocations = GetThreadAllocations();
+	m_BeginTime = GetTime();
+}
+
+void RockProfiler::End(RockStage stage, UINT verticesOut, UINT indicesOut)
+{
+	double end = GetTime();
+
+	RockStageEvent event;
+	event.Stage = stage;
+	event.Lod = m_Lod;
+	event.ThreadId = GetThreadId();
+	event.Start = m_BeginTime;
+	event.Milliseconds = end - m_BeginTime;
+	event.VerticesIn = m_BeginVertices;
+	event.IndicesIn = m_BeginIndices;
+	event.VerticesOut = verticesOut;
+	event.IndicesOut = indicesOut;
+	RockAllocationCounters allocations = GetThreadAllocations();
+	event.Allocations = allocations.Count - m_BeginAllocations.Count;
+	event.AllocatedBytes = allocations.Bytes - m_BeginAllocations.Bytes;
+	event.HasAllocations = IsCountingAllocations();
+	m_Events.push_back(event);
+}
+
+void RockProfiler::Append(const RockProfiler& other)
+{
+	m_Events.insert(m_Events.end(), other.m_Events.begin(), other.m_Events.end());
+}
+
+//QUERIES
+//*******************************************************************************************************************************
+RockStageEvent RockProfiler::GetTotal(RockStage stage) const
+{
+	RockStageEvent total;
+	total.Stage = stage;
+	bool first = true;
+	for (const auto& event : m_Events)
+	{
+		if (event.Stage != stage)
+			continue;
+
+		total.Start = first ? event.Start : (std::min)(total.Start, event.Start);
+		total.Milliseconds += event.Milliseconds;
+		total.VerticesIn += event.VerticesIn;
+		total.IndicesIn += event.IndicesIn;
+		total.VerticesOut += event.VerticesOut;
+		total.IndicesOut += event.IndicesOut;
+		total.Allocations += event.Allocations;
+		total.AllocatedBytes += event.AllocatedBytes;
+		total.HasAllocations = total.HasAllocations || event.HasAllocations;
+		first = false;
+	}
+	return total;
+}
+
+double RockProfiler::GetTotalMilliseconds() const
+{
+	double total = 0.0;
+	for (const auto& event : m_Events)
+		total += event.Milliseconds;
+	return total;
+}
+
+const char* RockProfiler::GetStageName(RockStage stage)
+{
+	static const char* names[] =
+	{
+		"Planes", "Ico", "Rock", "Expand", "Displace", "CorrectUV", "Surface", "DrawOrder", "Interleave", "VertexBuffer", "IndexBuffer"
+	};
+	return UINT(stage) < UINT(RockStage::Count) ? names[UINT(stage)] : "Unknown";
+}
+
+//CHROME TRACE
+//*******************************************************************************************************************************
+std::string RockProfiler::ToChromeTrace() const
+{
+	std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	char buffer[512];
+	for (size_t i = 0; i < m_Events.size(); i++)
+	{
+		const RockStageEvent& event = m_Events[i];
+		//Trace timestamps are microseconds; allocations not counted are null rather than 0
+		char allocations[64] = "null,\"allocatedBytes\":null";
+		if (event.HasAllocations)
+			snprintf(allocations, sizeof(allocations), "%llu,\"allocatedBytes\":%llu", (unsigned long long)event.Allocations, (unsigned long long)event.AllocatedBytes);
+		snprintf(buffer, sizeof(buffer),
+			"%s\n{\"name\":\"%s\",\"cat\":\"rock\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+			"\"args\":{\"lod\":%u,\"verticesIn\":%u,\"indicesIn\":%u,\"verticesOut\":%u,\"indicesOut\":%u,\"allocations\":%s}}",
+			i > 0 ? "," : "", GetStageName(event.Stage), event.ThreadId, event.Start * 1000.0, event.Milliseconds * 1000.0,
+			event.Lod, event.VerticesIn, event.IndicesIn, event.VerticesOut, event.IndicesOut, allocations);
+		json += buffer;
+	}
+	json += "\n]}\n";
+	return json;
+}
+
+bool RockProfiler::WriteChromeTrace(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	file << ToChromeTrace();
+	return file.good();
+}
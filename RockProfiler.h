@@ -0,0 +1,106 @@
+#pragma once
+#include "RockHeader.h"
+#include <chrono>
+#include <string>
+
+//Pipeline stages in the order a rock is built; the buffer stages belong to GenRock.
+//Normals and tangents are built together in one pass, so they share the Surface stage.
+enum class RockStage
+{
+	Planes,
+	Ico,
+	Rock,
+	Expand,
+	Displace,
+	CorrectUV,
+	Surface,
+	DrawOrder,
+	Interleave,
+	VertexBuffer,
+	IndexBuffer,
+	Count
+};
+
+//One run of one stage. Times are in milliseconds since the process wide profiling epoch, so events of
+//different rocks and threads line up in one trace.
+struct RockStageEvent
+{
+	RockStage Stage = RockStage::Planes;
+	UINT Lod = 0;
+	UINT ThreadId = 0;
+	double Start = 0.0;
+	double Milliseconds = 0.0;
+	UINT VerticesIn = 0;
+	UINT IndicesIn = 0;
+	UINT VerticesOut = 0;
+	UINT IndicesOut = 0;
+	//Heap allocations made by the stage's thread and by the pool workers running its ranges. Only counted when the
+	//executable links the allocation hook, see RockProfiler::IsCountingAllocations; HasAllocations tells the
+	//difference between 0 allocations and none counted.
+	UINT64 Allocations = 0;
+	UINT64 AllocatedBytes = 0;
+	bool HasAllocations = false;
+};
+
+//Allocations made by the calling thread since it started, counted by the global operator new that
+//Headless/RockAllocationHook.cpp replaces. Ranges RockThreadPool workers run for the thread count as its own.
+struct RockAllocationCounters
+{
+	UINT64 Count = 0;
+	UINT64 Bytes = 0;
+};
+
+//Where a thread's allocations are counted, see RockProfiler::SetAllocationAccount
+struct RockAllocationAccount;
+
+//Records a RockStageEvent per stage: two clock reads and two thread local reads per stage,
+//so it stays on in release builds.
+class RockProfiler
+{
+public:
+	RockProfiler() {}
+	~RockProfiler(void) {}
+
+	void Clear() { m_Events.clear(); }
+	void SetLod(UINT lod) { m_Lod = lod; }
+
+	//Stages run one after the other on one thread: Begin snapshots the clock and the counters, End records the event
+	void Begin(UINT verticesIn, UINT indicesIn);
+	void End(RockStage stage, UINT verticesOut, UINT indicesOut);
+
+	//Adds the events of another profile, e.g. the generator's to the ones of the object that uploads the mesh
+	void Append(const RockProfiler& other);
+
+	const std::vector<RockStageEvent>& GetEvents() const { return m_Events; }
+	//Every event of a stage summed up; Start is the earliest one
+	RockStageEvent GetTotal(RockStage stage) const;
+	double GetTotalMilliseconds() const;
+
+	//Chrome trace event JSON (chrome://tracing, Perfetto): one complete event per stage with the counts as args
+	std::string ToChromeTrace() const;
+	bool WriteChromeTrace(const std::string& path) const;
+
+	static const char* GetStageName(RockStage stage);
+	static RockAllocationCounters GetThreadAllocations();
+	//True when the executable links Headless/RockAllocationHook.cpp (the RockAllocationHook CMake target), which
+	//replaces the global operator new; without it every allocation count stays 0
+	static bool IsCountingAllocations();
+	//Called by the allocation hook: once while static objects are constructed, and then for every allocation,
+	//which is charged to the calling thread's current account
+	static bool EnableAllocationCounting();
+	static void CountAllocation(size_t bytes);
+	//The account the calling thread charges: its own, or the one of the thread it is running ranges for
+	static RockAllocationAccount* GetAllocationAccount();
+	//Returns the previous account; nullptr goes back to the thread's own
+	static RockAllocationAccount* SetAllocationAccount(RockAllocationAccount* pAccount);
+	static double GetTime();
+
+private:
+	std::vector<RockStageEvent> m_Events;
+	UINT m_Lod = 0;
+
+	double m_BeginTime = 0.0;
+	UINT m_BeginVertices = 0;
+	UINT m_BeginIndices = 0;
+	RockAllocationCounters m_BeginAllocations;
+};
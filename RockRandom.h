@@ -0,0 +1,49 @@
+#pragma once
+#include "VertexStructs.h"
+
+//Counter based random stream (SplitMix64 finalizer over seed/stream/counter).
+//Value n of stream k only depends on (seed, k, n), so streams can be drawn in any
+//order, on any thread, and replayed exactly from the seed.
+class RockRandom
+{
+public:
+	RockRandom(UINT seed, UINT stream) :
+		m_Key(Mix((static_cast<UINT64>(seed) << 32) | stream)),
+		m_Counter(0)
+	{}
+
+	static UINT64 Mix(UINT64 value)
+	{
+		value += 0x9E3779B97F4A7C15ull;
+		value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+		value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+		return value ^ (value >> 31);
+	}
+
+	//Random value at an explicit position of this stream
+	UINT At(UINT64 counter) const
+	{
+		return static_cast<UINT>(Mix(m_Key + counter * 0x9E3779B97F4A7C15ull) >> 32);
+	}
+
+	UINT Next() { return At(m_Counter++); }
+
+	//Integer in [min, max), min when the range is empty
+	int NextInt(int min, int max)
+	{
+		UINT value = Next();
+		if (max <= min)
+			return min;
+		return static_cast<int>(value % static_cast<UINT>(max - min)) + min;
+	}
+
+	//Float in [0, 1)
+	float NextFloat() { return (Next() >> 8) * (1.0f / 16777216.0f); }
+
+	void SetCounter(UINT64 counter) { m_Counter = counter; }
+	UINT64 GetCounter() const { return m_Counter; }
+
+private:
+	UINT64 m_Key;
+	UINT64 m_Counter;
+};
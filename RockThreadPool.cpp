@@ -0,0 +1,120 @@
+#include "stdafx.h"
+#include "RockThreadPool.h"
+
+RockThreadPool& RockThreadPool::GetShared()
+{
+	static RockThreadPool pool((std::max)(std::thread::hardware_concurrency(), 2u) - 1);
+	return pool;
+}
+
+RockThreadPool::RockThreadPool(UINT numWorkers)
+{
+	m_Workers.reserve(numWorkers);
+	for (UINT i = 0; i < numWorkers; i++)
+		m_Workers.emplace_back(&RockThreadPool::WorkerLoop, this);
+}
+
+RockThreadPool::~RockThreadPool(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stop = true;
+	}
+	m_HasTask.notify_all();
+
+	for (auto& worker : m_Workers)
+		worker.join();
+}
+
+//RANGES
+//*******************************************************************************************************************************
+void RockThreadPool::RunRanges(UINT count, UINT rangeCount, RangeFunction function, const void* pWork, bool chargeAllocations)
+{
+	rangeCount = (std::min)(rangeCount, count);
+	if (rangeCount <= 1 || m_Workers.empty())
+	{
+		if (count > 0)
+			function(pWork, 0, count);
+		return;
+	}
+
+	auto pJob = std::make_shared<RangeJob>();
+	pJob->Function = function;
+	pJob->pWork = pWork;
+	pJob->Count = count;
+	pJob->RangeCount = rangeCount;
+	pJob->pAllocations = chargeAllocations ? RockProfiler::GetAllocationAccount() : nullptr;
+	pJob->NextRange = 0;
+	pJob->FinishedRanges = 0;
+
+	//One task per helper, each of them claims ranges until none are left
+	UINT helpers = (std::min)(rangeCount - 1, GetWorkerCount());
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (UINT i = 0; i < helpers; i++)
+			m_Tasks.emplace_back([pJob]() { RunJob(*pJob); });
+	}
+	if (helpers == 1)
+		m_HasTask.notify_one();
+	else
+		m_HasTask.notify_all();
+
+	RunJob(*pJob);
+
+	std::unique_lock<std::mutex> lock(pJob->Mutex);
+	pJob->Finished.wait(lock, [&]() { return pJob->FinishedRanges == pJob->RangeCount; });
+}
+
+void RockThreadPool::RunJob(RangeJob& job)
+{
+	RockAllocationAccount* pAccount = RockProfiler::GetAllocationAccount();
+	if (job.pAllocations)
+		RockProfiler::SetAllocationAccount(job.pAllocations);
+
+	for (UINT range = job.NextRange++; range < job.RangeCount; range = job.NextRange++)
+	{
+		UINT first = (UINT)((UINT64)job.Count * range / job.RangeCount);
+		UINT last = (UINT)((UINT64)job.Count * (range + 1) / job.RangeCount);
+		job.Function(job.pWork, first, last);
+
+		//Notified under the lock, so the caller cannot miss it between checking and waiting
+		if (++job.FinishedRanges == job.RangeCount)
+		{
+			std::lock_guard<std::mutex> lock(job.Mutex);
+			job.Finished.notify_all();
+		}
+	}
+
+	RockProfiler::SetAllocationAccount(pAccount);
+}
+
+//TASKS
+//*******************************************************************************************************************************
+void RockThreadPool::Submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Tasks.push_back(std::move(task));
+	}
+	m_HasTask.notify_one();
+}
+
+//WORKERS
+//*******************************************************************************************************************************
+void RockThreadPool::WorkerLoop()
+{
+	for (;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_HasTask.wait(lock, [this]() { return m_Stop || !m_Tasks.empty(); });
+			if (m_Stop)
+				return;
+
+			task = std::move(m_Tasks.front());
+			m_Tasks.pop_front();
+		}
+		task();
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "RockProfiler.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+//Worker threads that live as long as the pool, so parallel stages only wake them instead of creating and joining
+//threads on every call. The caller of RunRanges always works along: ranges go to whichever thread is free first,
+//and when every worker is busy the caller simply runs all of them itself. Submit queues background work, such as
+//rock rebuilds, on the same workers.
+class RockThreadPool
+{
+public:
+	typedef void(*RangeFunction)(const void* pWork, UINT first, UINT last);
+
+	//The process wide pool, one worker per hardware thread besides the caller's and at least one for submitted tasks;
+	//created on first use
+	static RockThreadPool& GetShared();
+
+	explicit RockThreadPool(UINT numWorkers);
+	~RockThreadPool(void);
+
+	UINT GetWorkerCount() const { return (UINT)m_Workers.size(); }
+
+	//Splits [0, count) into rangeCount contiguous ranges and runs function(pWork, first, last) on each of them,
+	//on the calling thread and at most rangeCount - 1 workers. Returns when every range has run.
+	//With chargeAllocations, RockProfiler counts the heap allocations of the workers' ranges as the caller's.
+	void RunRanges(UINT count, UINT rangeCount, RangeFunction function, const void* pWork, bool chargeAllocations = true);
+
+	//Queues task for the next free worker and returns at once. Tasks still queued when the pool is destroyed never run,
+	//so whoever submits has to wait for its tasks before its own state goes away. Needs at least one worker.
+	void Submit(std::function<void()> task);
+
+private:
+	//One RunRanges call. Ranges are claimed through NextRange; workers that pick the job up after the caller
+	//claimed everything find nothing left, and their reference keeps the job alive until they drop it.
+	struct RangeJob
+	{
+		RangeFunction Function;
+		const void* pWork;
+		UINT Count;
+		UINT RangeCount;
+		RockAllocationAccount* pAllocations;
+		std::atomic<UINT> NextRange;
+		std::atomic<UINT> FinishedRanges;
+		std::mutex Mutex;
+		std::condition_variable Finished;
+	};
+
+	static void RunJob(RangeJob& job);
+	void WorkerLoop();
+
+	std::vector<std::thread> m_Workers;
+	std::mutex m_Mutex;
+	std::condition_variable m_HasTask;
+	std::deque<std::function<void()>> m_Tasks;
+	bool m_Stop = false;
+
+	// -------------------------
+	// Disabling default copy constructor and default
+	// assignment operator.
+	// -------------------------
+	RockThreadPool(const RockThreadPool& yRef);
+	RockThreadPool& operator=(const RockThreadPool& yRef);
+};
@@ -0,0 +1,163 @@
+#include "stdafx.h"
+#include "RockVariantPool.h"
+#include "RockRandom.h"
+#include <algorithm>
+
+RockVariantPool::RockVariantPool(UINT variantsPerClass) :
+	m_VariantsPerClass((std::max)(variantsPerClass, 1u))
+{
+}
+
+//REFERENCES
+//*******************************************************************************************************************************
+UINT RockVariantPool::Acquire(const RockBuildRequest& request)
+{
+	//The variant's own seed, so every seed of a class lands on one of its variantsPerClass rocks. Hashed first:
+	//seeds that are multiples of variantsPerClass, or share its low bits, would otherwise pile onto few variants.
+	RockBuildRequest variantRequest = request;
+	variantRequest.Parameters.Seed = (UINT)(RockRandom::Mix(request.Parameters.Seed) % m_VariantsPerClass);
+
+	//Pools hold tens to hundreds of variants, a linear search stays well below a build
+	UINT freeSlot = NO_VARIANT;
+	for (UINT i = 0; i < m_Variants.size(); i++)
+	{
+		if (m_Variants[i].References == 0)
+		{
+			freeSlot = freeSlot == NO_VARIANT ? i : freeSlot;
+			continue;
+		}
+		if (IsSameVariant(m_Variants[i].Request, variantRequest))
+		{
+			m_Variants[i].References++;
+			return i;
+		}
+	}
+
+	if (freeSlot == NO_VARIANT)
+	{
+		freeSlot = (UINT)m_Variants.size();
+		m_Variants.emplace_back();
+	}
+
+	//A good moment to let go of retired builders that finished meanwhile
+	m_RetiredBuilders.erase(std::remove_if(m_RetiredBuilders.begin(), m_RetiredBuilders.end(),
+		[](const std::unique_ptr<RockAsyncBuilder>& pBuilder) { return !pBuilder->IsBusy(); }), m_RetiredBuilders.end());
+
+	Variant& variant = m_Variants[freeSlot];
+	variant.Request = variantRequest;
+	variant.pBuilder.reset(new RockAsyncBuilder());
+	variant.pBuilder->Request(variantRequest);
+	variant.References = 1;
+	return freeSlot;
+}
+
+void RockVariantPool::AddRef(UINT variant)
+{
+	m_Variants[variant].References++;
+}
+
+void RockVariantPool::Release(UINT variant)
+{
+	//Releasing a freed variant again is ignored
+	Variant& slot = m_Variants[variant];
+	if (slot.References == 0)
+		return;
+
+	if (--slot.References == 0)
+	{
+		//Destroying a builder waits for its build, so a busy one is kept aside instead of stalling the caller
+		if (slot.pBuilder && slot.pBuilder->IsBusy())
+			m_RetiredBuilders.push_back(std::move(slot.pBuilder));
+		slot.pBuilder.reset();
+		slot.pResult.reset();
+		slot.pDeviceData.reset();
+		slot.Bytes = 0;
+		slot.IsBuilt = false;
+	}
+}
+
+//BUILDS
+//*******************************************************************************************************************************
+bool RockVariantPool::Poll(UINT variant)
+{
+	Variant& slot = m_Variants[variant];
+	if (!slot.IsBuilt)
+	{
+		slot.pResult = slot.pBuilder->TakeResult();
+		if (slot.pResult)
+		{
+			slot.Bytes = GetBytes(*slot.pResult);
+			slot.IsBuilt = true;
+			slot.pBuilder.reset();
+		}
+	}
+	return slot.IsBuilt;
+}
+
+void RockVariantPool::Wait(UINT variant)
+{
+	if (!m_Variants[variant].IsBuilt)
+		m_Variants[variant].pBuilder->Wait();
+	Poll(variant);
+}
+
+bool RockVariantPool::IsSameVariant(const RockBuildRequest& a, const RockBuildRequest& b)
+{
+	return a.Parameters.GetChanges(b.Parameters) == 0 && a.LodCount == b.LodCount &&
+		a.PackedVertices == b.PackedVertices && a.pCache == b.pCache;
+}
+
+bool RockVariantPool::IsSameClass(const RockBuildRequest& a, const RockBuildRequest& b)
+{
+	RockBuildRequest seeded = b;
+	seeded.Parameters.Seed = a.Parameters.Seed;
+	return IsSameVariant(a, seeded);
+}
+
+//MEMORY
+//*******************************************************************************************************************************
+size_t RockVariantPool::GetBytes(const RockBuildResult& result)
+{
+	size_t bytes = 0;
+	if (result.pCached)
+	{
+		for (UINT i = 0; i < result.pCached->GetLodCount(); i++)
+		{
+			const RockCachedLod& lod = result.pCached->GetLod(i);
+			bytes += (size_t)lod.VertexCount * lod.VertexStride + (size_t)lod.IndexCount * lod.IndexStride;
+		}
+		return bytes;
+	}
+
+	for (const RockBuiltLod& lod : result.Lods)
+	{
+		bytes += lod.Vertices.size() * sizeof(VertexRock) + lod.PackedVertices.size() * sizeof(VertexRockPacked);
+		bytes += (size_t)lod.Indices.GetCount() * lod.Indices.GetStride();
+	}
+	return bytes;
+}
+
+RockPoolMemory RockVariantPool::GetMemory() const
+{
+	RockPoolMemory memory;
+	for (UINT i = 0; i < m_Variants.size(); i++)
+	{
+		const Variant& variant = m_Variants[i];
+		if (variant.References == 0)
+			continue;
+
+		//A class is counted at its first live variant
+		bool firstOfClass = true;
+		for (UINT j = 0; j < i && firstOfClass; j++)
+			firstOfClass = m_Variants[j].References == 0 || !IsSameClass(m_Variants[j].Request, variant.Request);
+
+		memory.Classes += firstOfClass ? 1 : 0;
+		memory.Variants++;
+		memory.References += variant.References;
+		memory.PooledBytes += variant.Bytes;
+		memory.UniqueBytes += variant.Bytes * variant.References;
+		memory.CpuBytes += variant.pResult ? variant.Bytes : 0;
+	}
+	memory.SavedBytes = memory.UniqueBytes - memory.PooledBytes;
+	return memory;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "RockAsyncBuilder.h"
+
+//Mesh bytes (vertices + indices) of the pool against every reference holding its own copy.
+//A GenRock keeps its mesh once on the CPU and once on the GPU, so pooling saves it SavedBytes on each side.
+//CpuBytes is the part of PooledBytes whose build result the pool still holds, i.e. not dropped after the upload.
+struct RockPoolMemory
+{
+	UINT Classes = 0;
+	UINT Variants = 0;
+	UINT References = 0;
+	size_t PooledBytes = 0;
+	size_t UniqueBytes = 0;
+	size_t SavedBytes = 0;
+	size_t CpuBytes = 0;
+};
+
+//Shares rock meshes between interchangeable rocks. A parameter class is everything in a build request but the seed;
+//each class is built as at most variantsPerClass rocks, and a request gets one of them picked by its hashed seed.
+//Rocks sharing a variant differ only by transform, non-uniform scale and material tint.
+//Variants are reference counted and freed with their last reference. A new variant is built through its own
+//RockAsyncBuilder on the shared worker pool; Acquire returns at once and Poll tells when the build is in. A variant
+//never rebuilds, so its builder and the generator in it are freed as soon as the build is taken.
+//Not thread safe, every call has to come from the same thread.
+class RockVariantPool
+{
+public:
+	static const UINT NO_VARIANT = ~0u;
+
+	explicit RockVariantPool(UINT variantsPerClass = 8);
+	//Waits for the builds still running
+	~RockVariantPool(void) {}
+
+	//Starts building the variant on first use; every Acquire needs a Release
+	UINT Acquire(const RockBuildRequest& request);
+	void AddRef(UINT variant);
+	void Release(UINT variant);
+
+	//True once the variant's build finished; never blocks
+	bool Poll(UINT variant);
+	//Blocks until Poll turns true
+	void Wait(UINT variant);
+
+	//Generated LODs, or on a hit in the request's cache the mapped cache file.
+	//Valid from the first Poll that returned true until DropResult.
+	const RockBuildResult& GetResult(UINT variant) const { return *m_Variants[variant].pResult; }
+	//Frees the CPU side of the variant once the owner uploaded it; the variant itself stays
+	void DropResult(UINT variant) { m_Variants[variant].pResult.reset(); }
+	UINT GetReferences(UINT variant) const { return m_Variants[variant].References; }
+	//Slot for whatever the owner uploads of a variant (GPU buffers); reset when the variant is freed
+	std::shared_ptr<void>& GetDeviceData(UINT variant) { return m_Variants[variant].pDeviceData; }
+
+	UINT GetVariantsPerClass() const { return m_VariantsPerClass; }
+	RockPoolMemory GetMemory() const;
+
+	//Vertex and index bytes of a build result
+	static size_t GetBytes(const RockBuildResult& result);
+
+private:
+	struct Variant
+	{
+		RockBuildRequest Request;
+		std::unique_ptr<RockAsyncBuilder> pBuilder;
+		std::unique_ptr<RockBuildResult> pResult;
+		std::shared_ptr<void> pDeviceData;
+		size_t Bytes = 0;
+		UINT References = 0;
+		bool IsBuilt = false;
+	};
+
+	static bool IsSameVariant(const RockBuildRequest& a, const RockBuildRequest& b);
+	static bool IsSameClass(const RockBuildRequest& a, const RockBuildRequest& b);
+
+	UINT m_VariantsPerClass;
+	//Freed variants leave an empty slot (References == 0) that the next new variant takes
+	std::vector<Variant> m_Variants;
+	//Builders of variants freed while they were still building, kept until the build is done
+	std::vector<std::unique_ptr<RockAsyncBuilder>> m_RetiredBuilders;
+
+	// -------------------------
+	// Disabling default copy constructor and default
+	// assignment operator.
+	// -------------------------
+	RockVariantPool(const RockVariantPool& yRef);
+	RockVariantPool& operator=(const RockVariantPool& yRef);
+};
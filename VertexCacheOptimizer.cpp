@@ -0,0 +1,154 @@
+#include "stdafx.h"
+#include "VertexCacheOptimizer.h"
+
+//TRIANGLE ORDER
+//*******************************************************************************************************************************
+std::vector<UINT> VertexCacheOptimizer::OrderTriangles(const std::vector<DWORD>& indices, UINT numVertices, UINT cacheSize)
+{
+	UINT numTriangles = (UINT)indices.size() / 3;
+	std::vector<UINT> order;
+	order.reserve(numTriangles);
+	if (numTriangles == 0)
+		return order;
+
+	//Vertex -> triangle adjacency
+	//-----------------------------------------------------------------------------------------
+	std::vector<UINT> offsets(numVertices + 1, 0);
+	for (UINT i = 0; i < numTriangles * 3; i++)
+		offsets[indices[i] + 1]++;
+	for (UINT v = 0; v < numVertices; v++)
+		offsets[v + 1] += offsets[v];
+
+	std::vector<UINT> adjacency(numTriangles * 3);
+	std::vector<UINT> fill(offsets.begin(), offsets.end() - 1);
+	for (UINT i = 0; i < numTriangles * 3; i++)
+		adjacency[fill[indices[i]]++] = i / 3;
+
+	//Tipsify
+	//-----------------------------------------------------------------------------------------
+	//live: triangles left per vertex, cacheTime: time stamp a vertex last entered the cache
+	std::vector<UINT> live(numVertices);
+	for (UINT v = 0; v < numVertices; v++)
+		live[v] = offsets[v + 1] - offsets[v];
+
+	std::vector<UINT> cacheTime(numVertices, 0);
+	std::vector<bool> emitted(numTriangles, false);
+	std::vector<UINT> deadEnd;
+	std::vector<UINT> candidates;
+	deadEnd.reserve(numTriangles * 3);
+
+	UINT time = cacheSize + 1;
+	UINT cursor = 0;
+	int fanning = (int)indices[0];
+	while (fanning >= 0)
+	{
+		//Emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (UINT a = offsets[fanning]; a < offsets[fanning + 1]; a++)
+		{
+			UINT triangle = adjacency[a];
+			if (emitted[triangle])
+				continue;
+
+			for (UINT corner = 0; corner < 3; corner++)
+			{
+				UINT v = indices[triangle * 3 + corner];
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - cacheTime[v] > cacheSize)
+					cacheTime[v] = time++;
+			}
+			emitted[triangle] = true;
+			order.push_back(triangle);
+		}
+
+		//Next fanning vertex: the oldest candidate that will still be in the cache after its own fan
+		int next = -1;
+		int best = -1;
+		for (UINT v : candidates)
+		{
+			if (live[v] == 0)
+				continue;
+
+			int priority = 0;
+			if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+				priority = (int)(time - cacheTime[v]);
+			if (priority > best)
+			{
+				best = priority;
+				next = (int)v;
+			}
+		}
+
+		//Dead end: back up through recently used vertices, then scan the input in order
+		while (next < 0 && !deadEnd.empty())
+		{
+			UINT v = deadEnd.back();
+			deadEnd.pop_back();
+			if (live[v] > 0)
+				next = (int)v;
+		}
+		while (next < 0 && cursor < numVertices)
+		{
+			if (live[cursor] > 0)
+				next = (int)cursor;
+			cursor++;
+		}
+		fanning = next;
+	}
+
+	return order;
+}
+
+//VERTEX ORDER
+//*******************************************************************************************************************************
+std::vector<UINT> VertexCacheOptimizer::RenumberVertices(std::vector<DWORD>& indices, UINT numVertices)
+{
+	const UINT unused = ~0u;
+	std::vector<UINT> remap(numVertices, unused);
+	std::vector<UINT> oldVertices;
+	oldVertices.reserve(numVertices);
+
+	for (auto& index : indices)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = (UINT)oldVertices.size();
+			oldVertices.push_back(index);
+		}
+		index = remap[index];
+	}
+	return oldVertices;
+}
+
+//METRICS
+//*******************************************************************************************************************************
+VertexCacheStats VertexCacheOptimizer::Measure(const std::vector<DWORD>& indices, UINT numVertices, UINT cacheSize)
+{
+	VertexCacheStats stats;
+	if (indices.empty() || numVertices == 0)
+		return stats;
+
+	//FIFO: a vertex is a hit while fewer than cacheSize misses happened since it was loaded
+	std::vector<UINT> loadedAt(numVertices, 0);
+	std::vector<bool> loaded(numVertices, false);
+	UINT misses = 0;
+	for (DWORD index : indices)
+	{
+		if (!loaded[index] || misses - loadedAt[index] >= cacheSize)
+		{
+			loaded[index] = true;
+			loadedAt[index] = misses;
+			misses++;
+		}
+	}
+
+	UINT usedVertices = 0;
+	for (UINT v = 0; v < numVertices; v++)
+		usedVertices += loaded[v] ? 1 : 0;
+
+	stats.ACMR = (float)misses / (indices.size() / 3);
+	stats.ATVR = (float)misses / usedVertices;
+	return stats;
+}
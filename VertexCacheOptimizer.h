@@ -0,0 +1,41 @@
+#pragma once
+#include "RockHeader.h"
+
+//Post-transform cache behaviour of an index buffer, simulated as a FIFO cache
+struct VertexCacheStats
+{
+	float ACMR = 0.0f;	//average cache miss ratio: transformed vertices per triangle, 0.5 at best
+	float ATVR = 0.0f;	//average transform to vertex ratio: transformed vertices per vertex, 1.0 at best
+};
+
+struct VertexCacheReport
+{
+	VertexCacheStats Before;
+	VertexCacheStats After;
+};
+
+//Reorders triangle lists for the post-transform vertex cache (Tipsify, Sander et al. 2007)
+//and renumbers vertices in first-use order for vertex fetch locality.
+class VertexCacheOptimizer
+{
+public:
+	static const UINT CACHE_SIZE = 16;
+
+	//New triangle order: entry i is the old triangle to emit i-th
+	static std::vector<UINT> OrderTriangles(const std::vector<DWORD>& indices, UINT numVertices, UINT cacheSize = CACHE_SIZE);
+
+	//Rewrites indices in first-use order and returns the old vertex of every new one.
+	//Vertices no triangle uses are dropped.
+	static std::vector<UINT> RenumberVertices(std::vector<DWORD>& indices, UINT numVertices);
+
+	static VertexCacheStats Measure(const std::vector<DWORD>& indices, UINT numVertices, UINT cacheSize = CACHE_SIZE);
+
+private:
+	// -------------------------
+	// Disabling default constructor, copy constructor and
+	// assignment operator.
+	// -------------------------
+	VertexCacheOptimizer();
+	VertexCacheOptimizer(const VertexCacheOptimizer& yRef);
+	VertexCacheOptimizer& operator=(const VertexCacheOptimizer& yRef);
+};